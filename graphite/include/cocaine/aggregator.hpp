@@ -0,0 +1,75 @@
+/*
+* 2015+ Copyright (c) Anton Matveenko <antmat@yandex-team.ru>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*/
+
+#ifndef COCAINE_GRAPHITE_AGGREGATOR_HPP
+#define COCAINE_GRAPHITE_AGGREGATOR_HPP
+
+#include "cocaine/metric.hpp"
+
+#include <cocaine/dynamic.hpp>
+
+#include <string>
+#include <unordered_map>
+
+namespace cocaine { namespace service { namespace graphite {
+
+/**
+ * Folds samples of the same metric name received within a flush window into a few values.
+ *
+ * Configured by the "aggregate" option, which is either a function name or a list of them, one of
+ * "sum", "avg", "min", "max" and "count". With a single function aggregated metrics keep their
+ * names, otherwise the function name is appended to them as the last path component.
+ */
+class aggregator_t {
+public:
+    aggregator_t(const dynamic_t& config);
+
+    /// Whether any function is configured, samples should not be passed otherwise.
+    auto enabled() const -> bool;
+
+    /// Number of distinct metric names folded since the last take.
+    auto size() const -> size_t;
+
+    void add(const metric_t& metric);
+
+    /// Appends aggregated values to the pack and resets the state.
+    void take(metric_pack_t& metrics);
+
+private:
+    enum function_t : unsigned {
+        sum   = 1 << 0,
+        avg   = 1 << 1,
+        min   = 1 << 2,
+        max   = 1 << 3,
+        count = 1 << 4
+    };
+
+    struct state_t {
+        double sum;
+        double min;
+        double max;
+        size_t count;
+        time_t ts;
+    };
+
+    static auto parse(const std::string& name) -> unsigned;
+
+    unsigned functions;
+    bool suffixed;
+    std::unordered_map<std::string, state_t> states;
+};
+
+}}}
+#endif
@@ -16,6 +16,7 @@
 #ifndef COCAINE_GRAPHITE_SERVICE_HPP
 #define COCAINE_GRAPHITE_SERVICE_HPP
 
+#include "cocaine/aggregator.hpp"
 #include "cocaine/idl/graphite.hpp"
 
 #include <cocaine/api/service.hpp>
@@ -29,10 +30,26 @@
 namespace cocaine { namespace service {
 class graphite_cfg_t {
 public:
+    enum class drop_policy_t {
+        oldest,
+        newest
+    };
+
+    enum class transport_t {
+        tcp,
+        udp
+    };
+
     asio::ip::tcp::endpoint endpoint;
     std::string prefix;
     boost::posix_time::milliseconds flush_interval_ms;
     size_t max_queue_size;
+    boost::posix_time::milliseconds reconnect_interval_ms;
+    dynamic_t aggregate;
+    size_t max_buffer_bytes;
+    drop_policy_t drop_policy;
+    transport_t transport;
+    size_t mtu;
     graphite_cfg_t(const cocaine::dynamic_t& args);
 };
 
@@ -60,16 +77,29 @@ public:
     send_by_timer(const asio::error_code& error);
 
 private:
-    class graphite_sender_t;
-    typedef graphite::metric_pack_t buffer_t;
+    class transport_t;
+    class connection_t;
+    class datagram_t;
+
+    /// Samples received since the last flush, folded by the aggregator when it is enabled.
+    struct buffer_t {
+        graphite::metric_pack_t metrics;
+        graphite::aggregator_t aggregator;
+
+        buffer_t(const dynamic_t& aggregate);
+        auto size() const -> size_t;
+    };
 
     void send();
     void reset_timer();
+    template<class Iterator>
+    void push(Iterator begin, Iterator end);
     asio::io_service& asio;
     graphite_cfg_t config;
     std::shared_ptr<logging::logger_t> log;
     synchronized<asio::deadline_timer> timer;
     synchronized<buffer_t> buffer;
+    std::shared_ptr<transport_t> transport;
 };
 }}
 #endif
@@ -0,0 +1,109 @@
+/*
+* 2015+ Copyright (c) Anton Matveenko <antmat@yandex-team.ru>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*/
+
+#include "cocaine/aggregator.hpp"
+
+#include <cocaine/errors.hpp>
+
+#include <algorithm>
+
+namespace cocaine { namespace service { namespace graphite {
+
+aggregator_t::aggregator_t(const dynamic_t& config) :
+    functions(0),
+    suffixed(false),
+    states()
+{
+    if(config.is_string()) {
+        functions = parse(config.as_string());
+    } else if(config.is_array()) {
+        for(const auto& function : config.as_array()) {
+            if(!function.is_string()) {
+                throw error_t("aggregation function name must be a string");
+            }
+            functions |= parse(function.as_string());
+        }
+    } else if(!config.is_null()) {
+        throw error_t("aggregation must be a function name or a list of them");
+    }
+    // More than one bit set.
+    suffixed = (functions & (functions - 1)) != 0;
+}
+
+auto aggregator_t::parse(const std::string& name) -> unsigned {
+    if(name == "sum") {
+        return function_t::sum;
+    } else if(name == "avg") {
+        return function_t::avg;
+    } else if(name == "min") {
+        return function_t::min;
+    } else if(name == "max") {
+        return function_t::max;
+    } else if(name == "count") {
+        return function_t::count;
+    }
+    throw error_t("unknown aggregation function - {}", name);
+}
+
+bool aggregator_t::enabled() const {
+    return functions != 0;
+}
+
+size_t aggregator_t::size() const {
+    return states.size();
+}
+
+void aggregator_t::add(const metric_t& metric) {
+    const auto value = metric.get_value();
+    auto it = states.find(metric.get_name());
+    if(it == states.end()) {
+        states.emplace(metric.get_name(), state_t{value, value, value, 1, metric.get_timestamp()});
+        return;
+    }
+    auto& state = it->second;
+    state.sum += value;
+    state.min = std::min(state.min, value);
+    state.max = std::max(state.max, value);
+    state.count++;
+    state.ts = std::max(state.ts, metric.get_timestamp());
+}
+
+void aggregator_t::take(metric_pack_t& metrics) {
+    const auto emit = [&](const std::string& name, const char* suffix, double value, time_t ts) {
+        metrics.emplace_back(suffixed ? name + '.' + suffix : name, value, ts);
+    };
+
+    for(const auto& item : states) {
+        const auto& state = item.second;
+        if(functions & function_t::sum) {
+            emit(item.first, "sum", state.sum, state.ts);
+        }
+        if(functions & function_t::avg) {
+            emit(item.first, "avg", state.sum / state.count, state.ts);
+        }
+        if(functions & function_t::min) {
+            emit(item.first, "min", state.min, state.ts);
+        }
+        if(functions & function_t::max) {
+            emit(item.first, "max", state.max, state.ts);
+        }
+        if(functions & function_t::count) {
+            emit(item.first, "count", static_cast<double>(state.count), state.ts);
+        }
+    }
+    states.clear();
+}
+
+}}}
@@ -16,68 +16,313 @@
 #include "cocaine/graphite.hpp"
 #include <cocaine/dynamic.hpp>
 #include <cocaine/context.hpp>
+#include <cocaine/errors.hpp>
 
 #include <blackhole/logger.hpp>
 
+#include <asio/ip/udp.hpp>
+#include <asio/write.hpp>
+
+#include <algorithm>
+
 namespace ph = std::placeholders;
 
 namespace cocaine { namespace service {
 
-class graphite_t::graphite_sender_t :
-    public std::enable_shared_from_this<graphite_t::graphite_sender_t>
+namespace {
+
+auto count_lines(const std::string& data, size_t begin, size_t end) -> size_t {
+    return static_cast<size_t>(std::count(data.begin() + begin, data.begin() + end, '\n'));
+}
+
+}
+
+/**
+ * Sends formatted metrics, one per line, to carbon.
+ *
+ * All methods are called in the service event loop.
+ */
+class graphite_t::transport_t {
+public:
+    virtual ~transport_t() {}
+    virtual void write(const std::string& data, size_t count) = 0;
+};
+
+/**
+ * Persistent connection to carbon, shared by all flushes.
+ *
+ * Reconnects after a failure once the reconnect interval elapses, data written meanwhile and data of
+ * the failed write are kept. While a write is in flight, new data is appended to the pending buffer
+ * and goes with the next one. The pending buffer is bounded by "max_buffer_bytes", whole metrics are
+ * dropped on overflow, either the oldest or the newest ones as set by "drop_policy".
+ */
+class graphite_t::connection_t :
+    public transport_t,
+    public std::enable_shared_from_this<graphite_t::connection_t>
 {
 public:
-    graphite_sender_t(graphite_t* parent, graphite_t::buffer_t&& buffer);
-    void send();
-    void on_connect(const asio::error_code& ec);
-    void on_send(const asio::error_code& ec);
+    connection_t(asio::io_service& asio, const graphite_cfg_t& config, std::shared_ptr<logging::logger_t> log);
+    void write(const std::string& data, size_t count) override;
 private:
-    graphite_t* parent;
-    graphite_t::buffer_t buffer;
-    std::string s_buffer;
+    enum class state_t {
+        disconnected,
+        connecting,
+        connected,
+        /// Waiting for the reconnect timer after a failure.
+        waiting
+    };
+
+    void connect();
+    void on_connect(const asio::error_code& ec);
+    void flush();
+    void on_write(const asio::error_code& ec);
+    void on_read(const asio::error_code& ec);
+    void on_reconnect_timer(const asio::error_code& ec);
+    void reset();
+    void requeue();
+    void trim(size_t bytes, bool oldest);
+
+    asio::ip::tcp::endpoint endpoint;
+    boost::posix_time::milliseconds reconnect_interval;
+    size_t max_buffer_bytes;
+    bool drop_oldest;
+    size_t dropped;
+    std::shared_ptr<logging::logger_t> log;
     asio::ip::tcp::socket socket;
+    asio::deadline_timer reconnect_timer;
+    state_t state;
+    bool writing;
+    std::string pending;
+    size_t pending_count;
+    std::string inflight;
+    size_t inflight_count;
+    char read_buffer[1];
 };
 
-graphite_t::graphite_sender_t::graphite_sender_t(graphite_t* _parent, graphite_t::buffer_t&& _buffer) :
-    parent(_parent),
-    buffer(std::move(_buffer)),
-    s_buffer(),
-    socket(parent->asio)
+graphite_t::connection_t::connection_t(asio::io_service& asio,
+                                       const graphite_cfg_t& config,
+                                       std::shared_ptr<logging::logger_t> _log) :
+    endpoint(config.endpoint),
+    reconnect_interval(config.reconnect_interval_ms),
+    max_buffer_bytes(config.max_buffer_bytes),
+    drop_oldest(config.drop_policy == graphite_cfg_t::drop_policy_t::oldest),
+    dropped(0),
+    log(std::move(_log)),
+    socket(asio),
+    reconnect_timer(asio),
+    state(state_t::disconnected),
+    writing(false),
+    pending(),
+    pending_count(0),
+    inflight(),
+    inflight_count(0)
 {
 }
 
-void graphite_t::graphite_sender_t::send() {
-    socket.async_connect(parent->config.endpoint, std::bind(&graphite_sender_t::on_connect, shared_from_this(), ph::_1));
+void graphite_t::connection_t::write(const std::string& data, size_t count) {
+    if(pending.size() + data.size() > max_buffer_bytes) {
+        if(drop_oldest && data.size() <= max_buffer_bytes) {
+            trim(pending.size() + data.size() - max_buffer_bytes, true);
+        } else {
+            dropped += count;
+            COCAINE_LOG_WARNING(log, "Graphite buffer is full, dropped {} new metrics, {} in total", count, dropped);
+            return;
+        }
+    }
+    pending.append(data);
+    pending_count += count;
+    switch(state) {
+        case state_t::disconnected:
+            connect();
+            break;
+        case state_t::connected:
+            if(!writing) {
+                flush();
+            }
+            break;
+        default:
+            break;
+    }
 }
 
-void graphite_t::graphite_sender_t::on_connect(const asio::error_code& ec) {
+void graphite_t::connection_t::connect() {
+    state = state_t::connecting;
+    socket.async_connect(endpoint, std::bind(&connection_t::on_connect, shared_from_this(), ph::_1));
+}
+
+void graphite_t::connection_t::on_connect(const asio::error_code& ec) {
     if(ec) {
-        COCAINE_LOG_WARNING(parent->log,
-            "Could not send {} metrics to graphite. Could not open socket: {}",
-            buffer.size(),
-            ec.message().c_str()
+        COCAINE_LOG_WARNING(log,
+            "Could not connect to graphite: {}, {} metrics are kept until reconnect",
+            ec.message().c_str(),
+            pending_count
         );
+        reset();
+        return;
     }
-    else {
-        COCAINE_LOG_DEBUG(parent->log, "Opened socket to send metrics to graphite");
-        assert(s_buffer.empty());
-        for(size_t i = 0; i < buffer.size(); i++) {
-            s_buffer.append(buffer[i].format(parent->config.prefix));
-        }
-        socket.async_send(asio::buffer(s_buffer), std::bind(&graphite_sender_t::on_send, shared_from_this(), ph::_1));
+    COCAINE_LOG_DEBUG(log, "Opened socket to send metrics to graphite");
+    state = state_t::connected;
+    // Carbon never writes anything, so the read completes only when the peer closes the connection.
+    socket.async_read_some(asio::buffer(read_buffer), std::bind(&connection_t::on_read, shared_from_this(), ph::_1));
+    if(!pending.empty()) {
+        flush();
     }
 }
 
-void graphite_t::graphite_sender_t::on_send(const asio::error_code& ec) {
+void graphite_t::connection_t::flush() {
+    assert(inflight.empty());
+    inflight.swap(pending);
+    inflight_count = pending_count;
+    pending_count = 0;
+    writing = true;
+    asio::async_write(socket, asio::buffer(inflight), std::bind(&connection_t::on_write, shared_from_this(), ph::_1));
+}
+
+void graphite_t::connection_t::on_write(const asio::error_code& ec) {
+    writing = false;
     if(ec) {
-        COCAINE_LOG_WARNING(parent->log,
+        COCAINE_LOG_WARNING(log,
             "Could not send {} metrics to graphite. Could not send: {}",
-            buffer.size(),
+            inflight_count,
             ec.message().c_str()
         );
+        requeue();
+        reset();
+        return;
     }
-    else {
-        COCAINE_LOG_DEBUG(parent->log, "Successfully sent {} metrics", buffer.size());
+    COCAINE_LOG_DEBUG(log, "Successfully sent {} metrics", inflight_count);
+    inflight.clear();
+    if(!pending.empty()) {
+        flush();
+    }
+}
+
+void graphite_t::connection_t::on_read(const asio::error_code& ec) {
+    if(ec == asio::error::operation_aborted) {
+        return;
+    }
+    COCAINE_LOG_WARNING(log, "Graphite connection was closed: {}", ec ? ec.message().c_str() : "unexpected data");
+    reset();
+}
+
+void graphite_t::connection_t::requeue() {
+    // Some metrics of the failed write may have been delivered, carbon overwrites them when resent.
+    inflight.append(pending);
+    pending.swap(inflight);
+    pending_count += inflight_count;
+    inflight.clear();
+    inflight_count = 0;
+    if(pending.size() > max_buffer_bytes) {
+        trim(pending.size() - max_buffer_bytes, drop_oldest);
+    }
+}
+
+void graphite_t::connection_t::trim(size_t bytes, bool oldest) {
+    // Cut at line boundaries, so that only whole metrics are dropped.
+    size_t lines;
+    if(oldest) {
+        auto end = pending.find('\n', bytes - 1);
+        end = end == std::string::npos ? pending.size() : end + 1;
+        lines = count_lines(pending, 0, end);
+        pending.erase(0, end);
+    } else {
+        auto begin = bytes >= pending.size() ? std::string::npos : pending.rfind('\n', pending.size() - bytes - 1);
+        begin = begin == std::string::npos ? 0 : begin + 1;
+        lines = count_lines(pending, begin, pending.size());
+        pending.erase(begin);
+    }
+    pending_count -= std::min(pending_count, lines);
+    dropped += lines;
+    COCAINE_LOG_WARNING(log,
+        "Graphite buffer is full, dropped {} {} metrics, {} in total",
+        lines,
+        oldest ? "oldest" : "newest",
+        dropped
+    );
+}
+
+void graphite_t::connection_t::reset() {
+    if(state == state_t::waiting) {
+        return;
+    }
+    asio::error_code ignored;
+    socket.close(ignored);
+    state = state_t::waiting;
+    reconnect_timer.expires_from_now(reconnect_interval);
+    reconnect_timer.async_wait(std::bind(&connection_t::on_reconnect_timer, shared_from_this(), ph::_1));
+}
+
+void graphite_t::connection_t::on_reconnect_timer(const asio::error_code& ec) {
+    if(ec) {
+        return;
+    }
+    state = state_t::disconnected;
+    // Do not keep the connection without data to send.
+    if(!pending.empty()) {
+        connect();
+    }
+}
+
+/**
+ * Sends metrics in UDP datagrams of up to "mtu" bytes without buffering.
+ *
+ * Metrics are never split between datagrams, a metric longer than mtu goes alone. Datagrams that can
+ * not be sent immediately are dropped, which is fine for high-frequency metrics.
+ */
+class graphite_t::datagram_t :
+    public transport_t
+{
+public:
+    datagram_t(asio::io_service& asio, const graphite_cfg_t& config, std::shared_ptr<logging::logger_t> log);
+    void write(const std::string& data, size_t count) override;
+private:
+    asio::ip::udp::endpoint endpoint;
+    size_t mtu;
+    size_t dropped;
+    std::shared_ptr<logging::logger_t> log;
+    asio::ip::udp::socket socket;
+};
+
+graphite_t::datagram_t::datagram_t(asio::io_service& asio,
+                                   const graphite_cfg_t& config,
+                                   std::shared_ptr<logging::logger_t> _log) :
+    endpoint(config.endpoint.address(), config.endpoint.port()),
+    mtu(config.mtu),
+    dropped(0),
+    log(std::move(_log)),
+    socket(asio, asio::ip::udp::endpoint(endpoint.protocol(), 0))
+{
+    socket.non_blocking(true);
+}
+
+void graphite_t::datagram_t::write(const std::string& data, size_t count) {
+    size_t lost = 0;
+    size_t begin = 0;
+    while(begin < data.size()) {
+        auto end = begin;
+        while(end < data.size()) {
+            auto next = data.find('\n', end);
+            next = next == std::string::npos ? data.size() : next + 1;
+            if(end != begin && next - begin > mtu) {
+                break;
+            }
+            end = next;
+        }
+
+        asio::error_code ec;
+        socket.send_to(asio::buffer(data.data() + begin, end - begin), endpoint, 0, ec);
+        if(ec) {
+            lost += count_lines(data, begin, end);
+            COCAINE_LOG_DEBUG(log, "Could not send datagram to graphite: {}", ec.message().c_str());
+        }
+        begin = end;
+    }
+
+    if(lost) {
+        dropped += lost;
+        COCAINE_LOG_WARNING(log, "Could not send {} of {} metrics to graphite, {} dropped in total", lost, count, dropped);
+    } else {
+        COCAINE_LOG_DEBUG(log, "Successfully sent {} metrics", count);
     }
 }
 
@@ -88,9 +333,43 @@ graphite_cfg_t::graphite_cfg_t(const cocaine::dynamic_t& args) :
     ),
     prefix(args.as_object().at("prefix", "cocaine").as_string()),
     flush_interval_ms(args.as_object().at("flush_interval_ms", 1000u).as_uint()),
-    max_queue_size(args.as_object().at("max_queue_size", 1000u).as_uint())
+    max_queue_size(args.as_object().at("max_queue_size", 1000u).as_uint()),
+    reconnect_interval_ms(args.as_object().at("reconnect_interval_ms", 1000u).as_uint()),
+    aggregate(args.as_object().at("aggregate", dynamic_t())),
+    max_buffer_bytes(args.as_object().at("max_buffer_bytes", 16u * 1024 * 1024).as_uint()),
+    drop_policy(drop_policy_t::oldest),
+    transport(transport_t::tcp),
+    // Fits into an ethernet frame with IPv4 and UDP headers.
+    mtu(args.as_object().at("mtu", 1472u).as_uint())
+{
+    const auto& _drop_policy = args.as_object().at("drop_policy", "oldest").as_string();
+    if(_drop_policy == "newest") {
+        drop_policy = drop_policy_t::newest;
+    } else if(_drop_policy != "oldest") {
+        throw error_t("invalid graphite drop policy - {}", _drop_policy);
+    }
+
+    const auto& _transport = args.as_object().at("transport", "tcp").as_string();
+    if(_transport == "udp") {
+        transport = transport_t::udp;
+    } else if(_transport != "tcp") {
+        throw error_t("invalid graphite transport - {}", _transport);
+    }
+
+    if(mtu == 0) {
+        throw error_t("graphite mtu can not be zero");
+    }
+}
+
+graphite_t::buffer_t::buffer_t(const dynamic_t& aggregate) :
+    metrics(),
+    aggregator(aggregate)
 {}
 
+size_t graphite_t::buffer_t::size() const {
+    return metrics.size() + aggregator.size();
+}
+
 graphite_t::graphite_t(context_t& context, asio::io_service& _asio, const std::string& name, const dynamic_t& args) :
     service_t(context, _asio, name, args),
     dispatch<io::graphite_tag>(name),
@@ -98,31 +377,40 @@ graphite_t::graphite_t(context_t& context, asio::io_service& _asio, const std::s
     config(args),
     log(context.log("graphite")),
     timer(asio),
-    buffer()
+    buffer(config.aggregate),
+    transport()
 {
+    if(config.transport == graphite_cfg_t::transport_t::udp) {
+        transport = std::make_shared<datagram_t>(asio, config, log);
+    } else {
+        transport = std::make_shared<connection_t>(asio, config, log);
+    }
+
     on<io::graphite::send_bulk>(std::bind(&graphite_t::on_send_bulk, this, ph::_1));
     on<io::graphite::send_one>(std::bind(&graphite_t::on_send_one, this, ph::_1));
     reset_timer();
 }
 
 void graphite_t::on_send_one(const graphite::metric_t& metric) {
-    size_t buffer_sz;
-    {
-        auto ptr = buffer.synchronize();
-        ptr->push_back(metric);
-        buffer_sz = ptr->size();
-    }
-    if(buffer_sz > config.max_queue_size) {
-        COCAINE_LOG_DEBUG(log, "Sending metrics by queue size");
-        send();
-    }
+    push(&metric, &metric + 1);
 }
 
 void graphite_t::on_send_bulk(const graphite::metric_pack_t& metrics) {
+    push(metrics.begin(), metrics.end());
+}
+
+template<class Iterator>
+void graphite_t::push(Iterator begin, Iterator end) {
     size_t buffer_sz;
     {
         auto ptr = buffer.synchronize();
-        ptr->insert(ptr->end(), metrics.begin(), metrics.end());
+        if(ptr->aggregator.enabled()) {
+            for(auto it = begin; it != end; ++it) {
+                ptr->aggregator.add(*it);
+            }
+        } else {
+            ptr->metrics.insert(ptr->metrics.end(), begin, end);
+        }
         buffer_sz = ptr->size();
     }
     if(buffer_sz > config.max_queue_size) {
@@ -143,11 +431,22 @@ void graphite_t::send_by_timer(const asio::error_code& error) {
 }
 
 void graphite_t::send() {
-    buffer_t tmp_buffer;
-    buffer.synchronize()->swap(tmp_buffer);
-    if(!tmp_buffer.empty()) {
-        auto sender = std::make_shared<graphite_sender_t>(this, std::move(tmp_buffer));
-        sender->send();
+    graphite::metric_pack_t metrics;
+    {
+        auto ptr = buffer.synchronize();
+        ptr->metrics.swap(metrics);
+        ptr->aggregator.take(metrics);
+    }
+    if(!metrics.empty()) {
+        std::string data;
+        for(size_t i = 0; i < metrics.size(); i++) {
+            data.append(metrics[i].format(config.prefix));
+        }
+        const auto count = metrics.size();
+        auto target = transport;
+        asio.post([=]() {
+            target->write(data, count);
+        });
     }
     reset_timer();
 }
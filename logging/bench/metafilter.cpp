@@ -0,0 +1,139 @@
+/*
+    Copyright (c) 2016 Anton Matveenko <antmat@yandex-team.ru>
+    Copyright (c) 2016 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Microbenchmark of filter evaluation: interpreted filter trees under a shared lock, as metafilter did before,
+// against the compiled program.
+// Usage: logging-metafilter-bench [iterations]
+
+#include "cocaine/logging/filter.hpp"
+#include "cocaine/logging/program.hpp"
+
+#include <blackhole/attribute.hpp>
+
+#include <boost/thread/locks.hpp>
+#include <boost/thread/shared_mutex.hpp>
+
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace cocaine;
+using namespace cocaine::logging;
+
+namespace {
+
+// Typical filters installed by users: severity threshold for an app, or a request trace.
+auto make_filter(size_t id) -> dynamic_t {
+    if(id % 3 == 2) {
+        return dynamic_t::array_t{
+            dynamic_t("||"),
+            dynamic_t::array_t{dynamic_t("=="), dynamic_t("trace_id"), dynamic_t(id)},
+            dynamic_t::array_t{dynamic_t("=="), dynamic_t("uuid"), dynamic_t("uuid-" + std::to_string(id))}
+        };
+    }
+    return dynamic_t::array_t{
+        dynamic_t("&&"),
+        dynamic_t::array_t{dynamic_t("severity"), dynamic_t(2u)},
+        dynamic_t::array_t{dynamic_t("=="), dynamic_t("app"), dynamic_t("app-" + std::to_string(id))}
+    };
+}
+
+template<class F>
+auto measure(const std::string& name, size_t iterations, F f) -> void {
+    size_t accepted = 0;
+    auto start = std::chrono::steady_clock::now();
+    for(size_t i = 0; i < iterations; i++) {
+        accepted += f() == filter_result_t::accept;
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+    std::cout << std::left << std::setw(40) << name
+              << std::right << std::setw(10) << ns / static_cast<double>(iterations) << " ns/op"
+              << std::setw(10) << accepted << " accepted" << std::endl;
+}
+
+auto run(size_t count, size_t iterations) -> void {
+    const filter_t::deadline_t deadline = std::time(nullptr) + 3600;
+
+    std::vector<filter_info_t> filters;
+    for(size_t i = 0; i < count; i++) {
+        filters.emplace_back(filter_t(make_filter(i)), deadline, i, filter_t::disposition_t::local, "app");
+    }
+    const program_t program(filters, program_t::policies_t());
+    boost::shared_mutex mutex;
+
+    const auto matching = "app-" + std::to_string(count - 1);
+    const blackhole::attribute_list hit {
+        {"source", "app/service"}, {"uuid", "af3b6a1c"}, {"trace_id", 42}, {"span_id", 43}, {"app", matching}
+    };
+    const blackhole::attribute_list miss {
+        {"source", "app/service"}, {"uuid", "af3b6a1c"}, {"trace_id", 42}, {"span_id", 43}, {"app", "unknown"}
+    };
+
+    struct record_t {
+        std::string name;
+        blackhole::severity_t severity;
+        blackhole::attribute_pack pack;
+    };
+
+    const std::vector<record_t> records {
+        {"hit", 3, blackhole::attribute_pack{hit}},
+        {"miss", 3, blackhole::attribute_pack{miss}},
+        {"low severity", 0, blackhole::attribute_pack{miss}}
+    };
+
+    for(auto record : records) {
+        const auto prefix = std::to_string(count) + " filters/" + record.name;
+
+        measure(prefix + "/interpreted", iterations, [&] {
+            auto now = static_cast<uint64_t>(std::time(nullptr));
+            boost::shared_lock<boost::shared_mutex> guard(mutex);
+            auto result = filter_result_t::reject;
+            for(const auto& info : filters) {
+                if(now <= info.deadline && result == filter_result_t::reject &&
+                   info.filter.apply(record.severity, record.pack) == filter_result_t::accept)
+                {
+                    result = filter_result_t::accept;
+                }
+            }
+            return result;
+        });
+
+        measure(prefix + "/compiled", iterations, [&] {
+            return program.apply(record.severity, record.pack);
+        });
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const size_t iterations = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+
+    for(size_t count : {1, 10, 100}) {
+        run(count, count > 10 ? iterations / 10 : iterations);
+    }
+
+    return 0;
+}
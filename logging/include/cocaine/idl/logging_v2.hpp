@@ -29,6 +29,10 @@
 
 #include <blackhole/attribute.hpp>
 
+#include <string>
+#include <tuple>
+#include <vector>
+
 namespace cocaine {
 namespace io {
 
@@ -240,6 +244,26 @@ struct named_log {
 
         typedef named_log_tag dispatch_type;
     };
+
+    /**
+     * Emits a bunch of records in a single frame, filtered against the same snapshot of filters.
+     * Semantically equivalent to a sequence of emit events.
+     */
+    struct emit_batch {
+        typedef named_log_tag tag;
+
+        static const char* alias() {
+            return "emit_batch";
+        }
+
+        typedef boost::mpl::list<
+        /* Log records - severity, message and attached attributes. */
+        std::vector<std::tuple<unsigned int, std::string, logging::attributes_t>>>::type argument_type;
+
+        typedef base_log::get::upstream_type upstream_type;
+
+        typedef named_log_tag dispatch_type;
+    };
 };
 
 template <>
@@ -265,7 +289,7 @@ template <>
 struct protocol<named_log_tag> {
     typedef boost::mpl::int_<1>::type version;
 
-    typedef boost::mpl::list<named_log::emit, named_log::emit_ack>::type messages;
+    typedef boost::mpl::list<named_log::emit, named_log::emit_ack, named_log::emit_batch>::type messages;
 
     typedef named_log_tag transition_type;
     typedef named_log scope;
@@ -0,0 +1,59 @@
+/*
+    Copyright (c) 2016 Anton Matveenko <antmat@yandex-team.ru>
+    Copyright (c) 2016 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+namespace cocaine {
+namespace logging {
+
+/**
+ * Counter of pending increments split into stripes, each occupying its own cache lines.
+ * Threads are spread over stripes, so concurrent increments do not contend for the same cache line.
+ * Increments are collected with take, which is expected to be called rarely compared to add.
+ */
+class striped_counter_t {
+public:
+    striped_counter_t();
+    striped_counter_t(const striped_counter_t&) = delete;
+    striped_counter_t& operator=(const striped_counter_t&) = delete;
+
+    auto add(uint64_t value) -> void;
+
+    /// Returns the sum of increments made since the previous call and resets the counter.
+    auto take() -> uint64_t;
+
+private:
+    // Stripes are not guaranteed to be aligned, so two cache lines per stripe keep the counters of
+    // neighbour stripes on distinct ones.
+    struct stripe_t {
+        std::atomic<uint64_t> value;
+        char padding[128 - sizeof(std::atomic<uint64_t>)];
+    };
+
+    const size_t size;
+    std::unique_ptr<stripe_t[]> stripes;
+};
+
+}
+}  // namespace cocaine::logging
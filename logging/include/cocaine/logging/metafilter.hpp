@@ -20,7 +20,10 @@
 
 #pragma once
 
+#include "cocaine/logging/counter.hpp"
 #include "cocaine/logging/filter.hpp"
+#include "cocaine/logging/policy.hpp"
+#include "cocaine/logging/program.hpp"
 
 #include <cocaine/repository.hpp>
 
@@ -29,6 +32,8 @@
 #include <metrics/metric.hpp>
 
 #include <atomic>
+#include <map>
+#include <memory>
 
 namespace cocaine {
 namespace logging {
@@ -37,27 +42,71 @@ namespace logging {
  * Class, holding a bunch of filters
  * All filters are join with OR expression -
  * if one of the filter accepts message, message is accepted.
+ * Throttling policies are held along with filters and limit accepted messages afterwards.
+ * Metafilter having policies only selects messages with the fallback one, if any.
  */
 class metafilter_t {
 public:
-    metafilter_t(context_t& context, std::string name, std::unique_ptr<logger_t> _logger);
+    metafilter_t(context_t& context, std::string name, std::unique_ptr<logger_t> _logger,
+                 std::shared_ptr<metafilter_t> fallback = nullptr);
     metafilter_t(const metafilter_t&) = delete;
     metafilter_t& operator=(const metafilter_t&) = delete;
 
+    ~metafilter_t();
+
     filter_result_t apply(blackhole::severity_t severity,
                           blackhole::attribute_pack& attributes);
 
+    /**
+     * Snapshot of the filter set applied to a series of records, f.e. a batch received in a single frame.
+     * Counters are updated once, when the batch is destroyed.
+     */
+    class batch_t {
+    public:
+        explicit
+        batch_t(metafilter_t& parent);
+        batch_t(const batch_t&) = delete;
+        batch_t& operator=(const batch_t&) = delete;
+
+        ~batch_t();
+
+        filter_result_t apply(blackhole::severity_t severity,
+                              const blackhole::attribute_pack& attributes);
+
+    private:
+        metafilter_t& parent;
+        std::shared_ptr<const program_t> program;
+        uint64_t accepted;
+        uint64_t rejected;
+        uint64_t suppressed;
+    };
+
     void add_filter(filter_info_t filter);
 
     bool remove_filter(filter_t::id_t filter_id);
 
     bool empty() const;
 
+    /// Whether there are policies, but no filters selecting records, so that the fallback is needed.
+    auto policies_only() const -> bool;
+
+    /// Replaces the metafilter selecting records while this one holds policies only. Thread safe.
+    auto set_fallback(std::shared_ptr<metafilter_t> fallback) -> void;
+
+    auto has_fallback() const -> bool;
+
     typedef std::function<void(const logging::filter_info_t&)> callable_t;
 
     void each(const callable_t& fn) const;
 
-    void cleanup();
+    /// Removes filters expired at the given unix timestamp.
+    auto expire(uint64_t now) -> void;
+
+    /// The earliest deadline among filters, maximum value if there are none.
+    auto deadline() const -> filter_t::deadline_t;
+
+    /// Moves increments accumulated in striped counters to metrics.
+    auto flush() -> void;
 
     struct counter_t {
         size_t accepted;
@@ -67,17 +116,33 @@ public:
     counter_t since_create();
     counter_t since_last_change();
 
+    /// Number of messages refused by policies since the previous call.
+    auto suppressed() -> uint64_t;
+
 private:
     auto remove_filter(std::vector<filter_info_t>::iterator it) -> std::vector<filter_info_t>::iterator;
 
+    // Selects message with own filters or with fallback ones and passes it through the policies.
+    auto evaluate(const program_t& current, blackhole::severity_t severity,
+                  const blackhole::attribute_pack& attributes, bool& suppressed) const -> filter_result_t;
+
+    auto suppress(uint64_t value) -> void;
+
+    // Recompiles filters and publishes the program for apply. Must be called under the write lock.
+    auto publish() -> void;
+
     std::string name;
 
+    // Records are counted in striped counters, shared metrics are updated on flush only, because
+    // all threads processing records of a metafilter would contend for them otherwise.
     struct processed_t {
         processed_t(context_t& context, const std::string& name, const std::string& type);
 
-        auto increment() -> void;
+        auto increment(uint64_t value = 1) -> void;
         auto on_changed() -> void;
+        auto flush() -> void;
 
+        striped_counter_t pending;
         metrics::shared_metric<std::atomic<uint64_t>> count;
         metrics::shared_metric<std::atomic<uint64_t>> overall_count;
         metrics::shared_metric<std::atomic<uint64_t>> count_since_change;
@@ -86,9 +151,25 @@ private:
     processed_t accepted;
     processed_t rejected;
 
+    // Messages accepted by filters, but refused by policies. They are counted as rejected as well.
+    striped_counter_t suppressed_pending;
+    metrics::shared_metric<std::atomic<uint64_t>> suppressed_count;
+    std::atomic<uint64_t> suppressed_since_report;
+
     std::unique_ptr<logger_t> logger;
+    // Accessed only via atomic operations, as it is replaced while records are being applied.
+    std::shared_ptr<metafilter_t> fallback;
     std::vector<filter_info_t> filters;
 
+    // Filter ids ordered by deadline, so that expiration does not scan all filters.
+    std::multimap<filter_t::deadline_t, filter_t::id_t> deadlines;
+
+    // Policies keep their state, so they are created once per filter and survive recompilations.
+    program_t::policies_t policies;
+
+    // Compiled filters, accessed only via atomic operations so that apply never takes the lock.
+    std::shared_ptr<const program_t> program;
+
     mutable boost::shared_mutex mutex;
 };
 }
@@ -0,0 +1,67 @@
+/*
+    Copyright (c) 2016 Anton Matveenko <antmat@yandex-team.ru>
+    Copyright (c) 2016 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "cocaine/logging/filter.hpp"
+
+#include <atomic>
+#include <cstdint>
+
+namespace cocaine {
+namespace logging {
+
+/**
+ * Throttling policy of a logger.
+ * Policies are set, stored and expired as filters, but instead of selecting records
+ * they limit the records already accepted by filters. Representations are:
+ *  ["rate", records per second, burst] - token bucket rate limit;
+ *  ["sample", ratio] - probabilistic sampling, ratio is in [0, 1].
+ */
+class policy_t {
+public:
+    static
+    auto is_policy(const filter_t::representation_t& representation) -> bool;
+
+    explicit
+    policy_t(const filter_t::representation_t& representation);
+
+    policy_t(const policy_t&) = delete;
+    policy_t& operator=(const policy_t&) = delete;
+
+    /// Decides whether the record passes the policy. Thread safe and lock-free.
+    auto admit() -> bool;
+
+private:
+    enum class type_t { rate, sample };
+
+    type_t type;
+
+    // Token bucket implemented as generic cell rate algorithm - theoretical arrival time of the next record and
+    // how far ahead of the current time it may be, in nanoseconds of steady clock.
+    std::atomic<int64_t> arrival;
+    int64_t interval;
+    int64_t tolerance;
+
+    double ratio;
+};
+
+}
+}  // namespace cocaine::logging
@@ -0,0 +1,131 @@
+/*
+    Copyright (c) 2016 Anton Matveenko <antmat@yandex-team.ru>
+    Copyright (c) 2016 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "cocaine/logging/filter.hpp"
+#include "cocaine/logging/policy.hpp"
+
+#include <blackhole/attribute.hpp>
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace cocaine {
+namespace logging {
+
+/**
+ * Immutable compiled form of a set of filters joined with OR expression.
+ * Filter trees are flattened into a single instruction array evaluated by a switch,
+ * attribute names are interned so that every name is looked up in a record at most once,
+ * and records below the lowest severity any filter can accept are rejected without evaluation.
+ * Throttling policies are not compiled, but referenced, as they keep their state between recompilations.
+ * Programs know nothing about filter deadlines - expired filters are removed by recompilation.
+ */
+class program_t {
+public:
+    typedef std::map<filter_t::id_t, std::shared_ptr<policy_t>> policies_t;
+
+    /// Constructs empty program rejecting everything.
+    program_t();
+
+    /// Compiles filters, the ones found in policies are treated as throttling policies.
+    program_t(const std::vector<filter_info_t>& filters, const policies_t& policies);
+
+    auto apply(blackhole::severity_t severity, const blackhole::attribute_pack& attributes) const -> filter_result_t;
+
+    /// Passes a record accepted by filters through throttling policies, all of them should admit it.
+    auto admit() const -> bool;
+
+    /// Whether there are neither filters nor policies.
+    auto empty() const -> bool;
+
+    /// Whether there are filters selecting records, as opposed to throttling policies only.
+    auto selective() const -> bool;
+
+private:
+    enum class opcode_t : uint8_t {
+        accept,
+        severity,
+        traced,
+        exists,
+        not_exists,
+        equals,
+        not_equals,
+        greater,
+        less,
+        greater_or_equal,
+        less_or_equal,
+        disjunction,
+        conjunction,
+        exclusive
+    };
+
+    enum class type_t : uint8_t {
+        boolean,
+        sint,
+        uint,
+        real,
+        string
+    };
+
+    struct instruction_t {
+        opcode_t opcode;
+        type_t type;
+        // Operand instructions for logical operators, interned attribute name for comparisons.
+        uint32_t lhs;
+        uint32_t rhs;
+        union {
+            bool boolean;
+            int64_t sint;
+            uint64_t uint;
+            double real;
+            // Index in constants table.
+            uint32_t string;
+            blackhole::severity_t severity;
+        };
+    };
+
+    class lookup_t;
+    class compiler_t;
+
+    auto eval(uint32_t pc, blackhole::severity_t severity, lookup_t& lookup) const -> bool;
+
+    auto compare(const instruction_t& instruction, const blackhole::attribute::view_t& value) const -> bool;
+
+    template<class T>
+    static
+    auto compare(opcode_t opcode, const blackhole::attribute::view_t& value, const T& reference) -> bool;
+
+    std::vector<instruction_t> code;
+    // Root instructions of filters.
+    std::vector<uint32_t> roots;
+    std::vector<std::shared_ptr<policy_t>> throttles;
+    std::vector<std::string> names;
+    std::vector<std::string> constants;
+
+    blackhole::severity_t min_severity;
+};
+
+}
+}  // namespace cocaine::logging
@@ -0,0 +1,112 @@
+/*
+    Copyright (c) 2016 Anton Matveenko <antmat@yandex-team.ru>
+    Copyright (c) 2016 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "cocaine/logging/attribute.hpp"
+
+#include <cocaine/forwards.hpp>
+#include <cocaine/logging.hpp>
+#include <cocaine/trace/trace.hpp>
+
+#include <blackhole/attributes.hpp>
+#include <blackhole/severity.hpp>
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace cocaine {
+namespace logging {
+
+/**
+ * Stage between filtering and the root logger.
+ * Without "queue" section in args records are written synchronously by the calling thread.
+ * Otherwise they are put into a bounded ring buffer drained by a dedicated writer thread,
+ * so a slow backend does not stall logging RPC. Configured as
+ * {"capacity": 65536, "overflow": "block" | "drop_oldest" | "drop_by_severity", "drop_severity": 1}
+ */
+class writer_t {
+public:
+    enum class overflow_t {
+        // Producers wait for free space.
+        block,
+        // The oldest queued record is discarded to make room.
+        drop_oldest,
+        // Records below drop_severity are discarded when the queue is full, the rest wait for free space.
+        drop_by_severity
+    };
+
+    writer_t(context_t& context, logger_t& log, const dynamic_t& args);
+    writer_t(const writer_t&) = delete;
+    writer_t& operator=(const writer_t&) = delete;
+
+    /// Drains everything queued so far before returning.
+    ~writer_t();
+
+    /**
+     * Write already filtered record.
+     * Attribute pack is the view of attributes extended with the source, which is only used in synchronous mode,
+     * while asynchronous one copies attributes and adds the source by itself.
+     */
+    auto write(blackhole::severity_t severity,
+               const std::string& message,
+               const std::string& backend,
+               const attributes_t& attributes,
+               blackhole::attribute_pack& pack) -> void;
+
+private:
+    struct record_t {
+        blackhole::severity_t severity;
+        std::string message;
+        std::string backend;
+        attributes_t attributes;
+        trace_t trace;
+    };
+
+    auto run() -> void;
+
+    auto drop(const std::string& backend) -> void;
+
+    context_t& context;
+    logger_t& log;
+
+    const size_t capacity;
+    const overflow_t overflow;
+    const blackhole::severity_t drop_severity;
+
+    std::mutex mutex;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+
+    // Ring buffer of capacity slots, records occupy [head, head + size) modulo capacity.
+    std::vector<record_t> ring;
+    size_t head;
+    size_t size;
+    bool stopped;
+
+    std::thread thread;
+};
+
+}
+}  // namespace cocaine::logging
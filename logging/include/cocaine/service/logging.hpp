@@ -33,6 +33,7 @@
 namespace cocaine {
 namespace logging {
 class metafilter_t;
+class writer_t;
 }
 }
 
@@ -55,10 +56,10 @@ private:
 
 class named_logging_t : public dispatch<io::named_log_tag> {
 public:
-    named_logging_t(logging::logger_t& log, std::string name, std::shared_ptr<logging::metafilter_t> filter);
+    named_logging_t(logging::writer_t& writer, std::string name, std::shared_ptr<logging::metafilter_t> filter);
 
 private:
-    logging::logger_t& log;
+    logging::writer_t& writer;
     std::string backend;
     std::shared_ptr<logging::metafilter_t> filter;
 };
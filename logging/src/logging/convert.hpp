@@ -0,0 +1,242 @@
+/*
+    Copyright (c) 2016 Anton Matveenko <antmat@yandex-team.ru>
+    Copyright (c) 2016 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "cocaine/logging/attribute.hpp"
+
+#include <blackhole/attribute.hpp>
+
+#include <boost/optional/optional.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <type_traits>
+
+namespace cocaine {
+namespace logging {
+
+// Conversions of attribute views to the types filters are defined with. Shared by filters and compiled programs, so
+// both of them give the same answer for the same record.
+inline auto operator<(const blackhole::stdext::string_view& lhs, const std::string& rhs) -> bool
+{
+    return std::lexicographical_compare(lhs.data(), lhs.data() + lhs.size(),
+                                        rhs.data(), rhs.data() + rhs.size());
+}
+
+inline auto operator>(const blackhole::stdext::string_view& lhs, const std::string& rhs) -> bool
+{
+    std::greater<char> comp;
+    return std::lexicographical_compare(lhs.data(), lhs.data() + lhs.size(),
+                                        rhs.data(), rhs.data() + rhs.size(), comp);
+}
+
+inline auto operator<=(const blackhole::stdext::string_view& lhs, const std::string& rhs) -> bool
+{
+    return !(lhs > rhs);
+}
+
+inline auto operator>=(const blackhole::stdext::string_view& lhs, const std::string& rhs) -> bool
+{
+    return !(lhs < rhs);
+}
+
+template <class T>
+struct view_of {
+    typedef T type;
+};
+
+template <>
+struct view_of<std::string> {
+    typedef blackhole::stdext::string_view type;
+};
+
+
+template <class T>
+struct to;
+
+template<>
+struct to<int64_t> : public blackhole::attribute::view_t::visitor_t {
+    typedef blackhole::attribute::view_t value_t;
+    static constexpr int64_t max = std::numeric_limits<int64_t>::max();
+
+    int64_t result;
+    bool failed;
+
+    to() : result(), failed() {}
+
+    void fail() {
+        failed = true;
+    }
+
+    virtual auto operator()(const value_t::null_type&) -> void {
+        result = 0;
+    }
+
+    virtual auto operator()(const value_t::bool_type& val) -> void {
+        result = static_cast<int64_t>(val);
+    }
+
+    virtual auto operator()(const value_t::sint64_type& val) -> void {
+        result = val;
+    }
+    virtual auto operator()(const value_t::uint64_type& val) -> void {
+        if(val > max) {
+            fail();
+        }
+        result = val;
+    }
+    virtual auto operator()(const value_t::double_type& val) -> void {
+        result = static_cast<int64_t>(val);
+    }
+    virtual auto operator()(const value_t::string_type&) -> void {
+        fail();
+    }
+    virtual auto operator()(const value_t::function_type&) -> void {
+        fail();
+    }
+};
+
+template<>
+struct to<blackhole::stdext::string_view> : public blackhole::attribute::view_t::visitor_t {
+    typedef blackhole::attribute::view_t value_t;
+
+    blackhole::stdext::string_view result;
+    bool failed;
+
+    to() : result(), failed() {}
+
+    void fail() {
+        failed = true;
+    }
+
+    virtual auto operator()(const value_t::null_type&) -> void {
+    }
+
+    virtual auto operator()(const value_t::bool_type&) -> void {
+        fail();
+    }
+
+    virtual auto operator()(const value_t::sint64_type&) -> void {
+        fail();
+    }
+    virtual auto operator()(const value_t::uint64_type&) -> void {
+        fail();
+    }
+    virtual auto operator()(const value_t::double_type&) -> void {
+        fail();
+    }
+    virtual auto operator()(const value_t::string_type& val) -> void {
+        result = val;
+    }
+    virtual auto operator()(const value_t::function_type&) -> void {
+        fail();
+    }
+};
+
+template<>
+struct to<double> : public blackhole::attribute::view_t::visitor_t {
+    typedef blackhole::attribute::view_t value_t;
+
+    double result;
+    bool failed;
+
+    to() : result(), failed() {}
+
+    void fail() {
+        failed = true;
+    }
+
+    virtual auto operator()(const value_t::null_type&) -> void {
+    }
+
+    virtual auto operator()(const value_t::bool_type& val) -> void {
+        result = static_cast<double>(val);
+    }
+
+    virtual auto operator()(const value_t::sint64_type& val) -> void {
+        result = val;
+    }
+    virtual auto operator()(const value_t::uint64_type& val) -> void {
+        result = val;
+    }
+    virtual auto operator()(const value_t::double_type& val) -> void {
+        result = val;
+    }
+    virtual auto operator()(const value_t::string_type&) -> void {
+        fail();
+    }
+    virtual auto operator()(const value_t::function_type&) -> void {
+        fail();
+    }
+};
+
+template<class T>
+typename std::enable_if<std::is_integral<T>::value, bool>::type
+convert(const blackhole::attribute::view_t& value, T& target) {
+    to<int64_t> visitor;
+    value.apply(visitor);
+    if(!visitor.failed) {
+        target = static_cast<T>(visitor.result);
+        return true;
+    }
+    return false;
+}
+
+template<class T>
+typename std::enable_if<std::is_floating_point<T>::value, bool>::type
+convert(const blackhole::attribute::view_t& value, T& target) {
+    to<double> visitor;
+    value.apply(visitor);
+    if(!visitor.failed) {
+        target = static_cast<T>(visitor.result);
+        return true;
+    }
+    return false;
+}
+
+template<class T>
+inline bool
+convert(const blackhole::attribute::view_t& value, blackhole::stdext::string_view& target) {
+    to<blackhole::stdext::string_view> visitor;
+    value.apply(visitor);
+    if(!visitor.failed) {
+        target = visitor.result;
+        return true;
+    }
+    return false;
+}
+
+inline boost::optional<const attribute_view_t&> find_attribute(const blackhole::attribute_pack& attribute_pack,
+                                                          const std::string& attribute_name) {
+    for(const auto& attributes : attribute_pack) {
+        for(const auto& attribute : attributes.get()) {
+            if(attribute.first == attribute_name) {
+                return boost::optional<const attribute_view_t&>(attribute);
+            }
+        }
+    }
+    return boost::none;
+}
+
+}
+}  // namespace cocaine::logging
@@ -0,0 +1,62 @@
+/*
+    Copyright (c) 2016 Anton Matveenko <antmat@yandex-team.ru>
+    Copyright (c) 2016 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "cocaine/logging/counter.hpp"
+
+#include <algorithm>
+#include <thread>
+
+namespace cocaine {
+namespace logging {
+
+namespace {
+
+// Threads are assigned stripes in round-robin order on their first increment.
+auto thread_index() -> size_t {
+    static std::atomic<size_t> next(0);
+    static thread_local size_t index = next.fetch_add(1, std::memory_order_relaxed);
+    return index;
+}
+
+}
+
+striped_counter_t::striped_counter_t() :
+    size(std::max(1u, std::thread::hardware_concurrency())),
+    stripes(new stripe_t[size])
+{
+    for(size_t i = 0; i < size; i++) {
+        stripes[i].value.store(0, std::memory_order_relaxed);
+    }
+}
+
+auto striped_counter_t::add(uint64_t value) -> void {
+    stripes[thread_index() % size].value.fetch_add(value, std::memory_order_relaxed);
+}
+
+auto striped_counter_t::take() -> uint64_t {
+    uint64_t sum = 0;
+    for(size_t i = 0; i < size; i++) {
+        sum += stripes[i].value.exchange(0, std::memory_order_relaxed);
+    }
+    return sum;
+}
+
+}
+}  // namespace cocaine::logging
@@ -19,6 +19,9 @@
 */
 
 #include "cocaine/logging/filter.hpp"
+#include "cocaine/logging/policy.hpp"
+
+#include "convert.hpp"
 
 #include <cocaine/errors.hpp>
 #include <cocaine/format.hpp>
@@ -31,211 +34,6 @@
 namespace cocaine {
 namespace logging {
 
-namespace {
-
-auto operator<(const blackhole::stdext::string_view& lhs, const std::string& rhs) -> bool
-{
-    return std::lexicographical_compare(lhs.data(), lhs.data() + lhs.size(),
-                                        rhs.data(), rhs.data() + rhs.size());
-}
-
-auto operator>(const blackhole::stdext::string_view& lhs, const std::string& rhs) -> bool
-{
-    std::greater<char> comp;
-    return std::lexicographical_compare(lhs.data(), lhs.data() + lhs.size(),
-                                        rhs.data(), rhs.data() + rhs.size(), comp);
-}
-
-auto operator<=(const blackhole::stdext::string_view& lhs, const std::string& rhs) -> bool
-{
-    return !(lhs > rhs);
-}
-
-auto operator>=(const blackhole::stdext::string_view& lhs, const std::string& rhs) -> bool
-{
-    return !(lhs < rhs);
-}
-
-template <class T>
-struct view_of {
-    typedef T type;
-};
-
-template <>
-struct view_of<std::string> {
-    typedef blackhole::stdext::string_view type;
-};
-
-
-template <class T>
-struct to;
-
-template<>
-struct to<int64_t> : public blackhole::attribute::view_t::visitor_t {
-    typedef blackhole::attribute::view_t value_t;
-    static constexpr int64_t max = std::numeric_limits<int64_t>::max();
-
-    int64_t result;
-    bool failed;
-
-    to() : result(), failed() {}
-
-    void fail() {
-        failed = true;
-    }
-
-    virtual auto operator()(const value_t::null_type&) -> void {
-        result = 0;
-    }
-
-    virtual auto operator()(const value_t::bool_type& val) -> void {
-        result = static_cast<int64_t>(val);
-    }
-
-    virtual auto operator()(const value_t::sint64_type& val) -> void {
-        result = val;
-    }
-    virtual auto operator()(const value_t::uint64_type& val) -> void {
-        if(val > max) {
-            fail();
-        }
-        result = val;
-    }
-    virtual auto operator()(const value_t::double_type& val) -> void {
-        result = static_cast<int64_t>(val);
-    }
-    virtual auto operator()(const value_t::string_type&) -> void {
-        fail();
-    }
-    virtual auto operator()(const value_t::function_type&) -> void {
-        fail();
-    }
-};
-
-template<>
-struct to<blackhole::stdext::string_view> : public blackhole::attribute::view_t::visitor_t {
-    typedef blackhole::attribute::view_t value_t;
-
-    blackhole::stdext::string_view result;
-    bool failed;
-
-    to() : result(), failed() {}
-
-    void fail() {
-        failed = true;
-    }
-
-    virtual auto operator()(const value_t::null_type&) -> void {
-    }
-
-    virtual auto operator()(const value_t::bool_type&) -> void {
-        fail();
-    }
-
-    virtual auto operator()(const value_t::sint64_type&) -> void {
-        fail();
-    }
-    virtual auto operator()(const value_t::uint64_type&) -> void {
-        fail();
-    }
-    virtual auto operator()(const value_t::double_type&) -> void {
-        fail();
-    }
-    virtual auto operator()(const value_t::string_type& val) -> void {
-        result = val;
-    }
-    virtual auto operator()(const value_t::function_type&) -> void {
-        fail();
-    }
-};
-
-template<>
-struct to<double> : public blackhole::attribute::view_t::visitor_t {
-    typedef blackhole::attribute::view_t value_t;
-
-    double result;
-    bool failed;
-
-    to() : result(), failed() {}
-
-    void fail() {
-        failed = true;
-    }
-
-    virtual auto operator()(const value_t::null_type&) -> void {
-    }
-
-    virtual auto operator()(const value_t::bool_type& val) -> void {
-        result = static_cast<double>(val);
-    }
-
-    virtual auto operator()(const value_t::sint64_type& val) -> void {
-        result = val;
-    }
-    virtual auto operator()(const value_t::uint64_type& val) -> void {
-        result = val;
-    }
-    virtual auto operator()(const value_t::double_type& val) -> void {
-        result = val;
-    }
-    virtual auto operator()(const value_t::string_type&) -> void {
-        fail();
-    }
-    virtual auto operator()(const value_t::function_type&) -> void {
-        fail();
-    }
-};
-
-template<class T>
-typename std::enable_if<std::is_integral<T>::value, bool>::type
-convert(const blackhole::attribute::view_t& value, T& target) {
-    to<int64_t> visitor;
-    value.apply(visitor);
-    if(!visitor.failed) {
-        target = static_cast<T>(visitor.result);
-        return true;
-    }
-    return false;
-}
-
-template<class T>
-typename std::enable_if<std::is_floating_point<T>::value, bool>::type
-convert(const blackhole::attribute::view_t& value, T& target) {
-    to<double> visitor;
-    value.apply(visitor);
-    if(!visitor.failed) {
-        target = static_cast<T>(visitor.result);
-        return true;
-    }
-    return false;
-}
-
-template<class T>
-bool
-convert(const blackhole::attribute::view_t& value, blackhole::stdext::string_view& target) {
-    to<blackhole::stdext::string_view> visitor;
-    value.apply(visitor);
-    if(!visitor.failed) {
-        target = visitor.result;
-        return true;
-    }
-    return false;
-}
-
-inline boost::optional<const attribute_view_t&> find_attribute(const blackhole::attribute_pack& attribute_pack,
-                                                          const std::string& attribute_name) {
-    for(const auto& attributes : attribute_pack) {
-        for(const auto& attribute : attributes.get()) {
-            if(attribute.first == attribute_name) {
-                return boost::optional<const attribute_view_t&>(attribute);
-            }
-        }
-    }
-    return boost::none;
-}
-
-}
-
 filter_info_t::filter_info_t(filter_t _filter,
                              filter_t::deadline_t _deadline,
                              filter_t::id_t _id,
@@ -618,6 +416,24 @@ struct xor_filter_t : public filter_t::inner_t {
     };
 };
 
+// Throttling policy, kept by metafilter apart from filters. It does not select records on its own.
+struct policy_filter_t : public filter_t::inner_t {
+    dynamic_t source;
+
+    policy_filter_t(dynamic_t _source) : source(std::move(_source)) {
+        // Validates representation.
+        policy_t policy(source);
+    }
+
+    virtual filter_result_t apply(blackhole::severity_t, blackhole::attribute_pack&) const {
+        return fr::accept;
+    }
+
+    virtual dynamic_t representation() const {
+        return source;
+    };
+};
+
 struct traced_filter_t : public filter_t::inner_t {
     traced_filter_t() {}
 
@@ -723,7 +539,9 @@ filter_t::filter_t(const dynamic_t& source) {
     }
     const auto& filter_operator = array[0].as_string();
     const auto& operand1 = array[1];
-    if (array.size() == 1 && array[0].is_string()) {
+    if (policy_t::is_policy(source)) {
+        inner.reset(new policy_filter_t(source));
+    } else if (array.size() == 1 && array[0].is_string()) {
         if(array[0].as_string() == "empty") {
             inner.reset(new empty_filter_t());
         } else if(array[0].as_string() == "traced") {
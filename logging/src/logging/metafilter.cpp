@@ -27,6 +27,7 @@
 
 #include <metrics/registry.hpp>
 
+#include <limits>
 #include <mutex>
 
 namespace cocaine {
@@ -39,23 +40,41 @@ metafilter_t::processed_t::processed_t(context_t& context, const std::string& na
 {
 }
 
-auto metafilter_t::processed_t::increment() -> void {
-    count->operator++();
-    overall_count->operator++();
-    count_since_change->operator++();
+auto metafilter_t::processed_t::increment(uint64_t value) -> void {
+    pending.add(value);
 }
 
 auto metafilter_t::processed_t::on_changed() -> void {
+    // Records processed so far belong to the previous filter set.
+    flush();
     count_since_change->store(0ull);
 }
 
-metafilter_t::metafilter_t(context_t& context, std::string _name, std::unique_ptr<logger_t> _logger) :
+auto metafilter_t::processed_t::flush() -> void {
+    auto value = pending.take();
+    if(value) {
+        count->fetch_add(value);
+        overall_count->fetch_add(value);
+        count_since_change->fetch_add(value);
+    }
+}
+
+metafilter_t::metafilter_t(context_t& context, std::string _name, std::unique_ptr<logger_t> _logger,
+                           std::shared_ptr<metafilter_t> _fallback) :
         name(std::move(_name)),
         accepted(context, name, "accepted"),
         rejected(context, name, "rejected"),
-        logger(std::move(_logger))
+        suppressed_count(context.metrics_hub().counter<uint64_t>(format("logging.{}.suppressed.count", name))),
+        suppressed_since_report(0),
+        logger(std::move(_logger)),
+        fallback(std::move(_fallback)),
+        program(std::make_shared<program_t>())
 {}
 
+metafilter_t::~metafilter_t() {
+    flush();
+}
+
 void metafilter_t::add_filter(filter_info_t filter) {
     std::lock_guard<boost::shared_mutex> guard(mutex);
     auto id = filter.id;
@@ -63,7 +82,12 @@ void metafilter_t::add_filter(filter_info_t filter) {
         return info.id == id;
     });
     if(it == filters.end()) {
+        if(policy_t::is_policy(filter.filter.representation())) {
+            policies[id] = std::make_shared<policy_t>(filter.filter.representation());
+        }
+        deadlines.emplace(filter.deadline, id);
         filters.push_back(std::move(filter));
+        publish();
         accepted.on_changed();
         rejected.on_changed();
     }
@@ -79,6 +103,7 @@ bool metafilter_t::remove_filter(filter_t::id_t filter_id) {
         return false;
     } else {
         remove_filter(it);
+        publish();
         return true;
     }
 }
@@ -86,34 +111,89 @@ bool metafilter_t::remove_filter(filter_t::id_t filter_id) {
 std::vector<filter_info_t>::iterator metafilter_t::remove_filter(std::vector<filter_info_t>::iterator it) {
     accepted.on_changed();
     rejected.on_changed();
+    policies.erase(it->id);
+    auto range = deadlines.equal_range(it->deadline);
+    for(auto deadline = range.first; deadline != range.second; ++deadline) {
+        if(deadline->second == it->id) {
+            deadlines.erase(deadline);
+            break;
+        }
+    }
     return filters.erase(it);
 }
 
+auto metafilter_t::publish() -> void {
+    std::atomic_store(&program, std::shared_ptr<const program_t>(std::make_shared<program_t>(filters, policies)));
+}
+
 bool metafilter_t::empty() const {
-    boost::shared_lock<boost::shared_mutex> guard(mutex);
-    return filters.empty();
+    return std::atomic_load(&program)->empty();
+}
+
+auto metafilter_t::policies_only() const -> bool {
+    auto current = std::atomic_load(&program);
+    return !current->empty() && !current->selective();
+}
+
+auto metafilter_t::set_fallback(std::shared_ptr<metafilter_t> _fallback) -> void {
+    std::atomic_store(&fallback, std::move(_fallback));
+}
+
+auto metafilter_t::has_fallback() const -> bool {
+    return std::atomic_load(&fallback) != nullptr;
+}
+
+auto metafilter_t::evaluate(const program_t& current, blackhole::severity_t severity,
+                            const blackhole::attribute_pack& attributes, bool& suppressed) const -> filter_result_t
+{
+    suppressed = false;
+    filter_result_t result;
+    std::shared_ptr<metafilter_t> selector;
+    if(!current.selective()) {
+        selector = std::atomic_load(&fallback);
+    }
+    if(!selector) {
+        result = current.apply(severity, attributes);
+    } else {
+        result = std::atomic_load(&selector->program)->apply(severity, attributes);
+    }
+    if(result == filter_result_t::accept && !current.admit()) {
+        suppressed = true;
+        result = filter_result_t::reject;
+    }
+    return result;
+}
+
+auto metafilter_t::suppress(uint64_t value) -> void {
+    suppressed_pending.add(value);
+}
+
+auto metafilter_t::suppressed() -> uint64_t {
+    flush();
+    return suppressed_since_report.exchange(0);
+}
+
+auto metafilter_t::flush() -> void {
+    accepted.flush();
+    rejected.flush();
+    auto value = suppressed_pending.take();
+    if(value) {
+        suppressed_count->fetch_add(value);
+        suppressed_since_report.fetch_add(value);
+    }
 }
 
 filter_result_t metafilter_t::apply(blackhole::severity_t severity,
                                     blackhole::attribute_pack& attributes) {
-    std::vector<filter_t::id_t> ids_to_remove;
-    auto now = static_cast<uint64_t>(std::time(nullptr));
+    auto current = std::atomic_load(&program);
     filter_result_t result = filter_result_t::reject;
-    boost::shared_lock<boost::shared_mutex> guard(mutex);
 
-    bool need_cleanup = false;
-    for (const auto& filter_info : filters) {
-        if (now > filter_info.deadline) {
-            need_cleanup = true;
-        } else if (result == filter_result_t::reject &&
-                   filter_info.filter.apply(severity, attributes) ==
-                       filter_result_t::accept) {
-            result = filter_result_t::accept;
-        }
+    bool refused = false;
+    if(!current->empty()) {
+        result = evaluate(*current, severity, attributes, refused);
     }
-    guard.unlock();
-    if(need_cleanup) {
-        cleanup();
+    if(refused) {
+        suppress(1);
     }
     if(result == filter_result_t::reject) {
         rejected.increment();
@@ -124,6 +204,42 @@ filter_result_t metafilter_t::apply(blackhole::severity_t severity,
     return result;
 }
 
+metafilter_t::batch_t::batch_t(metafilter_t& _parent) :
+    parent(_parent),
+    program(std::atomic_load(&parent.program)),
+    accepted(0),
+    rejected(0),
+    suppressed(0)
+{}
+
+metafilter_t::batch_t::~batch_t() {
+    if(accepted) {
+        parent.accepted.increment(accepted);
+    }
+    if(rejected) {
+        parent.rejected.increment(rejected);
+    }
+    if(suppressed) {
+        parent.suppress(suppressed);
+    }
+}
+
+filter_result_t metafilter_t::batch_t::apply(blackhole::severity_t severity,
+                                             const blackhole::attribute_pack& attributes) {
+    auto result = filter_result_t::reject;
+    if(!program->empty()) {
+        bool refused = false;
+        result = parent.evaluate(*program, severity, attributes, refused);
+        suppressed += refused;
+    }
+    if(result == filter_result_t::reject) {
+        rejected++;
+    } else {
+        accepted++;
+    }
+    return result;
+}
+
 void metafilter_t::each(const callable_t& fn) const {
     boost::shared_lock<boost::shared_mutex> guard(mutex);
     for (const auto& filter_info : filters) {
@@ -131,16 +247,28 @@ void metafilter_t::each(const callable_t& fn) const {
     }
 }
 
-void metafilter_t::cleanup() {
-    auto now = static_cast<uint64_t>(std::time(nullptr));
+auto metafilter_t::expire(uint64_t now) -> void {
     std::lock_guard<boost::shared_mutex> guard(mutex);
-    for (auto it = filters.begin(); it != filters.end(); ) {
-        if (now > it->deadline) {
-            it = remove_filter(it);
-        } else {
-            it++;
-        }
+    bool changed = false;
+    while(!deadlines.empty() && now > deadlines.begin()->first) {
+        auto id = deadlines.begin()->second;
+        auto it = std::find_if(filters.begin(), filters.end(), [=](const filter_info_t& info) {
+            return info.id == id;
+        });
+        remove_filter(it);
+        changed = true;
+    }
+    if(changed) {
+        publish();
+    }
+}
+
+auto metafilter_t::deadline() const -> filter_t::deadline_t {
+    boost::shared_lock<boost::shared_mutex> guard(mutex);
+    if(deadlines.empty()) {
+        return std::numeric_limits<filter_t::deadline_t>::max();
     }
+    return deadlines.begin()->first;
 }
 
 }
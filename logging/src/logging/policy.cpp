@@ -0,0 +1,118 @@
+/*
+    Copyright (c) 2016 Anton Matveenko <antmat@yandex-team.ru>
+    Copyright (c) 2016 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "cocaine/logging/policy.hpp"
+
+#include <cocaine/errors.hpp>
+
+#include <boost/lexical_cast.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+
+namespace cocaine {
+namespace logging {
+
+namespace {
+
+auto now_ns() -> int64_t {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()
+    ).count();
+}
+
+auto as_number(const dynamic_t& value, double& result) -> bool {
+    if(value.is_uint()) {
+        result = static_cast<double>(value.as_uint());
+    } else if(value.is_int()) {
+        result = static_cast<double>(value.as_int());
+    } else if(value.is_double()) {
+        result = value.as_double();
+    } else {
+        return false;
+    }
+    return true;
+}
+
+}
+
+auto policy_t::is_policy(const filter_t::representation_t& representation) -> bool {
+    if(!representation.is_array() || representation.as_array().empty()) {
+        return false;
+    }
+    const auto& op = representation.as_array()[0];
+    return op.is_string() && (op.as_string() == "rate" || op.as_string() == "sample");
+}
+
+policy_t::policy_t(const filter_t::representation_t& representation) :
+    type(type_t::sample),
+    arrival(0),
+    interval(0),
+    tolerance(0),
+    ratio(1)
+{
+    const auto throw_error = [&] {
+        throw error_t("invalid policy representation - {}", boost::lexical_cast<std::string>(representation));
+    };
+    if(!is_policy(representation)) {
+        throw_error();
+    }
+    const auto& array = representation.as_array();
+    const auto& op = array[0].as_string();
+    if(op == "rate" && array.size() == 3) {
+        double rate;
+        double burst;
+        if(!as_number(array[1], rate) || !as_number(array[2], burst) || rate <= 0 || burst < 1) {
+            throw_error();
+        }
+        type = type_t::rate;
+        interval = static_cast<int64_t>(1e9 / rate);
+        tolerance = static_cast<int64_t>(interval * (burst - 1));
+    } else if(op == "sample" && array.size() == 2) {
+        if(!as_number(array[1], ratio) || ratio < 0 || ratio > 1) {
+            throw_error();
+        }
+    } else {
+        throw_error();
+    }
+}
+
+auto policy_t::admit() -> bool {
+    if(type == type_t::sample) {
+        static thread_local std::minstd_rand generator(std::random_device{}());
+        return std::uniform_real_distribution<double>(0, 1)(generator) < ratio;
+    }
+
+    auto now = now_ns();
+    auto current = arrival.load(std::memory_order_relaxed);
+    while(true) {
+        auto next = std::max(current, now);
+        if(next - now > tolerance) {
+            return false;
+        }
+        if(arrival.compare_exchange_weak(current, next + interval, std::memory_order_relaxed)) {
+            return true;
+        }
+    }
+}
+
+}
+}  // namespace cocaine::logging
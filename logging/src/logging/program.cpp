@@ -0,0 +1,320 @@
+/*
+    Copyright (c) 2016 Anton Matveenko <antmat@yandex-team.ru>
+    Copyright (c) 2016 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "cocaine/logging/program.hpp"
+
+#include "convert.hpp"
+
+#include <cocaine/errors.hpp>
+#include <cocaine/trace/trace.hpp>
+
+#include <boost/lexical_cast.hpp>
+
+#include <array>
+#include <limits>
+#include <map>
+
+namespace cocaine {
+namespace logging {
+
+namespace {
+
+const blackhole::severity_t unbounded = std::numeric_limits<blackhole::severity_t>::min();
+
+}
+
+/// Lazily resolves interned attribute names in a single record, caching the result.
+class program_t::lookup_t {
+public:
+    lookup_t(const std::vector<std::string>& _names, const blackhole::attribute_pack& _attributes) :
+        names(_names),
+        attributes(_attributes),
+        resolved(0)
+    {}
+
+    auto find(uint32_t name) -> const blackhole::attribute::view_t* {
+        if(name >= capacity) {
+            return scan(name);
+        }
+        auto mask = uint64_t(1) << name;
+        if(!(resolved & mask)) {
+            slots[name] = scan(name);
+            resolved |= mask;
+        }
+        return slots[name];
+    }
+
+private:
+    auto scan(uint32_t name) const -> const blackhole::attribute::view_t* {
+        auto attribute = find_attribute(attributes, names[name]);
+        return attribute ? &attribute->second : nullptr;
+    }
+
+    // Names beyond the capacity are rare and are looked up on every access.
+    static constexpr uint32_t capacity = 64;
+
+    const std::vector<std::string>& names;
+    const blackhole::attribute_pack& attributes;
+
+    uint64_t resolved;
+    std::array<const blackhole::attribute::view_t*, capacity> slots;
+};
+
+class program_t::compiler_t {
+public:
+    explicit
+    compiler_t(program_t& _program) :
+        program(_program)
+    {}
+
+    /// Returns root instruction of the filter and sets the lowest severity it may accept.
+    auto compile(const dynamic_t& representation, blackhole::severity_t& bound) -> uint32_t {
+        const auto throw_error = [&] {
+            throw error_t("invalid filter representation - {}", boost::lexical_cast<std::string>(representation));
+        };
+        if(!representation.is_array() || representation.as_array().empty() || !representation.as_array()[0].is_string()) {
+            throw_error();
+        }
+        const auto& array = representation.as_array();
+        const auto& op = array[0].as_string();
+
+        instruction_t instruction = instruction_t();
+        bound = unbounded;
+
+        if(array.size() == 1 && op == "empty") {
+            instruction.opcode = opcode_t::accept;
+        } else if(array.size() == 1 && op == "traced") {
+            instruction.opcode = opcode_t::traced;
+        } else if(array.size() == 2 && op == "severity") {
+            instruction.opcode = opcode_t::severity;
+            instruction.severity = static_cast<blackhole::severity_t>(array[1].as_uint());
+            bound = instruction.severity;
+        } else if(array.size() == 2 && (op == "e" || op == "!e")) {
+            instruction.opcode = op == "e" ? opcode_t::exists : opcode_t::not_exists;
+            instruction.lhs = intern(array[1].as_string());
+        } else if(array.size() == 3 && (op == "||" || op == "&&" || op == "xor")) {
+            blackhole::severity_t lhs_bound;
+            blackhole::severity_t rhs_bound;
+            instruction.lhs = compile(array[1], lhs_bound);
+            instruction.rhs = compile(array[2], rhs_bound);
+            if(op == "||") {
+                instruction.opcode = opcode_t::disjunction;
+                bound = std::min(lhs_bound, rhs_bound);
+            } else if(op == "&&") {
+                instruction.opcode = opcode_t::conjunction;
+                bound = std::max(lhs_bound, rhs_bound);
+            } else {
+                instruction.opcode = opcode_t::exclusive;
+            }
+        } else if(array.size() == 3 && array[1].is_string()) {
+            static const std::map<std::string, opcode_t> comparisons {
+                {"==", opcode_t::equals},
+                {"!=", opcode_t::not_equals},
+                {">",  opcode_t::greater},
+                {"<",  opcode_t::less},
+                {">=", opcode_t::greater_or_equal},
+                {"<=", opcode_t::less_or_equal}
+            };
+            auto it = comparisons.find(op);
+            if(it == comparisons.end()) {
+                throw_error();
+            }
+            instruction.opcode = it->second;
+            instruction.lhs = intern(array[1].as_string());
+            set_operand(instruction, array[2]);
+        } else {
+            throw_error();
+        }
+
+        program.code.push_back(instruction);
+        return static_cast<uint32_t>(program.code.size() - 1);
+    }
+
+private:
+    auto intern(const std::string& name) -> uint32_t {
+        auto it = interned.find(name);
+        if(it != interned.end()) {
+            return it->second;
+        }
+        program.names.push_back(name);
+        auto id = static_cast<uint32_t>(program.names.size() - 1);
+        interned[name] = id;
+        return id;
+    }
+
+    // Keeps the operand type the filter was constructed with, as conversion of the attribute depends on it.
+    auto set_operand(instruction_t& instruction, const dynamic_t& operand) -> void {
+        if(operand.is_bool()) {
+            instruction.type = type_t::boolean;
+            instruction.boolean = operand.as_bool();
+        } else if(operand.is_uint()) {
+            instruction.type = type_t::uint;
+            instruction.uint = operand.as_uint();
+        } else if(operand.is_int()) {
+            instruction.type = type_t::sint;
+            instruction.sint = operand.as_int();
+        } else if(operand.is_double()) {
+            instruction.type = type_t::real;
+            instruction.real = operand.as_double();
+        } else if(operand.is_string()) {
+            instruction.type = type_t::string;
+            program.constants.push_back(operand.as_string());
+            instruction.string = static_cast<uint32_t>(program.constants.size() - 1);
+        } else {
+            throw error_t("invalid representation - cannot create filter from value");
+        }
+    }
+
+    program_t& program;
+    std::map<std::string, uint32_t> interned;
+};
+
+program_t::program_t() :
+    min_severity(unbounded)
+{}
+
+program_t::program_t(const std::vector<filter_info_t>& filters, const policies_t& policies) :
+    program_t()
+{
+    compiler_t compiler(*this);
+    blackhole::severity_t lowest = std::numeric_limits<blackhole::severity_t>::max();
+    for(const auto& info : filters) {
+        auto policy = policies.find(info.id);
+        if(policy != policies.end()) {
+            throttles.push_back(policy->second);
+            continue;
+        }
+        blackhole::severity_t bound;
+        roots.push_back(compiler.compile(info.filter.representation(), bound));
+        lowest = std::min(lowest, bound);
+    }
+    if(!roots.empty()) {
+        min_severity = lowest;
+    }
+}
+
+auto program_t::apply(blackhole::severity_t severity, const blackhole::attribute_pack& attributes) const
+    -> filter_result_t
+{
+    if(roots.empty() || severity < min_severity) {
+        return filter_result_t::reject;
+    }
+
+    lookup_t lookup(names, attributes);
+    for(auto root : roots) {
+        if(eval(root, severity, lookup)) {
+            return filter_result_t::accept;
+        }
+    }
+    return filter_result_t::reject;
+}
+
+auto program_t::admit() const -> bool {
+    for(const auto& throttle : throttles) {
+        if(!throttle->admit()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+auto program_t::empty() const -> bool {
+    return roots.empty() && throttles.empty();
+}
+
+auto program_t::selective() const -> bool {
+    return !roots.empty();
+}
+
+auto program_t::eval(uint32_t pc, blackhole::severity_t severity, lookup_t& lookup) const -> bool {
+    const auto& instruction = code[pc];
+    switch(instruction.opcode) {
+    case opcode_t::accept:
+        return true;
+    case opcode_t::severity:
+        return severity >= instruction.severity;
+    case opcode_t::traced:
+        return trace_t::current().verbose();
+    case opcode_t::exists:
+        return lookup.find(instruction.lhs) != nullptr;
+    case opcode_t::not_exists:
+        return lookup.find(instruction.lhs) == nullptr;
+    case opcode_t::not_equals: {
+        auto value = lookup.find(instruction.lhs);
+        return !value || !compare(instruction, *value);
+    }
+    case opcode_t::equals:
+    case opcode_t::greater:
+    case opcode_t::less:
+    case opcode_t::greater_or_equal:
+    case opcode_t::less_or_equal: {
+        auto value = lookup.find(instruction.lhs);
+        return value && compare(instruction, *value);
+    }
+    case opcode_t::disjunction:
+        return eval(instruction.lhs, severity, lookup) || eval(instruction.rhs, severity, lookup);
+    case opcode_t::conjunction:
+        return eval(instruction.lhs, severity, lookup) && eval(instruction.rhs, severity, lookup);
+    case opcode_t::exclusive:
+        return eval(instruction.lhs, severity, lookup) != eval(instruction.rhs, severity, lookup);
+    }
+    return false;
+}
+
+template<class T>
+auto program_t::compare(opcode_t opcode, const blackhole::attribute::view_t& value, const T& reference) -> bool {
+    typedef typename view_of<T>::type view_t;
+    view_t result;
+    if(!convert<view_t>(value, result)) {
+        return false;
+    }
+    switch(opcode) {
+    case opcode_t::greater:
+        return result > reference;
+    case opcode_t::less:
+        return result < reference;
+    case opcode_t::greater_or_equal:
+        return result >= reference;
+    case opcode_t::less_or_equal:
+        return result <= reference;
+    default:
+        // Inequality is evaluated as negated equality, as a missing attribute satisfies it too.
+        return result == reference;
+    }
+}
+
+auto program_t::compare(const instruction_t& instruction, const blackhole::attribute::view_t& value) const -> bool {
+    switch(instruction.type) {
+    case type_t::boolean:
+        return compare(instruction.opcode, value, instruction.boolean);
+    case type_t::sint:
+        return compare(instruction.opcode, value, instruction.sint);
+    case type_t::uint:
+        return compare(instruction.opcode, value, instruction.uint);
+    case type_t::real:
+        return compare(instruction.opcode, value, instruction.real);
+    case type_t::string:
+        return compare(instruction.opcode, value, constants[instruction.string]);
+    }
+    return false;
+}
+
+}
+}  // namespace cocaine::logging
@@ -0,0 +1,183 @@
+/*
+    Copyright (c) 2016 Anton Matveenko <antmat@yandex-team.ru>
+    Copyright (c) 2016 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "cocaine/logging/writer.hpp"
+
+#include <cocaine/context.hpp>
+#include <cocaine/dynamic.hpp>
+#include <cocaine/errors.hpp>
+#include <cocaine/format.hpp>
+
+#include <blackhole/attribute.hpp>
+#include <blackhole/logger.hpp>
+
+#include <metrics/registry.hpp>
+
+namespace cocaine {
+namespace logging {
+
+namespace {
+
+auto queue_args(const dynamic_t& args) -> const dynamic_t::object_t& {
+    static const dynamic_t::object_t empty;
+    auto it = args.as_object().find("queue");
+    return it == args.as_object().end() ? empty : it->second.as_object();
+}
+
+auto make_overflow(const std::string& name) -> writer_t::overflow_t {
+    if(name == "block") {
+        return writer_t::overflow_t::block;
+    } else if(name == "drop_oldest") {
+        return writer_t::overflow_t::drop_oldest;
+    } else if(name == "drop_by_severity") {
+        return writer_t::overflow_t::drop_by_severity;
+    }
+    throw error_t("unknown logging queue overflow policy - {}", name);
+}
+
+}
+
+writer_t::writer_t(context_t& _context, logger_t& _log, const dynamic_t& args) :
+    context(_context),
+    log(_log),
+    capacity(queue_args(args).empty() ? 0 : queue_args(args).at("capacity", 65536u).as_uint()),
+    overflow(make_overflow(queue_args(args).at("overflow", "block").as_string())),
+    drop_severity(static_cast<blackhole::severity_t>(queue_args(args).at("drop_severity", 1u).as_uint())),
+    ring(capacity),
+    head(0),
+    size(0),
+    stopped(false)
+{
+    if(capacity) {
+        thread = std::thread(&writer_t::run, this);
+    }
+}
+
+writer_t::~writer_t() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopped = true;
+    }
+    not_empty.notify_all();
+    not_full.notify_all();
+    if(thread.joinable()) {
+        thread.join();
+    }
+}
+
+auto writer_t::write(blackhole::severity_t severity,
+                     const std::string& message,
+                     const std::string& backend,
+                     const attributes_t& attributes,
+                     blackhole::attribute_pack& pack) -> void
+{
+    if(!capacity) {
+        log.log(severity, message, pack);
+        return;
+    }
+
+    std::string dropped;
+    std::unique_lock<std::mutex> lock(mutex);
+    if(size == capacity) {
+        if(overflow == overflow_t::drop_oldest) {
+            dropped = std::move(ring[head].backend);
+            head = (head + 1) % capacity;
+            size--;
+        } else if(overflow == overflow_t::drop_by_severity && severity < drop_severity) {
+            lock.unlock();
+            drop(backend);
+            return;
+        } else {
+            // Blocking policy, records not less than drop severity are handled the same way.
+            not_full.wait(lock, [&] {
+                return size < capacity || stopped;
+            });
+            if(stopped) {
+                return;
+            }
+        }
+    }
+
+    // Slots are reused, so strings and attributes keep their capacity between records.
+    auto& record = ring[(head + size) % capacity];
+    record.severity = severity;
+    record.message = message;
+    record.backend = backend;
+    record.attributes = attributes;
+    record.trace = trace_t::current();
+    size++;
+    lock.unlock();
+
+    not_empty.notify_one();
+    if(!dropped.empty()) {
+        drop(dropped);
+    }
+}
+
+auto writer_t::run() -> void {
+    std::vector<record_t> batch;
+    blackhole::attribute_list attribute_list;
+    blackhole::attribute_pack attribute_pack({attribute_list});
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while(true) {
+        not_empty.wait(lock, [&] {
+            return size > 0 || stopped;
+        });
+        if(size == 0) {
+            return;
+        }
+
+        // Take everything queued at once, so that producers are not blocked while the backend writes.
+        auto count = size;
+        if(batch.size() < count) {
+            batch.resize(count);
+        }
+        for(size_t i = 0; i < count; i++) {
+            std::swap(batch[i], ring[(head + i) % capacity]);
+        }
+        head = (head + count) % capacity;
+        size = 0;
+        lock.unlock();
+        not_full.notify_all();
+
+        for(size_t i = 0; i < count; i++) {
+            const auto& record = batch[i];
+            attribute_list.clear();
+            attribute_list.insert(attribute_list.end(), record.attributes.begin(), record.attributes.end());
+            attribute_list.emplace_back("source", record.backend);
+
+            trace_t::restore_scope_t scope(record.trace);
+            try {
+                log.log(record.severity, record.message, attribute_pack);
+            } catch(const std::exception&) {
+                // There is nowhere to report failure of the logger itself, the record is lost.
+            }
+        }
+        lock.lock();
+    }
+}
+
+auto writer_t::drop(const std::string& backend) -> void {
+    context.metrics_hub().counter<std::uint64_t>(format("logging.{}.dropped", backend))->fetch_add(1);
+}
+
+}
+}  // namespace cocaine::logging
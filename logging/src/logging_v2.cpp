@@ -20,6 +20,7 @@
 
 #include "cocaine/logging/metafilter.hpp"
 #include "cocaine/logging/filter.hpp"
+#include "cocaine/logging/writer.hpp"
 
 #include "cocaine/traits/attributes.hpp"
 #include "cocaine/traits/dynamic.hpp"
@@ -48,11 +49,14 @@
 #include <cocaine/rpc/slot.hpp>
 #include <cocaine/repository/unicorn.hpp>
 #include <cocaine/trace/logger.hpp>
+#include <cocaine/traits/tuple.hpp>
 #include <cocaine/traits/vector.hpp>
 #include <cocaine/unicorn/value.hpp>
 
 #include "../foreign/radix_tree/radix_tree.hpp"
 
+#include <chrono>
+#include <limits>
 #include <random>
 
 namespace ph = std::placeholders;
@@ -78,7 +82,7 @@ auto get_root_logger(context_t& context, const dynamic_t& service_args) -> bh::r
     return registry->builder<blackhole::config::json_t>(stream).build(backend);
 }
 
-auto emit_ack(std::shared_ptr<metafilter_t> filter, const std::string& backend, logger_t& log, unsigned int severity,
+auto emit_ack(std::shared_ptr<metafilter_t> filter, const std::string& backend, writer_t& writer, unsigned int severity,
               const std::string& message, const attributes_t& attributes) -> bool
 {
     blackhole::attribute_list attribute_list;
@@ -91,14 +95,36 @@ auto emit_ack(std::shared_ptr<metafilter_t> filter, const std::string& backend,
     if (filter->apply(severity, attribute_pack) == logging::filter_result_t::reject) {
         return false;
     }
-    log.log(blackhole::severity_t(severity), message, attribute_pack);
+    writer.write(blackhole::severity_t(severity), message, backend, attributes, attribute_pack);
     return true;
 }
 
-auto emit(std::shared_ptr<metafilter_t> filter, const std::string& backend, logging::logger_t& log,
+auto emit(std::shared_ptr<metafilter_t> filter, const std::string& backend, writer_t& writer,
           unsigned int severity, const std::string& message, const logging::attributes_t& attributes) -> void
 {
-    emit_ack(filter, backend, log, severity, message, attributes);
+    emit_ack(filter, backend, writer, severity, message, attributes);
+}
+
+auto emit_batch(metafilter_t& filter, const std::string& backend, writer_t& writer,
+                const std::vector<std::tuple<unsigned int, std::string, logging::attributes_t>>& records) -> void
+{
+    metafilter_t::batch_t batch(filter);
+
+    // Storage for attribute views is shared by all records of the batch.
+    blackhole::attribute_list attribute_list;
+    blackhole::attribute_pack attribute_pack({attribute_list});
+    for (const auto& record : records) {
+        const auto& attributes = std::get<2>(record);
+        attribute_list.clear();
+        attribute_list.reserve(attributes.size() + 1);
+        attribute_list.insert(attribute_list.end(), attributes.begin(), attributes.end());
+        attribute_list.emplace_back("source", backend);
+
+        auto severity = std::get<0>(record);
+        if (batch.apply(severity, attribute_pack) == logging::filter_result_t::accept) {
+            writer.write(blackhole::severity_t(severity), std::get<1>(record), backend, attributes, attribute_pack);
+        }
+    }
 }
 
 auto now() -> uint64_t {
@@ -117,22 +143,31 @@ struct logging_v2_t::impl_t : public std::enable_shared_from_this<logging_v2_t::
 
     using filter_list_tuple_t = std::tuple<std::string, representation_t, id_t, uint64_t, disposition_t>;
     using filter_list_storage_t = std::vector<filter_list_tuple_t>;
+    using metafilters_t = radix_tree<std::string, std::shared_ptr<logging::metafilter_t>>;
 
     static constexpr size_t retry_time_seconds = 5;
+    // Expiry timer never waits longer, far deadlines are approached in several steps.
+    static constexpr uint64_t max_expiry_wait_seconds = 3600;
     static const std::string default_key;
     static const std::string core_key;
 
-    impl_t(context_t& _context, asio::io_service& io_context, const dynamic_t& config) :
+    impl_t(context_t& _context, asio::io_service& _io_context, const dynamic_t& config) :
         context(_context),
         internal_logger(context.log("logging_v2")),
         root_logger(new bh::root_logger_t(get_root_logger(context, config))),
         logger(std::unique_ptr<logging::logger_t>(new bh::wrapper_t(*root_logger, {}))),
+        writer(context, logger, config),
         signal_dispatcher(std::make_shared<dispatch<io::context_tag>>("logging_signals")),
         generator(std::random_device()()),
         unicorn(api::unicorn(context, "core")),
         filter_unicorn_path(config.as_object().at("unicorn_path", "/cocaine/logging_v2/filters").as_string()),
+        suppression_report_interval(config.as_object().at("suppression_report_interval", 10u).as_uint()),
+        next_suppression_report(std::chrono::steady_clock::now() + suppression_report_interval),
+        io_context(_io_context),
         retry_timer(io_context),
-        cleanup_timer(io_context)
+        cleanup_timer(io_context),
+        expiry_timer(io_context),
+        expiry_deadline(std::numeric_limits<deadline_t>::max())
     {
         auto default_mf = get_default_metafilter();
         auto default_metafilter_conf = config.as_object().at("default_metafilter").as_array();
@@ -209,23 +244,135 @@ struct logging_v2_t::impl_t : public std::enable_shared_from_this<logging_v2_t::
                 // so we use simple but slow implementation of empty metafilters cleanup
                 std::vector<std::string> empty;
                 for(auto& mf_pair: metafilters) {
-                    mf_pair.second->cleanup();
+                    mf_pair.second->flush();
                     // NOTE: core metafilter is stored by shared_ptr in filtering lambda and it is a special case
                     // We can introduce something like 'need_cleanup' or 'useless' method to metafilter,
-                    // but for now it looks like an overkill, so we just check in cleanup if the name is 'core'
+                    // but for now it looks like an overkill, so we just check in cleanup if the name is 'core'.
                     if(mf_pair.second->empty() && mf_pair.first != core_key){
                         empty.push_back(mf_pair.first);
                     }
                 }
+                // The default one is kept while any metafilter having policies only selects records with it.
+                auto fallback_needed = update_fallbacks(metafilters);
                 for(auto& empty_item: empty) {
-                    metafilters.erase(empty_item);
+                    if(empty_item != default_key || !fallback_needed) {
+                        metafilters.erase(empty_item);
+                    }
                 }
             });
+            if(std::chrono::steady_clock::now() >= next_suppression_report) {
+                report_suppressed();
+                next_suppression_report = std::chrono::steady_clock::now() + suppression_report_interval;
+            }
             cleanup_timer.expires_from_now(boost::posix_time::seconds(1));
             cleanup_timer.async_wait([&](const std::error_code& ec){ cleanup(ec);});
         }
     }
 
+    /// Arms expiry timer for the deadline, unless it is already armed for an earlier one. Thread safe.
+    auto schedule_expiry(deadline_t deadline) -> void {
+        io_context.post(safe([=] {
+            arm_expiry(deadline);
+        }));
+    }
+
+    // Must be called from the service thread only, as well as expire.
+    auto arm_expiry(deadline_t deadline) -> void {
+        if(deadline >= expiry_deadline) {
+            return;
+        }
+        expiry_deadline = deadline;
+
+        // Filter expires once its deadline second has passed.
+        auto current = now();
+        auto wait = deadline < current ? 0 : deadline - current + 1;
+        if(wait > max_expiry_wait_seconds) {
+            wait = max_expiry_wait_seconds;
+        }
+        expiry_timer.expires_from_now(boost::posix_time::seconds(static_cast<long>(wait)));
+        expiry_timer.async_wait(safe([=](const std::error_code& ec) {
+            if(!ec) {
+                expire();
+            }
+        }));
+    }
+
+    /// Removes expired filters, so that records are never checked against deadlines, and rearms the timer.
+    auto expire() -> void {
+        expiry_deadline = std::numeric_limits<deadline_t>::max();
+        auto current = now();
+        auto next = std::numeric_limits<deadline_t>::max();
+        metafilters.apply([&](metafilters_t& mfs) {
+            for(auto& mf_pair: mfs) {
+                mf_pair.second->expire(current);
+                next = std::min(next, mf_pair.second->deadline());
+            }
+            update_fallbacks(mfs);
+        });
+        if(next != std::numeric_limits<deadline_t>::max()) {
+            arm_expiry(next);
+        }
+    }
+
+    auto add_local_filter(logging::filter_info_t info) -> void {
+        auto deadline = info.deadline;
+        metafilters.apply([&](metafilters_t& mfs) {
+            auto metafilter = get_metafilter(mfs, info.logger_name);
+            metafilter->add_filter(std::move(info));
+            update_fallbacks(mfs);
+        });
+        schedule_expiry(deadline);
+    }
+
+    /// Gives the default metafilter to metafilters having policies only, so that they select records with it,
+    /// and takes it from the others. Returns whether any metafilter falls back to the default one.
+    /// Must be called under the metafilters lock.
+    auto update_fallbacks(metafilters_t& mfs) -> bool {
+        bool needed = false;
+        std::vector<std::shared_ptr<logging::metafilter_t>> orphans;
+        for(auto& mf_pair: mfs) {
+            if(mf_pair.first == default_key) {
+                continue;
+            }
+            if(mf_pair.second->policies_only()) {
+                needed = true;
+                if(!mf_pair.second->has_fallback()) {
+                    orphans.push_back(mf_pair.second);
+                }
+            } else {
+                mf_pair.second->set_fallback(nullptr);
+            }
+        }
+        if(!orphans.empty()) {
+            auto fallback = get_metafilter(mfs, default_key);
+            for(auto& orphan: orphans) {
+                orphan->set_fallback(fallback);
+            }
+        }
+        return needed;
+    }
+
+    /// Writes a summary record on behalf of each metafilter, which policies suppressed anything since the last one.
+    auto report_suppressed() -> void {
+        std::vector<std::pair<std::string, uint64_t>> reports;
+        metafilters.apply([&](metafilters_t& mfs) {
+            for(auto& mf_pair: mfs) {
+                auto count = mf_pair.second->suppressed();
+                if(count > 0) {
+                    reports.emplace_back(mf_pair.first, count);
+                }
+            }
+        });
+        for(const auto& report : reports) {
+            auto message = format("{} records suppressed by rate limiting and sampling policies", report.second);
+            logging::attributes_t attributes{{"suppressed", report.second}};
+            blackhole::attribute_list attribute_list(attributes.begin(), attributes.end());
+            attribute_list.emplace_back("source", report.first);
+            blackhole::attribute_pack attribute_pack({attribute_list});
+            writer.write(logging::warning, message, report.first, attributes, attribute_pack);
+        }
+    }
+
     auto load_filters() -> void {
 
         // callback to handle subscription on node with filter data
@@ -251,10 +398,9 @@ struct logging_v2_t::impl_t : public std::enable_shared_from_this<logging_v2_t::
                             COCAINE_LOG_INFO(internal_logger, "deadlined filter found - removing filter from unicorn");
                             remove_from_unicorn(filter_path(filter_id));
                         } else {
-                            auto metafilter = get_metafilter(info.logger_name);
                             auto mf_name = info.logger_name;
-                            metafilter->add_filter(std::move(info));
-                            COCAINE_LOG_INFO(internal_logger, "added filter {} to metafilter {} ", filter_id, info.logger_name);
+                            add_local_filter(std::move(info));
+                            COCAINE_LOG_INFO(internal_logger, "added filter {} to metafilter {} ", filter_id, mf_name);
                         }
                     } catch (const std::exception& e) {
                         COCAINE_LOG_ERROR(internal_logger, "can not parse filter value, erasing filter {} from unicorn - {}",
@@ -373,8 +519,7 @@ struct logging_v2_t::impl_t : public std::enable_shared_from_this<logging_v2_t::
         logging::filter_info_t info(std::move(filter), std::move(deadline), id, disposition, std::move(name));
 
         if (disposition == logging::filter_t::disposition_t::local) {
-            auto metafilter = get_metafilter(info.logger_name);
-            metafilter->add_filter(std::move(info));
+            add_local_filter(std::move(info));
             deferred.write(id);
         } else if (disposition == logging::filter_t::disposition_t::cluster) {
             unsigned long scope_id = scope_counter++;
@@ -427,6 +572,7 @@ struct logging_v2_t::impl_t : public std::enable_shared_from_this<logging_v2_t::
         return metafilters.apply([=](metafilters_t& mfs) mutable {
             for(auto& metafilter_pair : mfs) {
                 if(metafilter_pair.second->remove_filter(id)) {
+                    update_fallbacks(mfs);
                     return true;
                 }
             }
@@ -474,35 +620,49 @@ struct logging_v2_t::impl_t : public std::enable_shared_from_this<logging_v2_t::
 
     auto get_metafilter(const std::string& name) -> std::shared_ptr<logging::metafilter_t> {
         return metafilters.apply([&](metafilters_t& _metafilters) {
-            auto& metafilter = _metafilters[name];
-            if (metafilter == nullptr) {
-                std::unique_ptr<logging::logger_t> mf_logger(new blackhole::wrapper_t(
-                *(internal_logger), {{"metafilter", name}}));
-                metafilter = std::make_shared<logging::metafilter_t>(context, name, std::move(mf_logger));
-            }
-            return metafilter;
+            return get_metafilter(_metafilters, name);
         });
     }
 
+    // Must be called under the metafilters lock.
+    auto get_metafilter(metafilters_t& _metafilters, const std::string& name) -> std::shared_ptr<logging::metafilter_t> {
+        auto& metafilter = _metafilters[name];
+        if (metafilter == nullptr) {
+            std::unique_ptr<logging::logger_t> mf_logger(new blackhole::wrapper_t(
+            *(internal_logger), {{"metafilter", name}}));
+            metafilter = std::make_shared<logging::metafilter_t>(context, name, std::move(mf_logger));
+        }
+        return metafilter;
+    }
+
     context_t& context;
     std::unique_ptr<logging::logger_t> internal_logger;
     std::unique_ptr<bh::root_logger_t> root_logger;
     logging::trace_wrapper_t logger;
+    // Filtered records go through writer, which optionally decouples RPC threads from a slow backend.
+    logging::writer_t writer;
     std::shared_ptr<dispatch<io::context_tag>> signal_dispatcher;
 
-    using metafilters_t = radix_tree<std::string, std::shared_ptr<logging::metafilter_t>>;
     synchronized<metafilters_t> metafilters;
     mutable synchronized<std::mt19937_64> generator;
     api::unicorn_ptr unicorn;
     std::atomic_ulong scope_counter;
     std::string filter_unicorn_path;
 
+    const std::chrono::seconds suppression_report_interval;
+    std::chrono::steady_clock::time_point next_suppression_report;
+
     using unicorn_scopes_t = std::unordered_map<size_t, api::unicorn_scope_ptr>;
     api::unicorn_scope_ptr list_scope;
     api::unicorn_scope_ptr create_scope;
     synchronized<unicorn_scopes_t> scopes;
+    asio::io_service& io_context;
     asio::deadline_timer retry_timer;
     asio::deadline_timer cleanup_timer;
+
+    // Armed for the earliest filter deadline, which is maximum value when the timer is idle.
+    asio::deadline_timer expiry_timer;
+    deadline_t expiry_deadline;
 };
 
 const std::string logging_v2_t::impl_t::default_key("default");
@@ -522,13 +682,13 @@ logging_v2_t::logging_v2_t(context_t& context, asio::io_service& asio, const std
     on<io::base_log::emit>([&](uint severity, const std::string& backend, const std::string& message,
                                const attributes_t& attributes)
     {
-        emit(d->find_metafilter(backend), backend, d->logger, severity, message, attributes);
+        emit(d->find_metafilter(backend), backend, d->writer, severity, message, attributes);
     });
 
     on<io::base_log::emit_ack>([&](uint severity, const std::string& backend, const std::string& message,
                                    const attributes_t& attributes)
     {
-        return emit_ack(d->find_metafilter(backend), backend, d->logger, severity, message, attributes);
+        return emit_ack(d->find_metafilter(backend), backend, d->writer, severity, message, attributes);
     });
 
     using get = io::base_log::get;
@@ -536,7 +696,7 @@ logging_v2_t::logging_v2_t(context_t& context, asio::io_service& asio, const std
     on<get>([&](const hpack::headers_t&, get_slot_t::tuple_type&& args, get_slot_t::upstream_type&&){
         auto mf_name = std::get<0>(args);
         auto metafilter = d->find_metafilter(mf_name);
-        auto dispatch = std::make_shared<named_logging_t>(d->logger, std::move(mf_name), std::move(metafilter));
+        auto dispatch = std::make_shared<named_logging_t>(d->writer, std::move(mf_name), std::move(metafilter));
         return get_slot_t::result_type(std::move(dispatch));
     });
 
@@ -551,11 +711,11 @@ logging_v2_t::logging_v2_t(context_t& context, asio::io_service& asio, const std
     on<io::base_log::list_filters>(std::bind(&impl_t::list_filters, d.get()));
 }
 
-named_logging_t::named_logging_t(logging::logger_t& _log,
+named_logging_t::named_logging_t(logging::writer_t& _writer,
                                  std::string _name,
                                  std::shared_ptr<logging::metafilter_t> _filter) :
         dispatch<io::named_log_tag>(format("named_logging/{}", _name)),
-        log(_log),
+        writer(_writer),
         backend(std::move(_name)),
         filter(std::move(_filter))
 {
@@ -565,7 +725,7 @@ named_logging_t::named_logging_t(logging::logger_t& _log,
         auto severity = std::get<0>(args);
         auto& message = std::get<1>(args);
         auto& attributes = std::get<2>(args);
-        emit(filter, backend, log, severity, message, attributes);
+        emit(filter, backend, writer, severity, message, attributes);
         return emit_slot_t::result_type(boost::none);
     });
 
@@ -576,11 +736,18 @@ named_logging_t::named_logging_t(logging::logger_t& _log,
         auto severity = std::get<0>(args);
         auto& message = std::get<1>(args);
         auto& attributes = std::get<2>(args);
-        auto result = emit_ack(filter, backend, log, severity, message, attributes);
+        auto result = emit_ack(filter, backend, writer, severity, message, attributes);
         using chunk_event = io::protocol<io::stream_of<bool>::tag>::scope::chunk;
         upstream.template send<chunk_event>(result);
         return ack_slot_t::result_type(boost::none);
     });
+
+    using batch_event = io::named_log::emit_batch;
+    using batch_slot_t = io::basic_slot<batch_event>;
+    on<batch_event>([&](const hpack::headers_t&, batch_slot_t::tuple_type&& args, batch_slot_t::upstream_type&&) {
+        emit_batch(*filter, backend, writer, std::get<0>(args));
+        return batch_slot_t::result_type(boost::none);
+    });
 }
 
 }
@@ -22,6 +22,9 @@
 
 #include <cocaine/dynamic.hpp>
 #include <cocaine/idl/primitive.hpp>
+#include <cocaine/rpc/protocol.hpp>
+
+#include "cocaine/service/metrics/tree.hpp"
 
 #include <map>
 #include <string>
@@ -47,8 +50,27 @@ struct metrics {
             optional<dynamic_t>
         >::type argument_type;
 
+        /* Packed as a plain tree, shared with the export it was taken from. */
         typedef option_of<
-            dynamic_t
+            service::metrics::tree_t
+        >::tag upstream_type;
+    };
+
+    /// Metrics in Prometheus text exposition format, rendered without building a tree and sent in chunks.
+    struct expose {
+        typedef metrics_tag tag;
+
+        constexpr static auto alias() noexcept -> const char* {
+            return "expose";
+        }
+
+        typedef boost::mpl::vector<
+         /* Query AST. */
+            optional<dynamic_t>
+        >::type argument_type;
+
+        typedef stream_of<
+            std::string
         >::tag upstream_type;
     };
 
@@ -61,7 +83,8 @@ struct protocol<metrics_tag> {
     >::type version;
 
     typedef boost::mpl::list<
-        metrics::fetch
+        metrics::fetch,
+        metrics::expose
     >::type messages;
 };
 
@@ -24,8 +24,13 @@
 
 #include "cocaine/postgres/pool.hpp"
 
+#include <cocaine/locked_ptr.hpp>
+
 #include <asio/deadline_timer.hpp>
 
+#include <cstdint>
+#include <vector>
+
 namespace cocaine {
 namespace sender {
 
@@ -37,26 +42,52 @@ public:
                 data_provider_ptr data_provider,
                 const dynamic_t& args);
 
+    /// Sends rows accumulated by the batch policy, so that they are not lost on shutdown.
+    ~pg_sender_t();
+
 private:
     enum class policy_t {
         continous,
-        update
+        update,
+        /// Accumulates several ticks and inserts them at once into time partitions of the table.
+        batch
+    };
+
+    struct row_t {
+        double ts;
+        std::string data;
     };
+
     auto on_send_timer(const std::error_code& ec) -> void;
     auto on_gc_timer(const std::error_code& ec) -> void;
     auto send(dynamic_t data) -> void;
+    auto flush() -> void;
+    auto send_batch(std::vector<row_t> rows) -> void;
+    auto gc_rows() -> void;
+    auto gc_partitions() -> void;
 
     policy_t policy;
     data_provider_ptr data_provider;
     std::shared_ptr<api::postgres::pool_t> pool;
     std::string hostname;
     std::string table_name;
-    std::unique_ptr<blackhole::logger_t> logger;
+    std::shared_ptr<blackhole::logger_t> logger;
     boost::posix_time::seconds send_period;
     asio::deadline_timer send_timer;
     asio::deadline_timer gc_timer;
     boost::posix_time::seconds gc_period;
     boost::posix_time::seconds gc_ttl;
+
+    /// Batch policy only, rows are accumulated in the event loop thread.
+    std::size_t batch_size;
+    std::int64_t partition_period;
+    std::vector<row_t> batch;
+
+    /// Rows of failed batches, returned from the pool threads and sent again with the next batch. At most
+    /// max_pending rows are kept, the oldest ones are dropped. Shared with pending inserts, which may
+    /// complete after the sender is destroyed.
+    std::size_t max_pending;
+    std::shared_ptr<synchronized<std::vector<row_t>>> failed;
 };
 
 }
@@ -28,9 +28,17 @@
 #include <cocaine/api/service.hpp>
 #include <cocaine/context.hpp>
 #include <cocaine/idl/metrics.hpp>
+#include <cocaine/locked_ptr.hpp>
 #include <cocaine/rpc/dispatch.hpp>
+#include <cocaine/rpc/slot/streamed.hpp>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
 
 #include "metrics/fwd.hpp"
+#include "metrics/tree.hpp"
 
 namespace cocaine {
 namespace service {
@@ -56,9 +64,15 @@ public:
         return *this;
     }
 
-    /// Returns metrics dump.
+    /// Returns metrics dump, shared with the export kept for the query.
+    auto
+    metrics(const std::string& type, const dynamic_t& query) const -> metrics::tree_t;
+
+    /// Returns metrics dump in Prometheus text exposition format, split into chunks.
+    ///
+    /// The whole text is rendered before the stream is returned, so chunks are queued until it is attached.
     auto
-    metrics(const std::string& type, const dynamic_t& query) const -> dynamic_t;
+    expose(const dynamic_t& query) const -> streamed<std::string>;
 
 private:
     auto
@@ -67,16 +81,13 @@ private:
     auto
     make_filter(const dynamic_t& query) const -> libmetrics::query_t;
 
-    auto
-    construct_plain(const libmetrics::query_t& filter) const -> dynamic_t;
-
-    auto
-    construct_dendroid(const libmetrics::query_t& filter) const -> dynamic_t;
-
 private:
     libmetrics::registry_t& hub;
     std::vector<api::sender_ptr> senders;
     std::shared_ptr<metrics::registry_t> registry;
+
+    /// Exports kept between fetches and sender ticks, keyed by output type and query.
+    mutable synchronized<std::map<std::string, std::shared_ptr<metrics::snapshot_t>>> snapshots;
 };
 
 }  // namespace service
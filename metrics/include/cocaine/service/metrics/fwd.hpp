@@ -9,10 +9,9 @@ namespace metrics {
 
 class filter_t;
 class getter_t;
+class query_builder_t;
 class registry_t;
-
-template<typename T>
-using node = std::function<T(const libmetrics::tagged_t& metric)>;
+class snapshot_t;
 
 } // namespace metrics
 } // namespace service
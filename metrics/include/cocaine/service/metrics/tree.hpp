@@ -0,0 +1,47 @@
+#pragma once
+
+#include <memory>
+
+#include <cocaine/dynamic.hpp>
+#include <cocaine/traits.hpp>
+#include <cocaine/traits/dynamic.hpp>
+
+namespace cocaine {
+namespace service {
+namespace metrics {
+
+/// Metrics tree published by an export and shared with its readers. It is never changed once published,
+/// so it is packed straight from the shared root, exactly as the tree itself.
+struct tree_t {
+    std::shared_ptr<const dynamic_t> root;
+};
+
+} // namespace metrics
+} // namespace service
+
+namespace io {
+
+template<>
+struct type_traits<service::metrics::tree_t> {
+    template<class Stream>
+    static
+    void
+    pack(msgpack::packer<Stream>& packer, const service::metrics::tree_t& source) {
+        if (source.root) {
+            type_traits<dynamic_t>::pack(packer, *source.root);
+        } else {
+            packer.pack_nil();
+        }
+    }
+
+    static
+    void
+    unpack(const msgpack::object& source, service::metrics::tree_t& target) {
+        auto root = std::make_shared<dynamic_t>();
+        type_traits<dynamic_t>::unpack(source, *root);
+        target.root = std::move(root);
+    }
+};
+
+} // namespace io
+} // namespace cocaine
@@ -14,11 +14,32 @@
 
 #include <pqxx/transaction>
 
+#include <boost/lexical_cast.hpp>
+
+#include <cmath>
+#include <iterator>
+#include <map>
+#include <memory>
+
 #include <sys/time.h>
 
 namespace cocaine {
 namespace sender {
 
+namespace {
+
+auto now_seconds() -> double {
+    struct timeval time_point;
+    gettimeofday(&time_point, nullptr);
+    return (time_point.tv_sec * 1000.0 + time_point.tv_usec / 1000.0) / 1000.0;
+}
+
+auto partition_name(const std::string& table_name, std::int64_t start) -> std::string {
+    return cocaine::format("{}_p{}", table_name, start);
+}
+
+}
+
 pg_sender_t::pg_sender_t(context_t& context,
                          asio::io_service& io_loop,
                          const std::string& name,
@@ -36,7 +57,11 @@ pg_sender_t::pg_sender_t(context_t& context,
     send_timer(io_loop),
     gc_timer(io_loop),
     gc_period(args.as_object().at("pg_gc_period_s", 3600u).as_uint()),
-    gc_ttl(args.as_object().at("pg_gc_ttl_s", 3600u).as_uint())
+    gc_ttl(args.as_object().at("pg_gc_ttl_s", 3600u).as_uint()),
+    batch_size(args.as_object().at("pg_batch_size", 60u).as_uint()),
+    partition_period(static_cast<std::int64_t>(args.as_object().at("pg_partition_period_s", 86400u).as_uint())),
+    max_pending(args.as_object().at("pg_max_pending_rows", static_cast<dynamic_t::uint_t>(10 * batch_size)).as_uint()),
+    failed(std::make_shared<synchronized<std::vector<row_t>>>())
 {
     auto _policy = args.as_object().at("policy", "").as_string();
     if(!_policy.empty()) {
@@ -44,6 +69,8 @@ pg_sender_t::pg_sender_t(context_t& context,
             policy = policy_t::continous;
         } else if(_policy == "update") {
             policy = policy_t::update;
+        } else if(_policy == "batch") {
+            policy = policy_t::batch;
         } else {
             throw error_t("invalid postgress sender({}) policy specification - {}", name, _policy);
         }
@@ -51,6 +78,15 @@ pg_sender_t::pg_sender_t(context_t& context,
     if(send_period.ticks() == 0) {
         throw error_t("pg_send_period can not be zero");
     }
+    if(policy == policy_t::batch) {
+        if(batch_size == 0) {
+            throw error_t("pg_batch_size can not be zero");
+        }
+        if(partition_period <= 0) {
+            throw error_t("pg_partition_period_s can not be zero");
+        }
+        batch.reserve(batch_size);
+    }
     send_timer.expires_from_now(send_period);
     send_timer.async_wait(std::bind(&pg_sender_t::on_send_timer, this, std::placeholders::_1));
 
@@ -61,6 +97,12 @@ pg_sender_t::pg_sender_t(context_t& context,
     }
 }
 
+pg_sender_t::~pg_sender_t() {
+    if(policy == policy_t::batch) {
+        flush();
+    }
+}
+
 auto pg_sender_t::on_send_timer(const std::error_code& ec) -> void {
     if(!ec) {
         send(data_provider->fetch());
@@ -74,32 +116,87 @@ auto pg_sender_t::on_send_timer(const std::error_code& ec) -> void {
 auto pg_sender_t::on_gc_timer(const std::error_code& ec) -> void {
     if(!ec) {
         COCAINE_LOG_DEBUG(logger, "running gc for metrics");
-        pool->execute([=](pqxx::connection_base& connection) {
-            try {
-                pqxx::work transaction(connection);
-                auto query = cocaine::format("DELETE FROM {} WHERE ts < now()-interval '{} seconds';",
-                                             transaction.esc(table_name), gc_ttl.total_seconds());
-                COCAINE_LOG_DEBUG(logger, "executing {}", query);
-                auto sql_result = transaction.exec(query);
-                transaction.commit();
-            } catch (const std::exception& e) {
-                COCAINE_LOG_ERROR(logger, "GC query failed - {}", e.what());
-            }
-            gc_timer.expires_from_now(gc_period);
-            gc_timer.async_wait(std::bind(&pg_sender_t::on_gc_timer, this, std::placeholders::_1));
-        });
+        if(policy == policy_t::batch) {
+            gc_partitions();
+        } else {
+            gc_rows();
+        }
     } else {
         COCAINE_LOG_WARNING(logger, "GC timer was cancelled");
     }
 }
 
+auto pg_sender_t::gc_rows() -> void {
+    pool->execute([=](pqxx::connection_base& connection) {
+        try {
+            pqxx::work transaction(connection);
+            auto query = cocaine::format("DELETE FROM {} WHERE ts < now()-interval '{} seconds';",
+                                         transaction.esc(table_name), gc_ttl.total_seconds());
+            COCAINE_LOG_DEBUG(logger, "executing {}", query);
+            auto sql_result = transaction.exec(query);
+            transaction.commit();
+        } catch (const std::exception& e) {
+            COCAINE_LOG_ERROR(logger, "GC query failed - {}", e.what());
+        }
+        gc_timer.expires_from_now(gc_period);
+        gc_timer.async_wait(std::bind(&pg_sender_t::on_gc_timer, this, std::placeholders::_1));
+    });
+}
+
+auto pg_sender_t::gc_partitions() -> void {
+    // Partitions are dropped as a whole once all of their rows are older than ttl, so rows live for
+    // ttl at least and ttl plus partition period at most.
+    const auto horizon = static_cast<std::int64_t>(now_seconds()) - gc_ttl.total_seconds();
+    pool->execute([=](pqxx::connection_base& connection) {
+        try {
+            pqxx::work transaction(connection);
+            auto query = cocaine::format("SELECT c.relname FROM pg_inherits i "
+                                         "JOIN pg_class c ON c.oid = i.inhrelid "
+                                         "JOIN pg_class p ON p.oid = i.inhparent "
+                                         "WHERE p.relname = {};",
+                                         transaction.quote(table_name));
+            COCAINE_LOG_DEBUG(logger, "executing {}", query);
+            auto sql_result = transaction.exec(query);
+
+            const auto prefix = table_name + "_p";
+            for(const auto& row : sql_result) {
+                const auto partition = row[0].as<std::string>();
+                if(partition.compare(0, prefix.size(), prefix) != 0) {
+                    continue;
+                }
+                std::int64_t start;
+                try {
+                    start = boost::lexical_cast<std::int64_t>(partition.substr(prefix.size()));
+                } catch (const boost::bad_lexical_cast&) {
+                    continue;
+                }
+                if(start + partition_period <= horizon) {
+                    query = cocaine::format("DROP TABLE IF EXISTS {};", transaction.esc(partition));
+                    COCAINE_LOG_DEBUG(logger, "executing {}", query);
+                    transaction.exec(query);
+                }
+            }
+            transaction.commit();
+        } catch (const std::exception& e) {
+            COCAINE_LOG_ERROR(logger, "GC query failed - {}", e.what());
+        }
+        gc_timer.expires_from_now(gc_period);
+        gc_timer.async_wait(std::bind(&pg_sender_t::on_gc_timer, this, std::placeholders::_1));
+    });
+}
 
 auto pg_sender_t::send(dynamic_t data) -> void {
+    if(policy == policy_t::batch) {
+        batch.push_back(row_t{now_seconds(), boost::lexical_cast<std::string>(data)});
+        if(batch.size() >= batch_size) {
+            flush();
+        }
+        return;
+    }
+
     pool->execute([=](pqxx::connection_base& connection){
         try {
-            struct timeval time_point;
-            gettimeofday(&time_point, nullptr);
-            const auto now = std::to_string((time_point.tv_sec * 1000.0 + time_point.tv_usec / 1000.0) / 1000.0);
+            const auto now = std::to_string(now_seconds());
 
             auto data_string = boost::lexical_cast<std::string>(data);
             auto transaction = postgres::start_transaction(connection);
@@ -150,5 +247,84 @@ auto pg_sender_t::send(dynamic_t data) -> void {
     });
 }
 
+auto pg_sender_t::flush() -> void {
+    // Rows of failed batches go first, they are older.
+    std::vector<row_t> rows;
+    failed->apply([&](std::vector<row_t>& _failed) {
+        rows.swap(_failed);
+    });
+    rows.insert(rows.end(), std::make_move_iterator(batch.begin()), std::make_move_iterator(batch.end()));
+    batch.clear();
+
+    if(!rows.empty()) {
+        send_batch(std::move(rows));
+    }
+}
+
+auto pg_sender_t::send_batch(std::vector<row_t> _rows) -> void {
+    // The insert may complete after the sender is gone, so it captures copies instead of this.
+    auto rows = std::make_shared<std::vector<row_t>>(std::move(_rows));
+    auto batch_logger = logger;
+    auto retry = failed;
+    auto limit = max_pending;
+    auto table = table_name;
+    auto host_name = hostname;
+    auto period = partition_period;
+    pool->execute([=](pqxx::connection_base& connection){
+        try {
+            // Batch may span a partition boundary, rows are grouped by the partition start.
+            std::map<std::int64_t, std::vector<const row_t*>> partitions;
+            for(const auto& row : *rows) {
+                const auto ts = static_cast<std::int64_t>(std::floor(row.ts));
+                partitions[ts - ts % period].push_back(&row);
+            }
+
+            auto transaction = postgres::start_transaction(connection);
+            for(const auto& partition : partitions) {
+                const auto start = partition.first;
+                const auto name = transaction->esc(partition_name(table, start));
+
+                // Child tables inherit the parent, so queries to the parent table see all partitions.
+                auto query = cocaine::format("CREATE TABLE IF NOT EXISTS {} ("
+                                             "CHECK (ts >= to_timestamp({}) AND ts < to_timestamp({}))"
+                                             ") INHERITS ({});",
+                                             name, start, start + period, transaction->esc(table));
+                COCAINE_LOG_DEBUG(batch_logger, "executing {}", query);
+                transaction->exec(query);
+
+                query = cocaine::format("INSERT INTO {} (ts, host, data) VALUES", name);
+                const auto host = transaction->quote(host_name);
+                bool first = true;
+                for(const auto row : partition.second) {
+                    query += cocaine::format("{}(to_timestamp({}), {}, {})",
+                                             first ? " " : ", ",
+                                             std::to_string(row->ts),
+                                             host,
+                                             transaction->quote(row->data));
+                    first = false;
+                }
+                query += ";";
+                COCAINE_LOG_DEBUG(batch_logger, "executing insert of {} rows into {}", partition.second.size(), name);
+                transaction->exec(query);
+            }
+            transaction->commit();
+        } catch (const std::exception& e) {
+            std::size_t kept = 0;
+            std::size_t dropped = 0;
+            retry->apply([&](std::vector<row_t>& pending) {
+                pending.insert(pending.end(), rows->begin(), rows->end());
+                if(pending.size() > limit) {
+                    dropped = pending.size() - limit;
+                    pending.erase(pending.begin(), pending.begin() + static_cast<std::ptrdiff_t>(dropped));
+                }
+                kept = pending.size();
+            });
+            COCAINE_LOG_ERROR(batch_logger,
+                              "metric batch sending failed, {} rows pending retry, {} oldest dropped - {}",
+                              kept, dropped, e.what());
+        }
+    });
+}
+
 } // namespace sender
 } // namespace cocaine
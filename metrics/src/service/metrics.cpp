@@ -17,8 +17,10 @@
 #include "metrics/filter/ge.hpp"
 #include "metrics/filter/eq.hpp"
 #include "metrics/filter/or.hpp"
-#include "metrics/visitor/dendroid.hpp"
-#include "metrics/visitor/plain.hpp"
+#include "metrics/snapshot.hpp"
+#include "metrics/visitor/exposition.hpp"
+
+#include <boost/lexical_cast.hpp>
 
 namespace cocaine {
 namespace service {
@@ -30,6 +32,12 @@ const std::array<std::tuple<std::string, metrics_t::type_t>, 2> types = {{
     std::make_tuple("plain", metrics_t::type_t::plain)
 }};
 
+/// Arbitrary queries may come with fetch, so kept exports are dropped all at once past this number.
+const std::size_t max_snapshots = 64;
+
+/// Exposition text is split into chunks of about this size, so that no single frame carries the whole dump.
+const std::size_t exposition_chunk_size = 64 * 1024;
+
 }  // namespace
 
 metrics_t::metrics_t(context_t& context,
@@ -66,25 +74,79 @@ metrics_t::metrics_t(context_t& context,
 
     for(auto& sender_name: sender_names) {
         api::sender_t::data_provider_ptr provider(new api::sender_t::function_data_provider_t([=]() {
-            return metrics(out_type, filter_ast);
+            // Senders consume a tree of their own, so the shared one is copied once per tick.
+            return *metrics(out_type, filter_ast).root;
         }));
         senders.push_back(api::sender(context, asio, sender_name.as_string(), std::move(provider)));
     }
 
-    on<io::metrics::fetch>([&](const std::string& type, const dynamic_t& query) -> dynamic_t {
+    on<io::metrics::fetch>([&](const std::string& type, const dynamic_t& query) -> metrics::tree_t {
         return metrics(type, query);
     });
+
+    on<io::metrics::expose>([&](const dynamic_t& query) -> streamed<std::string> {
+        return expose(query);
+    });
 }
 
-auto metrics_t::metrics(const std::string& type, const dynamic_t& query) const -> dynamic_t {
+auto metrics_t::metrics(const std::string& type, const dynamic_t& query) const -> metrics::tree_t {
     const auto ty = make_type(type);
+    const auto key = format("{}:{}", static_cast<int>(ty), boost::lexical_cast<std::string>(query));
+
+    // The map lock is held for the lookup only, so that exports of other queries are not blocked by this one.
+    const auto snapshot = snapshots.apply([&](std::map<std::string, std::shared_ptr<metrics::snapshot_t>>& _snapshots) {
+        auto it = _snapshots.find(key);
+        if (it == _snapshots.end()) {
+            const auto layout = ty == type_t::json ?
+                metrics::snapshot_t::layout_t::dendroid :
+                metrics::snapshot_t::layout_t::plain;
+            auto created = std::make_shared<metrics::snapshot_t>(layout, make_filter(query));
+
+            if (_snapshots.size() >= max_snapshots) {
+                _snapshots.clear();
+            }
+            it = _snapshots.emplace(key, std::move(created)).first;
+        }
+
+        return it->second;
+    });
+
+    return snapshot->update(hub);
+}
+
+auto metrics_t::expose(const dynamic_t& query) const -> streamed<std::string> {
+    streamed<std::string> stream;
     const auto filter = make_filter(query);
 
-    if (ty == type_t::json) {
-        return construct_dendroid(filter);
-    } else {
-        return construct_plain(filter);
+    // Samples are grouped by family first, as metrics of one family are not contiguous in the registry.
+    metrics::families_t families;
+    std::string rendered;
+    for (const auto& metric : hub.select(filter)) {
+        const auto name = metrics::exposition_t::sanitize(metric->name());
+
+        // Metrics of the same name differ by tags, so all of them but the name and the type become labels.
+        rendered.clear();
+        for (const auto& tag : metric->tags().tags()) {
+            if (tag.first != "name" && tag.first != "type") {
+                metrics::exposition_t::label(rendered, tag.first, tag.second);
+            }
+        }
+
+        metrics::exposition_t visitor(families, name, rendered);
+        metric->apply(visitor);
     }
+
+    std::string buffer;
+    metrics::exposition_t::write(families, buffer, exposition_chunk_size, [&](const std::string& chunk) {
+        stream.write(chunk);
+    });
+
+    if (!buffer.empty()) {
+        stream.write(buffer);
+    }
+
+    stream.close();
+    return stream;
 }
 
 auto
@@ -119,27 +181,5 @@ metrics_t::make_filter(const dynamic_t& query) const -> libmetrics::query_t {
     }
 }
 
-auto
-metrics_t::construct_plain(const libmetrics::query_t& filter) const -> dynamic_t {
-    dynamic_t::object_t out;
-    for (const auto& metric : hub.select(filter)) {
-        metrics::plain_t visitor(metric->name(), out);
-        metric->apply(visitor);
-    }
-
-    return out;
-}
-
-auto
-metrics_t::construct_dendroid(const libmetrics::query_t& filter) const -> dynamic_t {
-    dynamic_t::object_t out;
-    for (const auto& metric : hub.select(filter)) {
-        metrics::dendroid_t visitor(metric->name(), out);
-        metric->apply(visitor);
-    }
-
-    return out;
-}
-
 }  // namespace service
 }  // namespace cocaine
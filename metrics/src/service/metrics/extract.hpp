@@ -7,6 +7,7 @@
 #include "cocaine/service/metrics/fwd.hpp"
 
 #include "factory.hpp"
+#include "query.hpp"
 #include "registry.hpp"
 
 namespace cocaine {
@@ -14,7 +15,7 @@ namespace service {
 namespace metrics {
 
 /// A constant literal extractor.
-class const_t : public node_factory<dynamic_t> {
+class const_t : public node_factory {
     auto
     name() const -> const char* override {
         return "const";
@@ -26,16 +27,15 @@ class const_t : public node_factory<dynamic_t> {
     }
 
     auto
-    construct(const registry_t&, const dynamic_t::array_t& args) const -> node<dynamic_t> override {
-        const auto value = args[0];
-        return [=](const libmetrics::tagged_t&) -> dynamic_t {
-            return value;
-        };
+    construct(const registry_t&, query_builder_t& builder, const dynamic_t::array_t& args) const ->
+        std::uint32_t override
+    {
+        return builder.literal(args[0]);
     }
 };
 
 /// Metric name extractor.
-class name_t : public node_factory<dynamic_t> {
+class name_t : public node_factory {
     auto
     name() const -> const char* override {
         return "name";
@@ -47,15 +47,15 @@ class name_t : public node_factory<dynamic_t> {
     }
 
     auto
-    construct(const registry_t&, const dynamic_t::array_t&) const -> node<dynamic_t> override {
-        return [=](const libmetrics::tagged_t& metric) -> dynamic_t {
-            return metric.name();
-        };
+    construct(const registry_t&, query_builder_t& builder, const dynamic_t::array_t&) const ->
+        std::uint32_t override
+    {
+        return builder.name();
     }
 };
 
 /// Metric type extractor.
-class type_t : public node_factory<dynamic_t> {
+class type_t : public node_factory {
     auto
     name() const -> const char* override {
         return "type";
@@ -67,15 +67,15 @@ class type_t : public node_factory<dynamic_t> {
     }
 
     auto
-    construct(const registry_t&, const dynamic_t::array_t&) const -> node<dynamic_t> override {
-        return [=](const libmetrics::tagged_t& metric) -> dynamic_t {
-            return metric.tag("type").get();
-        };
+    construct(const registry_t&, query_builder_t& builder, const dynamic_t::array_t&) const ->
+        std::uint32_t override
+    {
+        return builder.tag(builder.literal("type"));
     }
 };
 
 /// Generic metric tag extractor.
-class tag_t : public node_factory<dynamic_t> {
+class tag_t : public node_factory {
 public:
     auto
     name() const -> const char* override {
@@ -88,16 +88,10 @@ public:
     }
 
     auto
-    construct(const registry_t& registry, const dynamic_t::array_t& args) const -> node<dynamic_t> override {
-        auto ex = registry.make_extractor(args.back());
-        return [=](const libmetrics::tagged_t& metric) -> dynamic_t {
-            const auto name = ex(metric).as_string();
-            if (auto result = metric.tag(name)) {
-                return result.get();
-            } else {
-                return std::string();
-            }
-        };
+    construct(const registry_t& registry, query_builder_t& builder, const dynamic_t::array_t& args) const ->
+        std::uint32_t override
+    {
+        return builder.tag(registry.make_extractor(builder, args.back()));
     }
 };
 
@@ -1,17 +1,15 @@
 #pragma once
 
+#include <cstdint>
+
 #include "cocaine/service/metrics/fwd.hpp"
 
 namespace cocaine {
 namespace service {
 namespace metrics {
 
-/// An interface for AST node factory.
-template<typename R>
+/// An interface for AST extractor node factory.
 class node_factory {
-public:
-    typedef R result_type;
-
 public:
     virtual ~node_factory() = default;
 
@@ -28,10 +26,11 @@ public:
     auto
     children() const -> boost::optional<std::size_t> = 0;
 
-    /// Constructs new AST node.
+    /// Compiles new AST node into a query operand, returns its id.
     virtual
     auto
-    construct(const registry_t& registry, const dynamic_t::array_t& args) const -> node<R> = 0;
+    construct(const registry_t& registry, query_builder_t& builder, const dynamic_t::array_t& args) const ->
+        std::uint32_t = 0;
 };
 
 }  // namespace metrics
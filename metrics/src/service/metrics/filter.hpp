@@ -1,11 +1,15 @@
 #pragma once
 
+#include <cstdint>
+
 #include <boost/optional/optional.hpp>
 
 #include <cocaine/forwards.hpp>
 
 #include "cocaine/service/metrics/fwd.hpp"
 
+#include "query.hpp"
+
 namespace cocaine {
 namespace service {
 namespace metrics {
@@ -20,8 +24,10 @@ public:
     virtual auto
     arity() const -> boost::optional<std::size_t> = 0;
 
+    /// Compiles the filter into query instructions, returns id of the root one.
     virtual auto
-    create(const registry_t& registry, const dynamic_t::array_t& args) const -> libmetrics::query_t = 0;
+    compile(const registry_t& registry, query_builder_t& builder, const dynamic_t::array_t& args) const ->
+        std::uint32_t = 0;
 };
 
 }  // namespace metrics
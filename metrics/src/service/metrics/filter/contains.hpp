@@ -18,16 +18,10 @@ public:
     }
 
     auto
-    create(const registry_t& registry, const dynamic_t::array_t& args) const ->
-        libmetrics::query_t override
+    compile(const registry_t& registry, query_builder_t& builder, const dynamic_t::array_t& args) const ->
+        std::uint32_t override
     {
-        auto f1 = registry.make_extractor(args[0]);
-        auto f2 = registry.make_extractor(args[1]);
-        return [=](const libmetrics::tagged_t& metric) -> bool {
-            auto name = f1(metric).as_string();
-            auto substring = f2(metric).as_string();
-            return name.find(substring) != std::string::npos;
-        };
+        return builder.contains(registry.make_extractor(builder, args[0]), registry.make_extractor(builder, args[1]));
     }
 };
 
@@ -20,15 +20,11 @@ public:
     }
 
     auto
-    create(const registry_t&, const dynamic_t::array_t&) const ->
-        libmetrics::query_t override
+    compile(const registry_t& registry, query_builder_t& builder, const dynamic_t::array_t& args) const ->
+        std::uint32_t override
     {
-        // auto f1 = factory.construct_query(args[0]);
-        // auto f2 = factory.construct_query(args[1]);
-        return [=](const libmetrics::tagged_t&) -> bool {
-            // return f1(metric) >= f2(metric);
-            return true;
-        };
+        return builder.greater_equal(registry.make_extractor(builder, args[0]),
+                                     registry.make_extractor(builder, args[1]));
     }
 };
 
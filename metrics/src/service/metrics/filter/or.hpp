@@ -18,28 +18,20 @@ public:
     }
 
     auto
-    create(const registry_t& registry, const dynamic_t::array_t& args) const ->
-        libmetrics::query_t override
+    compile(const registry_t& registry, query_builder_t& builder, const dynamic_t::array_t& args) const ->
+        std::uint32_t override
     {
-        std::vector<libmetrics::query_t> functions;
+        std::vector<std::uint32_t> children;
         std::transform(
             std::begin(args),
             std::end(args),
-            std::back_inserter(functions),
+            std::back_inserter(children),
             [&](const dynamic_t& arg) {
-                return registry.make_filter(arg);
+                return registry.make_filter(builder, arg);
             }
         );
 
-        return [=](const libmetrics::tagged_t& metric) -> bool {
-            return std::any_of(
-                std::begin(functions),
-                std::end(functions),
-                [&](const libmetrics::query_t& q) -> bool {
-                    return q(metric);
-                }
-            );
-        };
+        return builder.disjunction(children);
     }
 };
 
@@ -0,0 +1,394 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/optional/optional.hpp>
+
+#include <metrics/tags.hpp>
+
+#include <cocaine/dynamic.hpp>
+#include <cocaine/errors.hpp>
+
+#include "cocaine/service/metrics/fwd.hpp"
+
+namespace cocaine {
+namespace service {
+namespace metrics {
+
+/// Fixed substring matcher with the skip table precomputed, Boyer-Moore-Horspool.
+class substring_t {
+    std::string m_pattern;
+    std::array<std::size_t, 256> m_shift;
+
+public:
+    explicit
+    substring_t(std::string pattern) :
+        m_pattern(std::move(pattern))
+    {
+        m_shift.fill(m_pattern.size());
+        for (std::size_t i = 0; i + 1 < m_pattern.size(); ++i) {
+            m_shift[static_cast<unsigned char>(m_pattern[i])] = m_pattern.size() - 1 - i;
+        }
+    }
+
+    auto
+    found_in(const std::string& text) const -> bool {
+        const auto size = m_pattern.size();
+        if (size < 2) {
+            return size == 0 || text.find(m_pattern[0]) != std::string::npos;
+        }
+
+        const auto last = size - 1;
+        for (std::size_t pos = 0; pos + size <= text.size();
+             pos += m_shift[static_cast<unsigned char>(text[pos + last])])
+        {
+            if (text[pos + last] == m_pattern[last] && std::memcmp(text.data() + pos, m_pattern.data(), last) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+/// Query AST compiled into a flat array of instructions.
+///
+/// Extractors become operands: literals are converted once, tag names known at compile time are interned,
+/// so that each tag is fetched from a metric at most once per evaluation, and `contains` with a literal
+/// substring uses a precomputed matcher. Immutable after being built, so it is safe to share.
+class query_t {
+    friend class query_builder_t;
+
+    enum class opcode_t : std::uint8_t {
+        constant,
+        equals,
+        /// Lexicographic comparison of strings.
+        greater_equal,
+        /// Numeric comparison, extracted values which are not numbers never match.
+        greater_equal_number,
+        contains,
+        contains_literal,
+        conjunction,
+        disjunction
+    };
+
+    struct instruction_t {
+        opcode_t opcode;
+        bool value;
+        /// Operands for comparisons, range of children for logical operators.
+        std::uint32_t lhs;
+        std::uint32_t rhs;
+    };
+
+    enum class kind_t : std::uint8_t {
+        literal,
+        name,
+        /// Tag with interned name, index is in the interned tags table.
+        tag,
+        /// Tag with name extracted from the metric, index is the operand of the name.
+        dynamic_tag
+    };
+
+    struct operand_t {
+        kind_t kind;
+        std::uint32_t index;
+        /// Original literal value, compared as is with other literals.
+        dynamic_t value;
+        std::string text;
+        /// Numeric literal value, converted once.
+        double number;
+    };
+
+    class lookup_t {
+        const query_t& m_query;
+        const libmetrics::tagged_t& m_metric;
+        boost::optional<std::string> m_name;
+        std::vector<std::uint8_t> m_resolved;
+        std::vector<std::string> m_tags;
+        std::deque<std::string> m_dynamic;
+
+    public:
+        lookup_t(const query_t& query, const libmetrics::tagged_t& metric) :
+            m_query(query),
+            m_metric(metric),
+            m_resolved(query.m_tags.size(), 0),
+            m_tags(query.m_tags.size())
+        {}
+
+        auto
+        value(std::uint32_t id) -> const std::string& {
+            const auto& operand = m_query.m_operands[id];
+            switch (operand.kind) {
+            case kind_t::literal:
+                return operand.text;
+            case kind_t::name:
+                if (!m_name) {
+                    m_name = m_metric.name();
+                }
+                return m_name.get();
+            case kind_t::tag:
+                if (!m_resolved[operand.index]) {
+                    m_resolved[operand.index] = 1;
+                    m_tags[operand.index] = tag(m_query.m_tags[operand.index]);
+                }
+                return m_tags[operand.index];
+            case kind_t::dynamic_tag:
+            default:
+                m_dynamic.push_back(tag(value(operand.index)));
+                return m_dynamic.back();
+            }
+        }
+
+        auto
+        number(std::uint32_t id, double& result) -> bool {
+            const auto& operand = m_query.m_operands[id];
+            if (operand.kind == kind_t::literal) {
+                result = operand.number;
+                return true;
+            }
+
+            const auto& text = value(id);
+            if (text.empty()) {
+                return false;
+            }
+            char* end = nullptr;
+            result = std::strtod(text.c_str(), &end);
+            return end == text.c_str() + text.size();
+        }
+
+    private:
+        auto
+        tag(const std::string& name) const -> std::string {
+            if (auto result = m_metric.tag(name)) {
+                return result.get();
+            }
+            return std::string();
+        }
+    };
+
+    std::vector<instruction_t> m_code;
+    std::vector<std::uint32_t> m_children;
+    std::vector<operand_t> m_operands;
+    std::vector<std::string> m_tags;
+    std::vector<substring_t> m_matchers;
+    std::uint32_t m_root;
+
+public:
+    auto
+    operator()(const libmetrics::tagged_t& metric) const -> bool {
+        lookup_t lookup(*this, metric);
+        return eval(m_root, lookup);
+    }
+
+private:
+    auto
+    eval(std::uint32_t pc, lookup_t& lookup) const -> bool {
+        const auto& instruction = m_code[pc];
+        switch (instruction.opcode) {
+        case opcode_t::constant:
+            return instruction.value;
+        case opcode_t::equals:
+            return lookup.value(instruction.lhs) == lookup.value(instruction.rhs);
+        case opcode_t::greater_equal:
+            return lookup.value(instruction.lhs) >= lookup.value(instruction.rhs);
+        case opcode_t::greater_equal_number: {
+            double lhs;
+            double rhs;
+            return lookup.number(instruction.lhs, lhs) && lookup.number(instruction.rhs, rhs) && lhs >= rhs;
+        }
+        case opcode_t::contains:
+            return lookup.value(instruction.lhs).find(lookup.value(instruction.rhs)) != std::string::npos;
+        case opcode_t::contains_literal:
+            return m_matchers[instruction.rhs].found_in(lookup.value(instruction.lhs));
+        case opcode_t::conjunction:
+            for (std::uint32_t i = instruction.lhs; i < instruction.lhs + instruction.rhs; ++i) {
+                if (!eval(m_children[i], lookup)) {
+                    return false;
+                }
+            }
+            return true;
+        case opcode_t::disjunction:
+        default:
+            for (std::uint32_t i = instruction.lhs; i < instruction.lhs + instruction.rhs; ++i) {
+                if (eval(m_children[i], lookup)) {
+                    return true;
+                }
+            }
+            return false;
+        }
+    }
+};
+
+/// Builds query instructions, used by filter and extractor factories during compilation.
+///
+/// Methods return ids of created operands or instructions. Comparisons of literals are folded into
+/// constants.
+class query_builder_t {
+    std::shared_ptr<query_t> m_query;
+    std::map<std::string, std::uint32_t> m_interned;
+
+public:
+    query_builder_t() :
+        m_query(std::make_shared<query_t>())
+    {}
+
+    auto
+    literal(dynamic_t value) -> std::uint32_t {
+        query_t::operand_t operand{query_t::kind_t::literal, 0, std::move(value), std::string(), 0};
+        if (operand.value.is_string()) {
+            operand.text = operand.value.as_string();
+        } else if (operand.value.is_int()) {
+            operand.number = static_cast<double>(operand.value.as_int());
+        } else if (operand.value.is_uint()) {
+            operand.number = static_cast<double>(operand.value.as_uint());
+        } else if (operand.value.is_double()) {
+            operand.number = operand.value.as_double();
+        }
+        return add(std::move(operand));
+    }
+
+    auto
+    name() -> std::uint32_t {
+        return add({query_t::kind_t::name, 0, dynamic_t(), std::string(), 0});
+    }
+
+    auto
+    tag(std::uint32_t key) -> std::uint32_t {
+        const auto& operand = m_query->m_operands[key];
+        if (operand.kind != query_t::kind_t::literal) {
+            return add({query_t::kind_t::dynamic_tag, key, dynamic_t(), std::string(), 0});
+        }
+        if (!operand.value.is_string()) {
+            throw cocaine::error_t("tag name must be a string");
+        }
+
+        auto it = m_interned.find(operand.text);
+        if (it == m_interned.end()) {
+            it = m_interned.emplace(operand.text, m_query->m_tags.size()).first;
+            m_query->m_tags.push_back(operand.text);
+        }
+        return add({query_t::kind_t::tag, it->second, dynamic_t(), std::string(), 0});
+    }
+
+    auto
+    constant(bool value) -> std::uint32_t {
+        return emit({query_t::opcode_t::constant, value, 0, 0});
+    }
+
+    auto
+    equals(std::uint32_t lhs, std::uint32_t rhs) -> std::uint32_t {
+        const auto& a = m_query->m_operands[lhs];
+        const auto& b = m_query->m_operands[rhs];
+        if (is_literal(a) && is_literal(b)) {
+            return constant(a.value == b.value);
+        }
+        // Extracted values are strings, so they never equal literals of other types.
+        if ((is_literal(a) && !a.value.is_string()) || (is_literal(b) && !b.value.is_string())) {
+            return constant(false);
+        }
+        return emit({query_t::opcode_t::equals, false, lhs, rhs});
+    }
+
+    /// Numbers are compared if either side is a numeric literal, extracted values are parsed then. Strings are
+    /// compared lexicographically otherwise.
+    auto
+    greater_equal(std::uint32_t lhs, std::uint32_t rhs) -> std::uint32_t {
+        const auto& a = m_query->m_operands[lhs];
+        const auto& b = m_query->m_operands[rhs];
+        if (!is_comparable(a) || !is_comparable(b)) {
+            throw cocaine::error_t("'ge' arguments must be strings or numbers");
+        }
+        const auto numeric = is_number(a) || is_number(b);
+        if (is_literal(a) && is_literal(b)) {
+            if (is_number(a) != is_number(b)) {
+                return constant(false);
+            }
+            return constant(numeric ? a.number >= b.number : a.text >= b.text);
+        }
+        return emit({numeric ? query_t::opcode_t::greater_equal_number : query_t::opcode_t::greater_equal,
+                     false, lhs, rhs});
+    }
+
+    auto
+    contains(std::uint32_t haystack, std::uint32_t needle) -> std::uint32_t {
+        const auto& a = m_query->m_operands[haystack];
+        const auto& b = m_query->m_operands[needle];
+        if ((is_literal(a) && !a.value.is_string()) || (is_literal(b) && !b.value.is_string())) {
+            throw cocaine::error_t("'contains' arguments must be strings");
+        }
+        if (is_literal(a) && is_literal(b)) {
+            return constant(a.text.find(b.text) != std::string::npos);
+        }
+        if (is_literal(b)) {
+            m_query->m_matchers.emplace_back(b.text);
+            return emit({query_t::opcode_t::contains_literal, false, haystack,
+                         static_cast<std::uint32_t>(m_query->m_matchers.size() - 1)});
+        }
+        return emit({query_t::opcode_t::contains, false, haystack, needle});
+    }
+
+    auto
+    conjunction(const std::vector<std::uint32_t>& children) -> std::uint32_t {
+        return logical(query_t::opcode_t::conjunction, children);
+    }
+
+    auto
+    disjunction(const std::vector<std::uint32_t>& children) -> std::uint32_t {
+        return logical(query_t::opcode_t::disjunction, children);
+    }
+
+    auto
+    build(std::uint32_t root) -> std::shared_ptr<const query_t> {
+        m_query->m_root = root;
+        return std::move(m_query);
+    }
+
+private:
+    static
+    auto
+    is_literal(const query_t::operand_t& operand) -> bool {
+        return operand.kind == query_t::kind_t::literal;
+    }
+
+    static
+    auto
+    is_number(const query_t::operand_t& operand) -> bool {
+        return is_literal(operand) && (operand.value.is_int() || operand.value.is_uint() || operand.value.is_double());
+    }
+
+    static
+    auto
+    is_comparable(const query_t::operand_t& operand) -> bool {
+        return !is_literal(operand) || operand.value.is_string() || is_number(operand);
+    }
+
+    auto
+    add(query_t::operand_t operand) -> std::uint32_t {
+        m_query->m_operands.push_back(std::move(operand));
+        return static_cast<std::uint32_t>(m_query->m_operands.size() - 1);
+    }
+
+    auto
+    emit(query_t::instruction_t instruction) -> std::uint32_t {
+        m_query->m_code.push_back(instruction);
+        return static_cast<std::uint32_t>(m_query->m_code.size() - 1);
+    }
+
+    auto
+    logical(query_t::opcode_t opcode, const std::vector<std::uint32_t>& children) -> std::uint32_t {
+        const auto first = static_cast<std::uint32_t>(m_query->m_children.size());
+        m_query->m_children.insert(m_query->m_children.end(), children.begin(), children.end());
+        return emit({opcode, false, first, static_cast<std::uint32_t>(children.size())});
+    }
+};
+
+}  // namespace metrics
+}  // namespace service
+}  // namespace cocaine
@@ -1,21 +1,32 @@
 #pragma once
 
+#include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
 
+#include <boost/lexical_cast.hpp>
+
 #include <metrics/fwd.hpp>
 
 #include "extract.hpp"
 #include "filter.hpp"
+#include "query.hpp"
 
 namespace cocaine {
 namespace service {
 namespace metrics {
 
 class registry_t {
+    /// Compiled queries are kept until there are more of them than this, keyed by their AST.
+    static constexpr std::size_t max_queries = 64;
+
     std::unordered_map<std::string, std::shared_ptr<filter_t>> filters;
-    std::unordered_map<std::string, std::shared_ptr<node_factory<dynamic_t>>> extractors;
+    std::unordered_map<std::string, std::shared_ptr<node_factory>> extractors;
+
+    mutable std::mutex mutex;
+    mutable std::map<std::string, std::shared_ptr<const query_t>> queries;
 
 public:
     auto
@@ -24,12 +35,42 @@ public:
     }
 
     auto
-    add(std::shared_ptr<node_factory<dynamic_t>> extractor) -> void {
+    add(std::shared_ptr<node_factory> extractor) -> void {
         extractors[extractor->name()] = std::move(extractor);
     }
 
+    /// Compiles the query AST, or takes the one compiled before from the cache.
     auto
     make_filter(const dynamic_t& tree) const -> libmetrics::query_t {
+        const auto key = boost::lexical_cast<std::string>(tree);
+
+        std::shared_ptr<const query_t> query;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = queries.find(key);
+            if (it != queries.end()) {
+                query = it->second;
+            }
+        }
+
+        if (!query) {
+            query_builder_t builder;
+            query = builder.build(make_filter(builder, tree));
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if (queries.size() >= max_queries) {
+                queries.clear();
+            }
+            queries[key] = query;
+        }
+
+        return [=](const libmetrics::tagged_t& metric) -> bool {
+            return (*query)(metric);
+        };
+    }
+
+    auto
+    make_filter(query_builder_t& builder, const dynamic_t& tree) const -> std::uint32_t {
         if (!tree.is_object()) {
             throw cocaine::error_t("AST filter node must be an object");
         }
@@ -54,11 +95,11 @@ public:
             }
         }
 
-        return filter->create(*this, args);
+        return filter->compile(*this, builder, args);
     }
 
     auto
-    make_extractor(const dynamic_t& tree) const -> node<dynamic_t> {
+    make_extractor(query_builder_t& builder, const dynamic_t& tree) const -> std::uint32_t {
         if (!tree.is_object()) {
             throw cocaine::error_t("AST extractor node must be an object");
         }
@@ -83,7 +124,7 @@ public:
             }
         }
 
-        return ex->construct(*this, args);
+        return ex->construct(*this, builder, args);
     }
 };
 
@@ -0,0 +1,190 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/algorithm/string/split.hpp>
+
+#include <metrics/registry.hpp>
+#include <metrics/tags.hpp>
+
+#include <cocaine/dynamic.hpp>
+#include <cocaine/errors.hpp>
+
+#include "cocaine/service/metrics/tree.hpp"
+
+#include "visitor/fields.hpp"
+
+namespace cocaine {
+namespace service {
+namespace metrics {
+
+/// Export of metrics selected by a single query in a single layout, kept between exports.
+///
+/// While the set of selected metrics stays the same, the previous tree is reused and only values are
+/// refreshed through pointers located when the tree was built. Query results are memoized per metric name
+/// and full tag set, so the query is evaluated only for metrics registered since the previous export.
+///
+/// The tree is published to readers without copying. A published tree is never changed: it is refreshed in place
+/// only when no reader holds it anymore, otherwise a new one is built.
+///
+/// Exports of the same snapshot are serialized by its own lock, different snapshots are updated concurrently.
+class snapshot_t {
+public:
+    enum class layout_t {
+        /// Flat object keyed by full metric names.
+        plain,
+        /// Tree of objects, split by dots in metric names.
+        dendroid
+    };
+
+private:
+    struct entry_t {
+        std::string name;
+        fields_t::state_t state;
+    };
+
+    const layout_t m_layout;
+    const libmetrics::query_t m_filter;
+
+    std::mutex m_mutex;
+    std::map<libmetrics::tags_t, bool> m_matches;
+    std::vector<entry_t> m_entries;
+    std::shared_ptr<dynamic_t> m_tree;
+
+    /// Set when metric paths overlap in the dendroid layout, f.e. "a.b" and "a.b.c", so that a value is
+    /// replaced with an object. Slots may dangle then, and the tree is rebuilt on every export, as before.
+    bool m_conflict;
+
+public:
+    snapshot_t(layout_t layout, libmetrics::query_t filter) :
+        m_layout(layout),
+        m_filter(std::move(filter)),
+        m_tree(std::make_shared<dynamic_t>(dynamic_t::empty_object)),
+        m_conflict(false)
+    {}
+
+    auto
+    update(libmetrics::registry_t& hub) -> tree_t {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        std::size_t total = 0;
+        const auto selected = hub.select([&](const libmetrics::tagged_t& metric) -> bool {
+            ++total;
+            return matches(metric);
+        });
+
+        // Drop results of metrics removed from the registry.
+        if (m_matches.size() > 2 * total) {
+            m_matches.clear();
+        }
+
+        // Only this snapshot can hand out new references to the tree, and it does so under the lock.
+        if (m_tree.use_count() > 1 || !refresh(selected)) {
+            rebuild(selected);
+        }
+
+        return tree_t{m_tree};
+    }
+
+private:
+    auto
+    matches(const libmetrics::tagged_t& metric) -> bool {
+        // Queries may filter on any tag, so the whole tag set, including the name, is the key.
+        const auto& key = metric.tags();
+
+        auto it = m_matches.find(key);
+        if (it == m_matches.end()) {
+            it = m_matches.emplace(key, m_filter(metric)).first;
+        }
+        return it->second;
+    }
+
+    template<typename Metrics>
+    auto
+    refresh(const Metrics& selected) -> bool {
+        if (m_conflict || selected.size() != m_entries.size()) {
+            return false;
+        }
+
+        for (std::size_t i = 0; i < selected.size(); ++i) {
+            if (selected[i]->name() != m_entries[i].name) {
+                return false;
+            }
+        }
+
+        for (std::size_t i = 0; i < selected.size(); ++i) {
+            fields_t visitor(m_entries[i].state, nullptr);
+            selected[i]->apply(visitor);
+            if (visitor.broken()) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    template<typename Metrics>
+    auto
+    rebuild(const Metrics& selected) -> void {
+        // The previous tree is left to its readers, if any.
+        m_tree = std::make_shared<dynamic_t>(dynamic_t::empty_object);
+        m_entries.clear();
+        m_entries.reserve(selected.size());
+        m_conflict = false;
+
+        std::vector<std::string> parts;
+        for (const auto& metric : selected) {
+            m_entries.push_back(entry_t{metric->name(), fields_t::state_t()});
+            const auto& name = m_entries.back().name;
+
+            if (m_layout == layout_t::dendroid) {
+                parts.clear();
+                boost::split(parts, name, boost::is_any_of("."), boost::token_compress_on);
+                if (parts.empty()) {
+                    throw cocaine::error_t("metric name must contain at least one alphanumeric character");
+                }
+            }
+
+            auto& root = m_tree->as_object();
+            const fields_t::locate_t locate = [&](const char* suffix) -> dynamic_t* {
+                if (m_layout == layout_t::plain) {
+                    return *suffix ? &root[name + "." + suffix] : &root[name];
+                } else {
+                    return locate_dendroid(parts, suffix);
+                }
+            };
+
+            fields_t visitor(m_entries.back().state, &locate);
+            metric->apply(visitor);
+        }
+    }
+
+    /// Scalar values are stored by the last name part, meters and timers are objects of their values.
+    auto
+    locate_dendroid(const std::vector<std::string>& parts, const char* suffix) -> dynamic_t* {
+        const auto depth = *suffix ? parts.size() : parts.size() - 1;
+
+        dynamic_t::object_t* node = &m_tree->as_object();
+        for (std::size_t i = 0; i < depth; ++i) {
+            auto& child = (*node)[parts[i]];
+            if (!child.is_object()) {
+                m_conflict = m_conflict || !child.is_null();
+                child = dynamic_t::object_t();
+            }
+            node = &child.as_object();
+        }
+
+        auto& slot = *suffix ? (*node)[suffix] : (*node)[parts.back()];
+        m_conflict = m_conflict || slot.is_object();
+        return &slot;
+    }
+};
+
+}  // namespace metrics
+}  // namespace service
+}  // namespace cocaine
@@ -0,0 +1,219 @@
+#pragma once
+
+#include <metrics/accumulator/sliding/window.hpp>
+#include <metrics/accumulator/decaying/exponentially.hpp>
+#include <metrics/accumulator/snapshot/uniform.hpp>
+#include <metrics/meter.hpp>
+#include <metrics/timer.hpp>
+#include <metrics/visitor.hpp>
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <utility>
+
+namespace cocaine {
+namespace service {
+namespace metrics {
+
+/// Samples of a single metric family, with the type written in its TYPE comment.
+struct family_t {
+    const char* kind;
+    std::string samples;
+};
+
+/// Families ordered by name. Samples of labeled metrics and derived families, like `_total` of meters, are
+/// interleaved in the registry, so they are grouped here to get exactly one TYPE comment per family.
+typedef std::map<std::string, family_t> families_t;
+
+/// Appends samples of a metric in Prometheus text exposition format to the families they belong to.
+///
+/// Counters and gauges are written as is, meters as a `_total` counter with rate gauges, timers as
+/// summaries in seconds. String gauges become info-like metrics with the value in the `value` label.
+/// The first metric of a family determines its type.
+class exposition_t : public libmetrics::visitor_t {
+    families_t& m_out;
+    const std::string& m_name;
+    const std::string& m_labels;
+
+public:
+    /// Name must be already sanitized, labels are the rendered `key="value"` pairs joined by commas.
+    exposition_t(families_t& out, const std::string& name, const std::string& labels) :
+        m_out(out),
+        m_name(name),
+        m_labels(labels)
+    {}
+
+    /// Appends families with their TYPE comments to the buffer, calling flush whenever the buffer grows
+    /// past the given size.
+    template<typename Flush>
+    static
+    auto
+    write(const families_t& families, std::string& buffer, std::size_t size, Flush flush) -> void {
+        for (const auto& family : families) {
+            buffer.append("# TYPE ");
+            buffer.append(family.first);
+            buffer.push_back(' ');
+            buffer.append(family.second.kind);
+            buffer.push_back('\n');
+            buffer.append(family.second.samples);
+
+            if (buffer.size() >= size) {
+                flush(buffer);
+                buffer.clear();
+            }
+        }
+    }
+
+    /// Replaces characters not allowed in metric names with underscores.
+    static
+    auto
+    sanitize(const std::string& name) -> std::string {
+        std::string result(name);
+        for (std::size_t i = 0; i < result.size(); ++i) {
+            const char c = result[i];
+            const bool valid = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || c == ':' ||
+                (i > 0 && c >= '0' && c <= '9');
+            if (!valid) {
+                result[i] = '_';
+            }
+        }
+        return result;
+    }
+
+    /// Appends `key="value"` label pair, escaping the value.
+    static
+    auto
+    label(std::string& out, const std::string& key, const std::string& value) -> void {
+        if (!out.empty()) {
+            out.push_back(',');
+        }
+        out.append(sanitize(key));
+        out.append("=\"");
+        for (const char c : value) {
+            if (c == '\\' || c == '"') {
+                out.push_back('\\');
+                out.push_back(c);
+            } else if (c == '\n') {
+                out.append("\\n");
+            } else {
+                out.push_back(c);
+            }
+        }
+        out.push_back('"');
+    }
+
+    auto visit(const libmetrics::gauge<std::int64_t>& metric) -> void override {
+        sample(family(m_name, "gauge"), m_name, "", static_cast<double>(metric()));
+    }
+
+    auto visit(const libmetrics::gauge<std::uint64_t>& metric) -> void override {
+        sample(family(m_name, "gauge"), m_name, "", static_cast<double>(metric()));
+    }
+
+    auto visit(const libmetrics::gauge<std::double_t>& metric) -> void override {
+        sample(family(m_name, "gauge"), m_name, "", metric());
+    }
+
+    auto visit(const libmetrics::gauge<std::string>& metric) -> void override {
+        std::string extra;
+        label(extra, "value", metric());
+        sample(family(m_name, "gauge"), m_name, extra, 1);
+    }
+
+    auto visit(const std::atomic<std::int64_t>& metric) -> void override {
+        sample(family(m_name, "counter"), m_name, "", static_cast<double>(metric.load()));
+    }
+
+    auto visit(const std::atomic<std::uint64_t>& metric) -> void override {
+        sample(family(m_name, "counter"), m_name, "", static_cast<double>(metric.load()));
+    }
+
+    auto visit(const libmetrics::meter_t& metric) -> void override {
+        rates(metric.count(), metric.m01rate(), metric.m05rate(), metric.m15rate());
+    }
+
+    auto visit(const libmetrics::timer<libmetrics::accumulator::sliding::window_t>& metric) -> void override {
+        do_visit(metric);
+    }
+
+    auto visit(const libmetrics::timer<libmetrics::accumulator::decaying::exponentially_t>& metric) -> void override {
+        do_visit(metric);
+    }
+
+private:
+    template<typename T>
+    auto do_visit(const libmetrics::timer<T>& metric) -> void {
+        const auto snapshot = metric.snapshot();
+        const std::pair<const char*, double> quantiles[] = {
+            {"0.5", snapshot.median()},
+            {"0.75", snapshot.p75()},
+            {"0.9", snapshot.p90()},
+            {"0.95", snapshot.p95()},
+            {"0.98", snapshot.p98()},
+            {"0.99", snapshot.p99()}
+        };
+
+        auto& summary = family(m_name, "summary");
+        for (const auto& quantile : quantiles) {
+            std::string extra;
+            label(extra, "quantile", quantile.first);
+            // Timers measure nanoseconds.
+            sample(summary, m_name, extra, quantile.second / 1e9);
+        }
+        sample(summary, m_name + "_count", "", static_cast<double>(metric.count()));
+
+        rates(metric.count(), metric.m01rate(), metric.m05rate(), metric.m15rate(), "_calls");
+    }
+
+    auto
+    rates(std::uint64_t count, double m01rate, double m05rate, double m15rate, const char* infix = "") -> void {
+        const auto base = m_name + infix;
+        sample(family(base + "_total", "counter"), base + "_total", "", static_cast<double>(count));
+        sample(family(base + "_m01rate", "gauge"), base + "_m01rate", "", m01rate);
+        sample(family(base + "_m05rate", "gauge"), base + "_m05rate", "", m05rate);
+        sample(family(base + "_m15rate", "gauge"), base + "_m15rate", "", m15rate);
+    }
+
+    /// Returns samples of the family, registering it with the given type if it is new.
+    auto
+    family(const std::string& name, const char* kind) -> std::string& {
+        auto it = m_out.find(name);
+        if (it == m_out.end()) {
+            it = m_out.emplace(name, family_t{kind, std::string()}).first;
+        }
+        return it->second.samples;
+    }
+
+    auto
+    sample(std::string& out, const std::string& name, const std::string& extra, double value) -> void {
+        out.append(name);
+        if (!m_labels.empty() || !extra.empty()) {
+            out.push_back('{');
+            out.append(m_labels);
+            if (!m_labels.empty() && !extra.empty()) {
+                out.push_back(',');
+            }
+            out.append(extra);
+            out.push_back('}');
+        }
+        out.push_back(' ');
+
+        if (std::isnan(value)) {
+            out.append("NaN");
+        } else if (std::isinf(value)) {
+            out.append(value > 0 ? "+Inf" : "-Inf");
+        } else {
+            char buffer[32];
+            const auto size = std::snprintf(buffer, sizeof(buffer), "%.15g", value);
+            out.append(buffer, static_cast<std::size_t>(size));
+        }
+        out.push_back('\n');
+    }
+};
+
+}  // namespace metrics
+}  // namespace service
+}  // namespace cocaine
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <metrics/accumulator/sliding/window.hpp>
+#include <metrics/accumulator/decaying/exponentially.hpp>
+#include <metrics/accumulator/snapshot/uniform.hpp>
+#include <metrics/meter.hpp>
+#include <metrics/timer.hpp>
+#include <metrics/visitor.hpp>
+
+#include <cocaine/dynamic.hpp>
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace cocaine {
+namespace service {
+namespace metrics {
+
+/// Writes metric values into slots of an output tree.
+///
+/// Slots are located on the first visit only, by the suffix of the value: empty for scalar metrics,
+/// "count", "p99" and so on for meters and timers. Later visits write values by remembered pointers,
+/// which stay valid while the tree structure is not changed.
+class fields_t : public libmetrics::visitor_t {
+public:
+    typedef std::function<dynamic_t*(const char* suffix)> locate_t;
+
+    struct state_t {
+        std::vector<dynamic_t*> slots;
+    };
+
+private:
+    state_t& m_state;
+    const locate_t* m_locate;
+    std::size_t m_index;
+    bool m_broken;
+
+public:
+    /// Locates slots when `locate` is provided, otherwise writes to the ones located before.
+    fields_t(state_t& state, const locate_t* locate) :
+        m_state(state),
+        m_locate(locate),
+        m_index(0),
+        m_broken(false)
+    {}
+
+    /// Whether the metric does not fit slots located before, f.e. it was replaced by another type.
+    auto
+    broken() const -> bool {
+        return m_broken || m_index != m_state.slots.size();
+    }
+
+    auto visit(const libmetrics::gauge<std::int64_t>& metric) -> void override {
+        field("", metric());
+    }
+
+    auto visit(const libmetrics::gauge<std::uint64_t>& metric) -> void override {
+        field("", metric());
+    }
+
+    auto visit(const libmetrics::gauge<std::double_t>& metric) -> void override {
+        field("", metric());
+    }
+
+    auto visit(const libmetrics::gauge<std::string>& metric) -> void override {
+        field("", metric());
+    }
+
+    auto visit(const std::atomic<std::int64_t>& metric) -> void override {
+        field("", metric.load());
+    }
+
+    auto visit(const std::atomic<std::uint64_t>& metric) -> void override {
+        field("", metric.load());
+    }
+
+    auto visit(const libmetrics::meter_t& metric) -> void override {
+        field("count", metric.count());
+        field("m01rate", metric.m01rate());
+        field("m05rate", metric.m05rate());
+        field("m15rate", metric.m15rate());
+    }
+
+    auto visit(const libmetrics::timer<libmetrics::accumulator::sliding::window_t>& metric) -> void override {
+        do_visit(metric);
+    }
+
+    auto visit(const libmetrics::timer<libmetrics::accumulator::decaying::exponentially_t>& metric) -> void override {
+        do_visit(metric);
+    }
+
+private:
+    template<typename T>
+    auto do_visit(const libmetrics::timer<T>& metric) -> void {
+        field("count", metric.count());
+        field("m01rate", metric.m01rate());
+        field("m05rate", metric.m05rate());
+        field("m15rate", metric.m15rate());
+
+        // Quantiles are recalculated even for an unchanged count: samples age out of the sliding window
+        // and the decaying reservoir is rescaled with time.
+        const auto snapshot = metric.snapshot();
+        field("p50", snapshot.median() / 1e6);
+        field("p75", snapshot.p75() / 1e6);
+        field("p90", snapshot.p90() / 1e6);
+        field("p95", snapshot.p95() / 1e6);
+        field("p98", snapshot.p98() / 1e6);
+        field("p99", snapshot.p99() / 1e6);
+        field("mean", snapshot.mean() / 1e6);
+        field("stddev", snapshot.stddev() / 1e6);
+    }
+
+    auto
+    field(const char* suffix, dynamic_t value) -> void {
+        if (m_locate) {
+            m_state.slots.push_back((*m_locate)(suffix));
+        } else if (m_index >= m_state.slots.size()) {
+            m_broken = true;
+            return;
+        }
+        *m_state.slots[m_index++] = std::move(value);
+    }
+};
+
+}  // namespace metrics
+}  // namespace service
+}  // namespace cocaine
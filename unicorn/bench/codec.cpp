@@ -0,0 +1,135 @@
+/*
+* 2015+ Copyright (c) Anton Matveenko <antmat@yandex-team.ru>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*/
+
+// Microbenchmark of the unicorn value codec against the plain sbuffer and per call zone implementation.
+// Usage: unicorn-codec-bench [iterations]
+
+#include "cocaine/traits/unicorn.hpp"
+#include "cocaine/zookeeper.hpp"
+
+#include <cocaine/dynamic.hpp>
+#include <cocaine/errors.hpp>
+
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+
+using namespace cocaine;
+
+namespace {
+
+auto baseline_serialize(const unicorn::value_t& val) -> std::string {
+    msgpack::sbuffer buffer;
+    msgpack::packer<msgpack::sbuffer> packer(buffer);
+    io::type_traits<dynamic_t>::pack(packer, val);
+    return std::string(buffer.data(), buffer.size());
+}
+
+auto baseline_unserialize(const std::string& val) -> unicorn::value_t {
+    msgpack::object obj;
+    std::unique_ptr<msgpack::zone> z(new msgpack::zone());
+
+    msgpack_unpack_return ret = msgpack_unpack(
+            val.c_str(), val.size(), nullptr, z.get(),
+            reinterpret_cast<msgpack_object*>(&obj)
+    );
+
+    if(static_cast<msgpack::unpack_return>(ret) != msgpack::UNPACK_SUCCESS) {
+        throw std::system_error(error::unicorn_errors::invalid_value);
+    }
+    unicorn::value_t target;
+    io::type_traits<dynamic_t>::unpack(obj, target);
+    return target;
+}
+
+auto small_value() -> unicorn::value_t {
+    return unicorn::value_t(42);
+}
+
+auto endpoints_value() -> unicorn::value_t {
+    dynamic_t::array_t endpoints;
+    for(int i = 0; i < 4; i++) {
+        endpoints.push_back(dynamic_t::array_t{dynamic_t("2a02:6b8:0:1a16::" + std::to_string(i)), dynamic_t(10053u)});
+    }
+    return endpoints;
+}
+
+auto acl_value() -> unicorn::value_t {
+    dynamic_t::object_t cids;
+    dynamic_t::object_t uids;
+    for(int i = 0; i < 64; i++) {
+        cids[std::to_string(1000 + i)] = 3;
+        uids[std::to_string(2000 + i)] = 1;
+    }
+    return dynamic_t::array_t{cids, uids};
+}
+
+template<class F>
+auto measure(const std::string& name, size_t iterations, F f) -> void {
+    auto start = std::chrono::steady_clock::now();
+    for(size_t i = 0; i < iterations; i++) {
+        f();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+    std::cout << std::left << std::setw(40) << name
+              << std::right << std::setw(10) << ns / static_cast<double>(iterations) << " ns/op" << std::endl;
+}
+
+auto run(const std::string& name, const unicorn::value_t& value, size_t iterations) -> void {
+    const auto packed = zookeeper::serialize(value);
+    size_t sink = 0;
+    std::string target;
+
+    measure(name + "/serialize/baseline", iterations, [&] {
+        sink += baseline_serialize(value).size();
+    });
+    measure(name + "/serialize", iterations, [&] {
+        sink += zookeeper::serialize(value).size();
+    });
+    measure(name + "/serialize/reuse", iterations, [&] {
+        zookeeper::serialize(value, target);
+        sink += target.size();
+    });
+    measure(name + "/unserialize/baseline", iterations, [&] {
+        sink += baseline_unserialize(packed).is_null();
+    });
+    measure(name + "/unserialize", iterations, [&] {
+        sink += zookeeper::unserialize(packed).is_null();
+    });
+    measure(name + "/unserialize/raw", iterations, [&] {
+        sink += zookeeper::unserialize_raw(packed).data().size();
+    });
+
+    // Keeps the optimizer from throwing the loops away.
+    volatile size_t result = sink;
+    static_cast<void>(result);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const size_t iterations = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+
+    run("small", small_value(), iterations);
+    run("endpoints", endpoints_value(), iterations);
+    run("acl", acl_value(), iterations / 10);
+
+    return 0;
+}
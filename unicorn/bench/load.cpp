@@ -0,0 +1,266 @@
+/*
+* 2015+ Copyright (c) Anton Matveenko <antmat@yandex-team.ru>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*/
+
+// Load benchmark of the unicorn backend running on top of the in-memory zookeeper connection.
+// Drives closed-loop get/put/subscribe/lock workloads through api::unicorn_t and reports throughput and latency.
+// Usage: unicorn-load-bench <cocaine config> [operations] [concurrency] [latency_us]
+
+#include "cocaine/unicorn/zookeeper.hpp"
+
+#include <cocaine/context.hpp>
+#include <cocaine/context/config.hpp>
+#include <cocaine/dynamic.hpp>
+
+#include <blackhole/root.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <functional>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace cocaine;
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+using scope_ptr = api::unicorn_scope_ptr;
+
+/// Completion of a single operation, reports whether it has succeeded.
+typedef std::function<void(bool)> done_t;
+
+/// Unicorn callback which completes the operation on the first reply regardless of the result type.
+struct reply_t {
+    done_t done;
+
+    template<class T>
+    auto operator()(std::future<T> future) const -> void {
+        try {
+            future.get();
+            done(true);
+        } catch(const std::exception&) {
+            done(false);
+        }
+    }
+};
+
+/// Keeps the scope of a long-living operation until its callback decides to close it. The callback may fire before
+/// the scope is returned by the backend, so whichever comes last closes it.
+class holder_t {
+public:
+    auto assign(scope_ptr scope) -> void {
+        std::lock_guard<std::mutex> lock(mutex);
+        if(released) {
+            scope->close();
+        } else {
+            this->scope = std::move(scope);
+        }
+    }
+
+    auto release() -> void {
+        scope_ptr scope;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if(released) {
+                return;
+            }
+            released = true;
+            scope.swap(this->scope);
+        }
+        if(scope) {
+            scope->close();
+        }
+    }
+
+private:
+    std::mutex mutex;
+    scope_ptr scope;
+    bool released = false;
+};
+
+/// Runs operations keeping the given number of them in flight until the total amount is completed.
+class runner_t {
+public:
+    typedef std::function<void(size_t, done_t)> operation_t;
+
+    runner_t(size_t total, size_t concurrency, operation_t operation) :
+        total(total),
+        concurrency(std::min(concurrency, total)),
+        operation(std::move(operation)),
+        issued(0),
+        completed(0),
+        failed(0),
+        latencies(total)
+    {}
+
+    auto run(const std::string& name) -> void {
+        auto start = clock_type::now();
+        for(size_t i = 0; i < concurrency; i++) {
+            next();
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        finished.wait(lock, [&] {
+            return completed == total;
+        });
+        auto elapsed = std::chrono::duration<double>(clock_type::now() - start).count();
+
+        std::sort(latencies.begin(), latencies.end());
+        auto percentile = [&](double p) {
+            return latencies[std::min(latencies.size() - 1, static_cast<size_t>(p * latencies.size()))];
+        };
+
+        std::cout << std::left << std::setw(12) << name
+                  << std::right << std::setw(12) << static_cast<size_t>(total / elapsed) << " ops/s"
+                  << "  p50 " << std::setw(8) << percentile(0.5) << " us"
+                  << "  p99 " << std::setw(8) << percentile(0.99) << " us"
+                  << "  max " << std::setw(8) << latencies.back() << " us"
+                  << "  failed " << failed << std::endl;
+    }
+
+private:
+    auto next() -> void {
+        auto id = issued++;
+        if(id >= total) {
+            return;
+        }
+        auto start = clock_type::now();
+        operation(id, [=](bool ok) {
+            latencies[id] = std::chrono::duration_cast<std::chrono::microseconds>(clock_type::now() - start).count();
+            if(!ok) {
+                failed++;
+            }
+            next();
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if(++completed == total) {
+                finished.notify_all();
+            }
+        });
+    }
+
+    const size_t total;
+    const size_t concurrency;
+    const operation_t operation;
+
+    std::atomic<size_t> issued;
+    size_t completed;
+    std::atomic<size_t> failed;
+    std::vector<long> latencies;
+
+    std::mutex mutex;
+    std::condition_variable finished;
+};
+
+auto key(const std::string& prefix, size_t id) -> std::string {
+    // Spreads operations over a fixed set of nodes so that workloads hit both hot and cold paths.
+    return "/bench/" + prefix + "/" + std::to_string(id % 1024);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if(argc < 2) {
+        std::cerr << "usage: " << argv[0] << " <cocaine config> [operations] [concurrency] [latency_us]" << std::endl;
+        return 1;
+    }
+    const size_t total = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 100000;
+    const size_t concurrency = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 256;
+    const unsigned int latency = argc > 4 ? std::strtoul(argv[4], nullptr, 10) : 0;
+
+    std::vector<std::unique_ptr<blackhole::handler_t>> handlers;
+    std::unique_ptr<logging::logger_t> logger(new blackhole::root_logger_t(std::move(handlers)));
+    auto context = get_context(make_config(argv[1]), std::move(logger));
+
+    dynamic_t::object_t memory;
+    memory["latency_us"] = latency;
+    dynamic_t::object_t args;
+    args["memory"] = memory;
+
+    unicorn::zookeeper_t backend(*context, "bench", args);
+    api::unicorn_t& unicorn = backend;
+    const unicorn::value_t value = dynamic_t::array_t{dynamic_t("2a02:6b8:0:1a16::1"), dynamic_t(10053u)};
+
+    runner_t(1024, concurrency, [&](size_t id, done_t done) {
+        unicorn.create(reply_t{done}, key("data", id), value, false, false);
+    }).run("setup");
+
+    runner_t(total, concurrency, [&](size_t id, done_t done) {
+        unicorn.get(reply_t{done}, key("data", id));
+    }).run("get");
+
+    // Put is conditional, so each operation reads the current version first and writes with it.
+    runner_t(total, concurrency, [&](size_t id, done_t done) {
+        auto path = key("data", id);
+        unicorn.get([=, &unicorn](std::future<unicorn::versioned_value_t> future) {
+            try {
+                unicorn.put(reply_t{done}, path, value, future.get().version());
+            } catch(const std::exception&) {
+                done(false);
+            }
+        }, path);
+    }).run("put");
+
+    // Each operation subscribes and writes the node with the version from the first reply, completing on the
+    // notification caused by the write. A rejected write still notifies, as someone else has changed the node.
+    runner_t(total / 4, concurrency, [&](size_t id, done_t done) {
+        auto holder = std::make_shared<holder_t>();
+        auto path = key("data", id);
+        auto notified = std::make_shared<std::atomic<int>>(0);
+        auto finished = std::make_shared<std::atomic<bool>>(false);
+        auto finish = [=](bool ok) {
+            if(!finished->exchange(true)) {
+                holder->release();
+                done(ok);
+            }
+        };
+        holder->assign(unicorn.subscribe([=, &unicorn](std::future<unicorn::versioned_value_t> future) {
+            auto count = ++*notified;
+            try {
+                auto version = future.get().version();
+                if(count == 1) {
+                    unicorn.put(reply_t{[=](bool ok) {
+                        if(!ok) {
+                            finish(false);
+                        }
+                    }}, path, value, version);
+                    return;
+                }
+                finish(true);
+            } catch(const std::exception&) {
+                finish(false);
+            }
+        }, path));
+    }).run("subscribe");
+
+    // Lock is released right after it is acquired, contended by operations hitting the same key.
+    runner_t(total / 4, concurrency, [&](size_t id, done_t done) {
+        auto holder = std::make_shared<holder_t>();
+        holder->assign(unicorn.lock(reply_t{[=](bool ok) {
+            holder->release();
+            done(ok);
+        }}, key("lock", id)));
+    }).run("lock");
+
+    return 0;
+}
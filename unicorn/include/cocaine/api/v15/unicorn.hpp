@@ -1,5 +1,8 @@
 #pragma once
 
+#include "cocaine/unicorn/operation.hpp"
+#include "cocaine/unicorn/raw.hpp"
+
 #include <cocaine/api/unicorn.hpp>
 #include <cocaine/errors.hpp>
 
@@ -15,6 +18,20 @@ public:
     virtual
     unicorn_scope_ptr
     named_lock(callback::lock callback, const unicorn::path_t& path, const unicorn::value_t& value) = 0;
+
+    typedef std::function<void(std::future<unicorn::multi_result_t>)> multi_callback;
+
+    /// Atomically applies all operations, which must target the path itself or nodes beneath it.
+    virtual
+    unicorn_scope_ptr
+    multi(multi_callback callback, const unicorn::path_t& path, const std::vector<unicorn::operation_t>& operations) = 0;
+
+    typedef std::function<void(std::future<unicorn::versioned_raw_value_t>)> get_raw_callback;
+
+    /// Same as get, but passes the value as stored in the backend, for clients which only forward it.
+    virtual
+    unicorn_scope_ptr
+    get_raw(get_raw_callback callback, const unicorn::path_t& path) = 0;
 };
 
 typedef std::shared_ptr<unicorn_t> unicorn_ptr;
@@ -22,7 +22,9 @@
 
 #include <boost/optional/optional.hpp>
 
+#include <map>
 #include <set>
+#include <vector>
 
 namespace cocaine { namespace cluster {
 
@@ -37,6 +39,10 @@ public:
 
         unicorn::path_t path;
         size_t retry_interval;
+
+        // Number of node endpoints fetched in parallel in batched discovery mode,
+        // zero means a separate subscription per node.
+        size_t batch_size;
     };
 
     class timer_t {
@@ -84,19 +90,46 @@ public:
 
         using subscriptions_t = std::map<std::string, locator_subscription_t>;
 
+        using endpoints_t = std::vector<asio::ip::tcp::endpoint>;
+
+        // Batched discovery reads endpoints of nodes in batches of bounded size instead of a watch per node.
+        // Only nodes new to the children list are fetched, a node which re-announces itself leaves the list and
+        // comes back as a new one. Fetch result is none on a transient failure, which never unlinks a node, and
+        // empty endpoints when the node is definitely gone or has no endpoints.
+        struct discovery_t {
+            std::set<std::string> nodes;
+            std::map<std::string, endpoints_t> linked;
+            std::set<std::string> pending;
+            std::set<std::string> failed;
+            std::set<std::string> fetching;
+            std::vector<std::pair<std::string, boost::optional<endpoints_t>>> results;
+            // Requests in flight, released as soon as they complete.
+            std::map<std::string, api::unicorn_scope_ptr> scopes;
+        };
+
         synchronized<subscriptions_t> subscriptions;
+        synchronized<discovery_t> discovery;
         unicorn_cluster_t& parent;
         timer_t timer;
+        timer_t retry_timer;
         api::auto_scope_t children_scope;
 
     public:
         subscriber_t(unicorn_cluster_t& parent);
+        ~subscriber_t();
+
         auto subscribe() -> void;
 
     private:
         auto on_children(std::future<response::children_subscribe> future) -> void;
         auto on_node(std::string uuid, std::future<response::subscribe> future) -> void;
         auto update_state(std::vector<std::string> nodes) -> void;
+
+        auto update_batched(std::vector<std::string> nodes) -> void;
+        auto fetch_batch() -> void;
+        auto on_fetched(std::string uuid, std::future<unicorn::versioned_value_t> future) -> void;
+        auto apply_batch(std::vector<std::pair<std::string, boost::optional<endpoints_t>>> results) -> void;
+        auto retry_failed() -> void;
     };
 
 
@@ -17,6 +17,9 @@
 
 #include <cocaine/rpc/protocol.hpp>
 
+#include "cocaine/unicorn/operation.hpp"
+#include "cocaine/unicorn/raw.hpp"
+
 #include <cocaine/unicorn/path.hpp>
 #include <cocaine/unicorn/value.hpp>
 
@@ -124,6 +127,30 @@ struct unicorn {
         typedef unicorn_final_tag dispatch_type;
     };
 
+    struct get_raw {
+        typedef unicorn_tag tag;
+
+        static const char* alias() {
+            return "get_raw";
+        }
+
+        /**
+        * Same as get, but the value is relayed as stored in ZK, without decoding it on the service side.
+        */
+        typedef boost::mpl::list<
+            cocaine::unicorn::path_t
+        > argument_type;
+
+        /**
+        * current version in ZK, the reply is wire-compatible with get
+        */
+        typedef option_of<
+            cocaine::unicorn::versioned_raw_value_t
+        >::tag upstream_type;
+
+        typedef unicorn_final_tag dispatch_type;
+    };
+
     struct subscribe {
         typedef unicorn_tag tag;
 
@@ -272,6 +299,36 @@ struct unicorn {
         >::tag upstream_type;
     };
 
+    struct multi {
+        typedef unicorn_tag tag;
+
+        static const char* alias() {
+            return "multi";
+        }
+
+        /**
+        * Atomically commit a list of operations in a single round trip. Either all of them succeed or none is applied.
+        *
+        * path_t - common path, all operations must target it or nodes beneath it. Used for authorization.
+        * operations - list of [type, path, value, version, ephemeral, sequence], where type is one of
+        *              0 - check, 1 - create, 2 - put, 3 - remove. Trailing fields may be omitted.
+        **/
+        typedef boost::mpl::list<
+            cocaine::unicorn::path_t,
+            std::vector<cocaine::unicorn::operation_t>
+        > argument_type;
+
+        /**
+        * Resulting path and version of each node in order of operations.
+        */
+        typedef option_of<
+            std::vector<cocaine::unicorn::path_t>,
+            std::vector<cocaine::unicorn::version_t>
+        >::tag upstream_type;
+
+        typedef unicorn_final_tag dispatch_type;
+    };
+
     struct close {
         typedef unicorn_final_tag tag;
         static const char* alias() {
@@ -299,7 +356,9 @@ struct protocol<unicorn_tag> {
         unicorn::remove,
         unicorn::increment,
         unicorn::lock,
-        unicorn::named_lock
+        unicorn::named_lock,
+        unicorn::multi,
+        unicorn::get_raw
     > messages;
 
     typedef unicorn scope;
@@ -16,6 +16,8 @@
 #pragma once
 
 #include "cocaine/traits/dynamic.hpp"
+#include "cocaine/unicorn/operation.hpp"
+#include "cocaine/unicorn/raw.hpp"
 #include "cocaine/unicorn/value.hpp"
 
 #include <cocaine/traits.hpp>
@@ -47,4 +49,76 @@ unpack(const msgpack::object& source, cocaine::unicorn::versioned_value_t& targe
 }
 };
 
+/// Raw value is repacked straight from msgpack representation, without building cocaine::dynamic_t.
+template<>
+struct type_traits<cocaine::unicorn::raw_value_t> {
+template<class Stream>
+static inline
+void
+pack(msgpack::packer<Stream>& packer, const cocaine::unicorn::raw_value_t& source) {
+    source.visit([&](const msgpack::object& object) {
+        packer << object;
+    });
+}
+};
+
+template<>
+struct type_traits<cocaine::unicorn::versioned_raw_value_t> {
+template<class Stream>
+static inline
+void
+pack(msgpack::packer<Stream>& packer, const cocaine::unicorn::versioned_raw_value_t& source) {
+    packer.pack_array(2);
+    cocaine::io::type_traits<cocaine::unicorn::raw_value_t>::pack(packer, source.value);
+    cocaine::io::type_traits<cocaine::unicorn::version_t>::pack(packer, source.version);
+}
+};
+
+/// Operation is packed as [type, path, value, version, ephemeral, sequence], trailing fields may be omitted.
+template<>
+struct type_traits<cocaine::unicorn::operation_t> {
+template<class Stream>
+static inline
+void
+pack(msgpack::packer<Stream>& packer, const cocaine::unicorn::operation_t& source) {
+    packer.pack_array(6);
+    cocaine::io::type_traits<int>::pack(packer, static_cast<int>(source.type));
+    cocaine::io::type_traits<cocaine::unicorn::path_t>::pack(packer, source.path);
+    cocaine::io::type_traits<cocaine::unicorn::value_t>::pack(packer, source.value);
+    cocaine::io::type_traits<cocaine::unicorn::version_t>::pack(packer, source.version);
+    cocaine::io::type_traits<bool>::pack(packer, source.ephemeral);
+    cocaine::io::type_traits<bool>::pack(packer, source.sequence);
+}
+
+static inline
+void
+unpack(const msgpack::object& source, cocaine::unicorn::operation_t& target) {
+    if(source.type != msgpack::type::ARRAY || source.via.array.size < 2 || source.via.array.size > 6) {
+        throw msgpack::type_error();
+    }
+    const auto& fields = source.via.array;
+    cocaine::unicorn::operation_t result;
+    int type;
+    type_traits<int>::unpack(fields.ptr[0], type);
+    if(type < cocaine::unicorn::operation_t::check || type > cocaine::unicorn::operation_t::del) {
+        throw msgpack::type_error();
+    }
+    result.type = static_cast<cocaine::unicorn::operation_t::type_t>(type);
+    type_traits<cocaine::unicorn::path_t>::unpack(fields.ptr[1], result.path);
+    if(fields.size > 2) {
+        type_traits<cocaine::unicorn::value_t>::unpack(fields.ptr[2], result.value);
+    }
+    if(fields.size > 3) {
+        type_traits<cocaine::unicorn::version_t>::unpack(fields.ptr[3], result.version);
+    }
+    if(fields.size > 4) {
+        type_traits<bool>::unpack(fields.ptr[4], result.ephemeral);
+    }
+    if(fields.size > 5) {
+        type_traits<bool>::unpack(fields.ptr[5], result.sequence);
+    }
+    target = std::move(result);
+}
+};
+
 }} // namespace cocaine::io
@@ -0,0 +1,59 @@
+/*
+* 2015+ Copyright (c) Anton Matveenko <antmat@yandex-team.ru>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*/
+
+#pragma once
+
+#include <cocaine/unicorn/path.hpp>
+#include <cocaine/unicorn/value.hpp>
+
+#include <tuple>
+#include <vector>
+
+namespace cocaine {
+namespace unicorn {
+
+/// Single operation of an atomic multi-operation transaction.
+struct operation_t {
+    enum type_t: int {
+        /// Fails the transaction unless the node has the specified version.
+        check = 0,
+        /// Creates the node, parent nodes are not created implicitly.
+        create = 1,
+        /// Writes the value if the node has the specified version.
+        put = 2,
+        /// Removes the node if it has the specified version, -1 matches any version.
+        del = 3
+    };
+
+    operation_t() :
+        type(check),
+        version(-1),
+        ephemeral(false),
+        sequence(false)
+    {}
+
+    type_t type;
+    path_t path;
+    value_t value;
+    version_t version;
+    bool ephemeral;
+    bool sequence;
+};
+
+/// Resulting path (differs from the requested one for sequence nodes) and version of each node of the transaction.
+typedef std::tuple<std::vector<path_t>, std::vector<version_t>> multi_result_t;
+
+} // namespace unicorn
+} // namespace cocaine
@@ -0,0 +1,60 @@
+/*
+* 2015+ Copyright (c) Anton Matveenko <antmat@yandex-team.ru>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*/
+
+#pragma once
+
+#include <cocaine/unicorn/value.hpp>
+
+#include <msgpack.hpp>
+
+#include <functional>
+#include <string>
+
+namespace cocaine {
+namespace unicorn {
+
+/// Msgpacked value as stored in the backend, for clients which forward values without inspecting them.
+/// Empty raw value stands for a missing node and is visited as nil.
+class raw_value_t {
+public:
+    raw_value_t() = default;
+
+    explicit
+    raw_value_t(std::string data);
+
+    auto data() const -> const std::string&;
+
+    auto decode() const -> value_t;
+
+    /// Decodes the value into a pooled zone, cocaine::dynamic_t is never built.
+    auto visit(const std::function<void(const msgpack::object&)>& visitor) const -> void;
+
+private:
+    std::string bytes;
+};
+
+/// Raw value with its version, packed on the wire exactly as versioned_value_t.
+struct versioned_raw_value_t {
+    versioned_raw_value_t(raw_value_t value, version_t version) :
+        value(std::move(value)),
+        version(version)
+    {}
+
+    raw_value_t value;
+    version_t version;
+};
+
+} // namespace unicorn
+} // namespace cocaine
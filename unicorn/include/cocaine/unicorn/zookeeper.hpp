@@ -30,17 +30,40 @@ class zookeeper_t : public api::v15::unicorn_t {
     const std::string name;
     const std::unique_ptr<logging::logger_t> log;
     zookeeper::session_t zk_session;
-    zookeeper::connection_t zk;
+    // Either real zookeeper connection or in-memory one, selected via "memory" section of args.
+    const std::unique_ptr<zookeeper::connection_t> connection;
+    zookeeper::connection_t& zk;
+
+    class cache_t;
+    class cache_fetch_t;
+    // Optional watch-backed read cache, enabled via "cache" section of args.
+    std::shared_ptr<cache_t> cache;
+
+    class value_feed_t;
+    class children_feed_t;
+    class feeds_t;
+    // Subscriptions on the same path share a single watch, disabled via "subscription_fan_in": false in args.
+    std::shared_ptr<feeds_t> feeds;
+
+    class shard_sum_t;
+    class sharded_increment_t;
+    template<class T>
+    class sharded_rejection_t;
+    class counters_t;
+    // Sharded counters and write combining for increment, enabled via "counters" section of args.
+    std::shared_ptr<counters_t> counters;
 
 public:
     class put_t;
     class get_t;
+    class get_raw_t;
     class create_t;
     class del_t;
     class subscribe_t;
     class children_subscribe_t;
     class increment_t;
     class lock_t;
+    class multi_t;
 
     using callback = api::unicorn_t::callback;
     using scope_ptr = api::unicorn_scope_ptr;
@@ -53,6 +76,8 @@ public:
 
     auto get(callback::get callback, const path_t& path) -> scope_ptr override;
 
+    auto get_raw(get_raw_callback callback, const path_t& path) -> scope_ptr override;
+
     auto create(callback::create callback, const path_t& path, const value_t& value, bool ephemeral, bool sequence)
             -> scope_ptr override;
 
@@ -68,9 +93,19 @@ public:
 
     auto named_lock(callback::lock callback, const path_t& path, const value_t& value) -> scope_ptr override;
 
+    auto multi(multi_callback callback, const path_t& path, const std::vector<operation_t>& operations)
+        -> scope_ptr override;
+
 private:
     template<class Action, class Callback, class... Args>
     auto run_command(Callback callback, Args&& ...args) -> scope_ptr;
+
+    template<class Feed, class Callback>
+    auto run_feed(std::shared_ptr<typename Feed::registry_t> registry, Callback callback, const path_t& path)
+        -> scope_ptr;
+
+    // Drops cached value of the path before it is modified via this backend.
+    auto invalidate(const path_t& path) -> void;
 };
 
 }}
@@ -17,6 +17,8 @@
 
 #include <cocaine/api/unicorn.hpp>
 
+#include "cocaine/unicorn/raw.hpp"
+
 #include <zookeeper/zookeeper.h>
 
 #include <string>
@@ -48,8 +50,18 @@ auto get_node_name(const path_t& path) -> std::string;
 */
 auto serialize(const unicorn::value_t& val) -> std::string;
 
+/**
+* Same as above, but reuses memory of the target string.
+*/
+auto serialize(const unicorn::value_t& val, std::string& target) -> void;
+
 auto unserialize(const std::string& val) -> unicorn::value_t;
 
+/**
+* Checks that data is a valid msgpack value and wraps it without conversion.
+*/
+auto unserialize_raw(std::string val) -> unicorn::raw_value_t;
+
 auto map_zoo_error(int rc) -> std::error_code;
 
 auto event_to_string(int event) -> std::string;
@@ -92,6 +92,35 @@ struct children_reply_t {
     const stat_t& stat;
 };
 
+/// Single operation of a multi-operation transaction.
+struct multi_op_t {
+    enum type_t {
+        check,
+        create,
+        put,
+        del
+    };
+
+    type_t type;
+    path_t path;
+    std::string value;
+    version_t version;
+    bool ephemeral;
+    bool sequence;
+};
+
+struct multi_result_t {
+    int rc;
+    // Path of the created node, set only for successful create operations.
+    path_t created_path;
+    stat_t stat;
+};
+
+struct multi_reply_t {
+    int rc;
+    std::vector<multi_result_t> results;
+};
+
 template<class T>
 struct replier {
     virtual
@@ -116,35 +145,87 @@ template<class... Args>
 using replier_ptr = std::shared_ptr<replier<Args...>>;
 
 /**
-* Adapter class to zookeeper C api.
-* Add ability to pass std::unique_ptr of handler object instead of function callback and void*
+* Asynchronous zookeeper client interface.
+* Replies and watch events are delivered from a single thread in order of requests, as zookeeper C api does.
+* Watchers are one-shot and all of them are fired with session event on reconnect.
 */
 class connection_t {
 public:
-    using zhandle_ptr = std::shared_ptr<zhandle_t>;
-    using watchers_t = std::map<size_t, replier_ptr<watch_reply_t>>;
-
-    connection_t(const cfg_t& cfg, const session_t& session);
-    connection_t(const connection_t&) = delete;
-    connection_t& operator=(const connection_t&) = delete;
+    virtual
+    ~connection_t() {}
 
-    auto put(const path_t& path, const std::string& value, version_t version, replier_ptr<put_reply_t> handler) -> void;
+    virtual
+    auto put(const path_t& path, const std::string& value, version_t version, replier_ptr<put_reply_t> handler) -> void = 0;
 
     auto get(const path_t& path, replier_ptr<get_reply_t> handler) -> void;
-    auto get(const path_t& path, replier_ptr<get_reply_t> handler, replier_ptr<watch_reply_t> watcher) -> void;
 
-    auto create(const path_t& path, const std::string& value, bool ephemeral, bool sequence, replier_ptr<create_reply_t> handler) -> void;
+    virtual
+    auto get(const path_t& path, replier_ptr<get_reply_t> handler, replier_ptr<watch_reply_t> watcher) -> void = 0;
+
+    virtual
+    auto create(const path_t& path, const std::string& value, bool ephemeral, bool sequence,
+                replier_ptr<create_reply_t> handler) -> void = 0;
+
+    virtual
+    auto del(const path_t& path, version_t version, replier_ptr<del_reply_t> handler) -> void = 0;
 
-    auto del(const path_t& path, version_t version, replier_ptr<del_reply_t> handler) -> void;
     auto del(const path_t& path, replier_ptr<del_reply_t> handler) -> void;
 
     auto exists(const path_t& path, replier_ptr<exists_reply_t> handler) -> void;
-    auto exists(const path_t& path, replier_ptr<exists_reply_t> handler, replier_ptr<watch_reply_t> watcher) -> void;
+
+    virtual
+    auto exists(const path_t& path, replier_ptr<exists_reply_t> handler, replier_ptr<watch_reply_t> watcher) -> void = 0;
 
     auto childs(const path_t& path, replier_ptr<children_reply_t> handler) -> void;
-    auto childs(const path_t& path, replier_ptr<children_reply_t> handler, replier_ptr<watch_reply_t> watcher) -> void;
 
-    auto reconnect() -> void;
+    virtual
+    auto childs(const path_t& path, replier_ptr<children_reply_t> handler, replier_ptr<watch_reply_t> watcher) -> void = 0;
+
+    /// Commits all operations atomically in a single round trip - either all of them succeed or none is applied.
+    virtual
+    auto multi(std::vector<multi_op_t> ops, replier_ptr<multi_reply_t> handler) -> void = 0;
+
+    virtual
+    auto reconnect() -> void = 0;
+};
+
+/**
+* Adapter class to zookeeper C api.
+* Add ability to pass std::unique_ptr of handler object instead of function callback and void*
+*/
+class zoo_connection_t: public connection_t {
+public:
+    using zhandle_ptr = std::shared_ptr<zhandle_t>;
+    using watchers_t = std::map<size_t, replier_ptr<watch_reply_t>>;
+
+    using connection_t::get;
+    using connection_t::del;
+    using connection_t::exists;
+    using connection_t::childs;
+
+    zoo_connection_t(const cfg_t& cfg, const session_t& session);
+    zoo_connection_t(const zoo_connection_t&) = delete;
+    zoo_connection_t& operator=(const zoo_connection_t&) = delete;
+
+    auto put(const path_t& path, const std::string& value, version_t version, replier_ptr<put_reply_t> handler)
+        -> void override;
+
+    auto get(const path_t& path, replier_ptr<get_reply_t> handler, replier_ptr<watch_reply_t> watcher) -> void override;
+
+    auto create(const path_t& path, const std::string& value, bool ephemeral, bool sequence,
+                replier_ptr<create_reply_t> handler) -> void override;
+
+    auto del(const path_t& path, version_t version, replier_ptr<del_reply_t> handler) -> void override;
+
+    auto exists(const path_t& path, replier_ptr<exists_reply_t> handler, replier_ptr<watch_reply_t> watcher)
+        -> void override;
+
+    auto childs(const path_t& path, replier_ptr<children_reply_t> handler, replier_ptr<watch_reply_t> watcher)
+        -> void override;
+
+    auto multi(std::vector<multi_op_t> ops, replier_ptr<multi_reply_t> handler) -> void override;
+
+    auto reconnect() -> void override;
 
 private:
     friend auto watch_cb(zhandle_t* zh, int type, int state, const char* path, void* watch_data) -> void;
@@ -0,0 +1,143 @@
+/*
+* 2015+ Copyright (c) Anton Matveenko <antmat@yandex-team.ru>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*/
+
+#pragma once
+
+#include "cocaine/zookeeper/connection.hpp"
+
+#include <cocaine/executor/asio.hpp>
+#include <cocaine/locked_ptr.hpp>
+
+#include <asio/deadline_timer.hpp>
+
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace cocaine {
+namespace zookeeper {
+
+/**
+* In-process zookeeper stand-in implementing the same reply and watch contract as the real connection.
+* Every request is applied immediately and its reply is delivered from a dedicated thread after the configured
+* latency, in order of requests. Intended for benchmarks and tests of the code built on top of connection_t.
+*/
+class memory_connection_t: public connection_t {
+public:
+    using connection_t::get;
+    using connection_t::del;
+    using connection_t::exists;
+    using connection_t::childs;
+
+    explicit
+    memory_connection_t(std::chrono::microseconds latency);
+
+    ~memory_connection_t();
+
+    auto put(const path_t& path, const std::string& value, version_t version, replier_ptr<put_reply_t> handler)
+        -> void override;
+
+    auto get(const path_t& path, replier_ptr<get_reply_t> handler, replier_ptr<watch_reply_t> watcher) -> void override;
+
+    auto create(const path_t& path, const std::string& value, bool ephemeral, bool sequence,
+                replier_ptr<create_reply_t> handler) -> void override;
+
+    auto del(const path_t& path, version_t version, replier_ptr<del_reply_t> handler) -> void override;
+
+    auto exists(const path_t& path, replier_ptr<exists_reply_t> handler, replier_ptr<watch_reply_t> watcher)
+        -> void override;
+
+    auto childs(const path_t& path, replier_ptr<children_reply_t> handler, replier_ptr<watch_reply_t> watcher)
+        -> void override;
+
+    auto multi(std::vector<multi_op_t> ops, replier_ptr<multi_reply_t> handler) -> void override;
+
+    /// Drops all watches firing them with session expiration event, as the real connection does.
+    auto reconnect() -> void override;
+
+private:
+    using clock_t = std::chrono::steady_clock;
+    using watchers_t = std::vector<replier_ptr<watch_reply_t>>;
+
+    struct node_t {
+        std::string data;
+        stat_t stat;
+        std::set<std::string> children;
+    };
+
+    struct tree_t {
+        std::map<path_t, node_t> nodes;
+        std::map<path_t, watchers_t> data_watchers;
+        std::map<path_t, watchers_t> child_watchers;
+        int64_t zxid;
+    };
+
+    struct event_t {
+        path_t path;
+        int type;
+        // Whether child watchers of the path are fired instead of data ones.
+        bool child;
+    };
+
+    struct task_t {
+        clock_t::time_point deadline;
+        std::function<void()> work;
+    };
+
+    static
+    auto parent_of(const path_t& path) -> path_t;
+
+    static
+    auto validate(const path_t& path) -> bool;
+
+    // Tree mutations, return zookeeper error code and record fired watch events.
+    auto apply_create(tree_t& tree, const path_t& path, const std::string& value, bool ephemeral, bool sequence,
+                      path_t& created, std::vector<event_t>& events) -> int;
+
+    auto apply_put(tree_t& tree, const path_t& path, const std::string& value, version_t version, stat_t& stat,
+                   std::vector<event_t>& events) -> int;
+
+    auto apply_del(tree_t& tree, const path_t& path, version_t version, std::vector<event_t>& events) -> int;
+
+    auto apply_check(const tree_t& tree, const path_t& path, version_t version) -> int;
+
+    // Dispatches one-shot watchers triggered by events, they are delivered before the reply of the request.
+    auto trigger(tree_t& tree, const std::vector<event_t>& events) -> void;
+
+    auto deliver(std::function<void()> work) -> void;
+
+    auto drain() -> void;
+
+    const clock_t::duration latency;
+
+    synchronized<tree_t> tree;
+
+    // Pending deliveries, accessed only from the executor thread.
+    std::deque<task_t> queue;
+
+    // Set from the executor thread on destruction, deliveries posted afterwards are dropped without touching the
+    // queue or the timer. Declared before the executor, so it outlives the executor thread.
+    bool stopping;
+
+    executor::owning_asio_t executor;
+    asio::deadline_timer timer;
+};
+
+} // namespace zookeeper
+} // namespace cocaine
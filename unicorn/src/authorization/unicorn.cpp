@@ -24,6 +24,10 @@
 #include <cocaine/traits/tuple.hpp>
 #include <cocaine/unicorn/value.hpp>
 
+#include <metrics/registry.hpp>
+
+#include <algorithm>
+
 #include "cocaine/idl/unicorn.hpp"
 
 namespace cocaine {
@@ -126,8 +130,10 @@ struct operation_t {
         case io::event_traits<io::unicorn::del>::id:
         case io::event_traits<io::unicorn::increment>::id:
         case io::event_traits<io::unicorn::lock>::id:
+        case io::event_traits<io::unicorn::multi>::id:
             return {flags_t::both};
         case io::event_traits<io::unicorn::get>::id:
+        case io::event_traits<io::unicorn::get_raw>::id:
         case io::event_traits<io::unicorn::subscribe>::id:
         case io::event_traits<io::unicorn::children_subscribe>::id:
             return {flags_t::read};
@@ -176,15 +182,51 @@ extract_permissions(const S& subjects, P& perms) -> std::size_t {
     );
 }
 
+/// The same as `extract_permissions`, but over sorted permission array of a compiled ACL.
+template<typename S, typename K>
+auto
+acl_permissions(const S& subjects, const std::vector<std::pair<K, flags_t>>& perms) -> std::size_t {
+    if (subjects.empty()) {
+        return flags_t::none;
+    }
+
+    std::size_t result = flags_t::both;
+    for (const auto& id : subjects) {
+        auto it = std::lower_bound(perms.begin(), perms.end(), id, [](const std::pair<K, flags_t>& perm, const K& id) {
+            return perm.first < id;
+        });
+        result &= (it != perms.end() && it->first == id) ? it->second : flags_t::none;
+    }
+    return result;
+}
+
 } // namespace
 
+acl_t::acl_t(const metainfo_t& metainfo) :
+    c_perms(metainfo.c_perms.begin(), metainfo.c_perms.end()),
+    u_perms(metainfo.u_perms.begin(), metainfo.u_perms.end())
+{}
+
 enabled_t::enabled_t(context_t& context, const std::string& service, const dynamic_t& args) :
     log(context.log(cocaine::format("authorization/{}/unicorn", service))),
     backend(api::unicorn(context, args.as_object().at("backend", "core").as_string())),
     executor(std::make_unique<executor::owning_asio_t>()),
-    counter(0)
+    counter(0),
+    cache_size(args.as_object().at("cache_size", 1024u).as_uint()),
+    hits(context.metrics_hub().counter<std::uint64_t>(cocaine::format("authorization.{}.unicorn.cache.hits", service))),
+    misses(context.metrics_hub().counter<std::uint64_t>(cocaine::format("authorization.{}.unicorn.cache.misses", service)))
 {}
 
+enabled_t::~enabled_t() {
+    cache.apply([&](std::map<std::string, cached_t>& cache_) {
+        for (auto& item : cache_) {
+            if (item.second.scope) {
+                item.second.scope->close();
+            }
+        }
+    });
+}
+
 auto
 enabled_t::verify(std::size_t event, const std::string& path, const auth::identity_t& identity, callback_type callback)
     -> void
@@ -205,6 +247,21 @@ enabled_t::verify(std::size_t event, const std::string& path, const auth::identi
 
     auto cids = identity.cids();
     auto uids = identity.uids();
+
+    // Most checks are answered locally from the cached ACL, only ACL initialization requires a round trip.
+    if (auto acl = cached(*prefix)) {
+        const auto op = operation_t::from(event);
+        if (!acl->empty()) {
+            auto c_perm = acl_permissions(cids, acl->c_perms);
+            auto u_perm = acl_permissions(uids, acl->u_perms);
+            auto allowed = ((c_perm | u_perm) & op.flag) == op.flag;
+            callback(allowed ? std::error_code() : std::make_error_code(std::errc::permission_denied));
+            return;
+        } else if (!op.is_modify() || (cids.empty() && uids.empty())) {
+            callback({});
+            return;
+        }
+    }
     auto log_ = std::make_shared<blackhole::wrapper_t>(*log, blackhole::attributes_t{
         {"id", id},
         {"path", path},
@@ -303,6 +360,103 @@ enabled_t::make_path(const std::string& prefix) const -> std::string {
     return cocaine::format("{}/{}", prefix_acls, prefix);
 }
 
+auto
+enabled_t::cached(const std::string& prefix) -> std::shared_ptr<const acl_t> {
+    if (cache_size == 0) {
+        return nullptr;
+    }
+
+    bool subscribe = false;
+    auto acl = cache.apply([&](std::map<std::string, cached_t>& cache_) -> std::shared_ptr<const acl_t> {
+        auto it = cache_.find(prefix);
+        if (it != cache_.end()) {
+            return it->second.acl;
+        }
+        if (cache_.size() < cache_size) {
+            cache_.insert({prefix, cached_t()});
+            subscribe = true;
+        }
+        return nullptr;
+    });
+
+    if (acl) {
+        hits->operator++();
+        return acl;
+    }
+
+    misses->operator++();
+    if (!subscribe) {
+        return nullptr;
+    }
+
+    std::shared_ptr<api::unicorn_scope_t> scope;
+    try {
+        scope = backend->subscribe([=](std::future<versioned_value_t> future) {
+            on_acl_update(prefix, std::move(future));
+        }, make_path(prefix));
+    } catch (const std::system_error& err) {
+        COCAINE_LOG_WARNING(log, "failed to subscribe for ACL of '{}' prefix: {}", prefix, error::to_string(err));
+    }
+
+    // The subscription may have already failed and dropped the entry.
+    auto attached = cache.apply([&](std::map<std::string, cached_t>& cache_) {
+        auto it = cache_.find(prefix);
+        if (it == cache_.end() || it->second.scope || !scope) {
+            if (it != cache_.end() && !it->second.scope) {
+                cache_.erase(it);
+            }
+            return false;
+        }
+        it->second.scope = scope;
+        return true;
+    });
+
+    if (!attached && scope) {
+        scope->close();
+    }
+
+    return nullptr;
+}
+
+auto
+enabled_t::on_acl_update(const std::string& prefix, std::future<versioned_value_t> future) -> void {
+    try {
+        auto value = future.get();
+
+        metainfo_t metainfo;
+        if (value.exists()) {
+            if (!value.value().convertible_to<metainfo_t>()) {
+                throw std::system_error(make_error_code(error::invalid_acl_framing));
+            }
+
+            metainfo = value.value().to<metainfo_t>();
+        }
+
+        auto acl = std::make_shared<const acl_t>(metainfo);
+        cache.apply([&](std::map<std::string, cached_t>& cache_) {
+            auto it = cache_.find(prefix);
+            if (it != cache_.end()) {
+                it->second.acl = std::move(acl);
+            }
+        });
+    } catch (const std::system_error& err) {
+        COCAINE_LOG_DEBUG(log, "dropping cached ACL of '{}' prefix: {}", prefix, error::to_string(err));
+
+        std::shared_ptr<api::unicorn_scope_t> scope;
+        cache.apply([&](std::map<std::string, cached_t>& cache_) {
+            auto it = cache_.find(prefix);
+            if (it != cache_.end()) {
+                scope = std::move(it->second.scope);
+                cache_.erase(it);
+            }
+        });
+
+        if (scope) {
+            scope->close();
+        }
+    }
+}
+
 auto
 enabled_t::upload_permissions(const std::string& prefix, metainfo_t metainfo, const versioned_value_t& value, callback_type callback)
     -> std::shared_ptr<api::unicorn_scope_t>
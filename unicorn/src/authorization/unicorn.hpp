@@ -2,6 +2,7 @@
 
 #include <atomic>
 #include <map>
+#include <vector>
 
 #include <cocaine/api/executor.hpp>
 #include <cocaine/forwards.hpp>
@@ -9,6 +10,8 @@
 
 #include <blackhole/logger.hpp>
 
+#include <metrics/metric.hpp>
+
 namespace cocaine {
 namespace authorization {
 namespace unicorn {
@@ -36,7 +39,27 @@ struct metainfo_t {
     }
 };
 
+/// Metainfo compiled into flat sorted arrays for lookups without allocations.
+struct acl_t {
+    std::vector<std::pair<auth::cid_t, flags_t>> c_perms;
+    std::vector<std::pair<auth::uid_t, flags_t>> u_perms;
+
+    explicit
+    acl_t(const metainfo_t& metainfo);
+
+    auto
+    empty() const -> bool {
+        return c_perms.empty() && u_perms.empty();
+    }
+};
+
 class enabled_t : public api::authorization::unicorn_t {
+    /// ACL of a single prefix kept up to date via subscription, empty acl means the first value is not received yet.
+    struct cached_t {
+        std::shared_ptr<const acl_t> acl;
+        std::shared_ptr<api::unicorn_scope_t> scope;
+    };
+
     std::unique_ptr<logging::logger_t> log;
     std::shared_ptr<api::unicorn_t> backend;
     std::unique_ptr<api::executor_t> executor;
@@ -44,9 +67,18 @@ class enabled_t : public api::authorization::unicorn_t {
     std::atomic<std::uint64_t> counter;
     synchronized<std::multimap<std::uint64_t, std::shared_ptr<api::unicorn_scope_t>>> scopes;
 
+    // Maximum number of cached prefixes, zero disables caching.
+    const std::size_t cache_size;
+    synchronized<std::map<std::string, cached_t>> cache;
+
+    metrics::shared_metric<std::atomic<std::uint64_t>> hits;
+    metrics::shared_metric<std::atomic<std::uint64_t>> misses;
+
 public:
     enabled_t(context_t& context, const std::string& service, const dynamic_t& args);
 
+    ~enabled_t();
+
     auto
     verify(std::size_t event, const std::string& path, const auth::identity_t& identity, callback_type callback)
         -> void override;
@@ -55,6 +87,13 @@ private:
     auto
     make_path(const std::string& prefix) const -> std::string;
 
+    /// Returns cached ACL of the prefix, starting a subscription for it on a miss.
+    auto
+    cached(const std::string& prefix) -> std::shared_ptr<const acl_t>;
+
+    auto
+    on_acl_update(const std::string& prefix, std::future<versioned_value_t> future) -> void;
+
     auto
     upload_permissions(const std::string& prefix, metainfo_t metainfo, const versioned_value_t& value, callback_type callback)
         -> std::shared_ptr<api::unicorn_scope_t>;
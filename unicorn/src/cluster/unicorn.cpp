@@ -32,6 +32,8 @@
 
 #include <boost/optional/optional.hpp>
 
+#include <future>
+
 #include <zookeeper/zookeeper.h>
 
 namespace cocaine { namespace cluster {
@@ -42,7 +44,8 @@ typedef api::unicorn_t::response response;
 
 unicorn_cluster_t::cfg_t::cfg_t(const dynamic_t& args) :
         path(args.as_object().at("path", "/cocaine/discovery").as_string()),
-        retry_interval(args.as_object().at("retry_interval", 10u).as_uint())
+        retry_interval(args.as_object().at("retry_interval", 10u).as_uint()),
+        batch_size(args.as_object().at("batch_size", 0u).as_uint())
 {}
 
 unicorn_cluster_t::timer_t::timer_t(unicorn_cluster_t& parent, std::function<void()> callback) :
@@ -143,9 +146,19 @@ auto unicorn_cluster_t::announcer_t::on_check(std::future<response::subscribe> f
 
 unicorn_cluster_t::subscriber_t::subscriber_t(unicorn_cluster_t& parent) :
         parent(parent),
-        timer(parent, [=](){subscribe();})
+        timer(parent, [=](){subscribe();}),
+        retry_timer(parent, [=](){retry_failed();})
 {}
 
+unicorn_cluster_t::subscriber_t::~subscriber_t() {
+    auto scopes = discovery.apply([&](discovery_t& discovery) {
+        return std::move(discovery.scopes);
+    });
+    for(const auto& scope: scopes) {
+        scope.second->close();
+    }
+}
+
 auto unicorn_cluster_t::subscriber_t::subscribe() -> void {
     auto cb = std::bind(&unicorn_cluster_t::subscriber_t::on_children, this, ph::_1);
     const auto& path = parent.config.path;
@@ -155,7 +168,12 @@ auto unicorn_cluster_t::subscriber_t::subscribe() -> void {
 
 auto unicorn_cluster_t::subscriber_t::on_children(std::future<response::children_subscribe> future) -> void {
     try {
-        update_state(std::get<1>(future.get()));
+        auto nodes = std::get<1>(future.get());
+        if(parent.config.batch_size) {
+            update_batched(std::move(nodes));
+        } else {
+            update_state(std::move(nodes));
+        }
     } catch (const std::system_error& e) {
         COCAINE_LOG_WARNING(parent.log, "failure during subscription: {}, resubscribing", error::to_string(e));
         timer.defer_retry();
@@ -226,6 +244,196 @@ auto unicorn_cluster_t::subscriber_t::on_node(std::string uuid, std::future<resp
     });
 }
 
+auto unicorn_cluster_t::subscriber_t::update_batched(std::vector<std::string> nodes) -> void {
+    COCAINE_LOG_INFO(parent.log, "received uuid list from zookeeper, got {} uuids", nodes.size());
+    std::vector<std::string> dropped;
+    discovery.apply([&](discovery_t& discovery) {
+        discovery.nodes = std::set<std::string>(nodes.begin(), nodes.end());
+        discovery.nodes.erase(parent.locator.uuid());
+
+        for(auto it = discovery.linked.begin(); it != discovery.linked.end();) {
+            if(!discovery.nodes.count(it->first)) {
+                dropped.push_back(it->first);
+                it = discovery.linked.erase(it);
+            } else {
+                it++;
+            }
+        }
+
+        auto forget = [&](std::set<std::string>& uuids) {
+            for(auto it = uuids.begin(); it != uuids.end();) {
+                if(!discovery.nodes.count(*it)) {
+                    it = uuids.erase(it);
+                } else {
+                    it++;
+                }
+            }
+        };
+        forget(discovery.pending);
+        forget(discovery.failed);
+
+        // Linked nodes are not read again, so churn of the list costs reads of new nodes only.
+        for(const auto& node: discovery.nodes) {
+            if(discovery.linked.count(node) || discovery.fetching.count(node) || discovery.failed.count(node)) {
+                continue;
+            }
+            discovery.pending.insert(node);
+        }
+        COCAINE_LOG_INFO(parent.log, "discovery state: {} linked, {} pending, {} fetching, {} failed",
+                         discovery.linked.size(), discovery.pending.size(), discovery.fetching.size(),
+                         discovery.failed.size());
+    });
+
+    for(const auto& uuid: dropped) {
+        parent.locator.drop_node(uuid);
+    }
+    if(!dropped.empty()) {
+        COCAINE_LOG_INFO(parent.log, "dropped {} nodes", dropped.size());
+    }
+
+    fetch_batch();
+}
+
+auto unicorn_cluster_t::subscriber_t::fetch_batch() -> void {
+    std::vector<std::string> batch;
+    discovery.apply([&](discovery_t& discovery) {
+        // Only one batch is in flight at a time, the next one starts when it is applied.
+        if(!discovery.fetching.empty()) {
+            return;
+        }
+        while(!discovery.pending.empty() && batch.size() < parent.config.batch_size) {
+            auto uuid = *discovery.pending.begin();
+            discovery.pending.erase(discovery.pending.begin());
+            discovery.fetching.insert(uuid);
+            batch.push_back(std::move(uuid));
+        }
+    });
+
+    if(batch.empty()) {
+        return;
+    }
+
+    COCAINE_LOG_INFO(parent.log, "fetching endpoints of {} nodes", batch.size());
+    // Requests are issued out of the lock, as replies may be delivered synchronously.
+    for(const auto& uuid: batch) {
+        api::unicorn_scope_ptr scope;
+        try {
+            auto cb = std::bind(&unicorn_cluster_t::subscriber_t::on_fetched, this, uuid, ph::_1);
+            scope = parent.unicorn->get(std::move(cb), parent.config.path + '/' + uuid);
+        } catch(const std::system_error&) {
+            auto promise = std::promise<unicorn::versioned_value_t>();
+            promise.set_exception(std::current_exception());
+            on_fetched(uuid, promise.get_future());
+            continue;
+        }
+        discovery.apply([&](discovery_t& discovery) {
+            // The reply may have been delivered synchronously, there is nothing to keep then.
+            if(discovery.fetching.count(uuid)) {
+                discovery.scopes[uuid] = std::move(scope);
+            }
+        });
+    }
+}
+
+auto unicorn_cluster_t::subscriber_t::on_fetched(std::string uuid, std::future<unicorn::versioned_value_t> future) -> void {
+    // None is a transient failure, empty endpoints are a definite answer that the node is not reachable.
+    boost::optional<endpoints_t> endpoints;
+    try {
+        auto result = future.get();
+        endpoints = endpoints_t();
+        if(!result.exists()) {
+            COCAINE_LOG_WARNING(parent.log, "node {} was removed before its endpoints were fetched", uuid);
+        } else {
+            try {
+                endpoints = result.value().to<endpoints_t>();
+            } catch(const std::exception& e) {
+                COCAINE_LOG_WARNING(parent.log, "node {} has malformed endpoints - {}", uuid, e);
+            }
+            if(endpoints->empty()) {
+                COCAINE_LOG_WARNING(parent.log, "node {} has empty endpoints", uuid);
+            }
+        }
+    } catch(const std::exception& e) {
+        COCAINE_LOG_WARNING(parent.log, "failed to fetch endpoints of node {} - {}", uuid, e);
+        endpoints.reset();
+    }
+
+    std::vector<std::pair<std::string, boost::optional<endpoints_t>>> results;
+    discovery.apply([&](discovery_t& discovery) {
+        discovery.results.emplace_back(uuid, std::move(endpoints));
+        discovery.fetching.erase(uuid);
+        discovery.scopes.erase(uuid);
+        if(discovery.fetching.empty()) {
+            results.swap(discovery.results);
+        }
+    });
+
+    if(!results.empty()) {
+        apply_batch(std::move(results));
+        fetch_batch();
+    }
+}
+
+auto unicorn_cluster_t::subscriber_t::apply_batch(std::vector<std::pair<std::string, boost::optional<endpoints_t>>> results)
+    -> void
+{
+    std::vector<std::pair<std::string, endpoints_t>> linked;
+    std::vector<std::string> dropped;
+    size_t failed = 0;
+    discovery.apply([&](discovery_t& discovery) {
+        for(auto& result: results) {
+            // Node may have disappeared while the batch was in flight.
+            if(!discovery.nodes.count(result.first)) {
+                continue;
+            }
+            auto it = discovery.linked.find(result.first);
+            if(!result.second || result.second->empty()) {
+                // Only a definite answer unlinks a node, a transient failure keeps the existing link.
+                if(result.second && it != discovery.linked.end()) {
+                    discovery.linked.erase(it);
+                    dropped.push_back(result.first);
+                }
+                if(!discovery.linked.count(result.first)) {
+                    discovery.failed.insert(result.first);
+                    failed++;
+                }
+                continue;
+            }
+            if(it != discovery.linked.end()) {
+                if(it->second == *result.second) {
+                    continue;
+                }
+                // Node was re-announced with other endpoints, the stale link is replaced.
+                dropped.push_back(result.first);
+            }
+            discovery.linked[result.first] = *result.second;
+            linked.emplace_back(result.first, std::move(*result.second));
+        }
+    });
+
+    // The whole batch is applied to the locator in one pass instead of a link per reply.
+    for(const auto& uuid: dropped) {
+        parent.locator.drop_node(uuid);
+    }
+    for(const auto& node: linked) {
+        parent.locator.link_node(node.first, node.second);
+    }
+    COCAINE_LOG_INFO(parent.log, "applied discovery batch: {} linked, {} dropped, {} failed",
+                     linked.size(), dropped.size(), failed);
+
+    if(failed) {
+        retry_timer.defer_retry();
+    }
+}
+
+auto unicorn_cluster_t::subscriber_t::retry_failed() -> void {
+    discovery.apply([&](discovery_t& discovery) {
+        discovery.pending.insert(discovery.failed.begin(), discovery.failed.end());
+        discovery.failed.clear();
+    });
+    fetch_batch();
+}
+
 unicorn_cluster_t::unicorn_cluster_t(
     cocaine::context_t & _context,
     cocaine::api::cluster_t::interface & _locator,
@@ -18,6 +18,7 @@
 #include "cocaine/traits/dynamic.hpp"
 #include "cocaine/unicorn/value.hpp"
 #include "cocaine/zookeeper.hpp"
+#include "cocaine/zookeeper/memory.hpp"
 
 #include <cocaine/context.hpp>
 #include <cocaine/executor/asio.hpp>
@@ -27,13 +28,22 @@
 #include <cocaine/logging.hpp>
 #include <cocaine/utility/future.hpp>
 
+#include <asio/deadline_timer.hpp>
 #include <asio/io_service.hpp>
 
 #include <blackhole/logger.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <map>
 #include <memory>
 #include <blackhole/wrapper.hpp>
 
+#include <metrics/registry.hpp>
+
+#include <unordered_map>
+
 #include <zookeeper/zookeeper.h>
 
 using namespace cocaine::zookeeper;
@@ -59,6 +69,17 @@ cfg_t make_zk_config(const dynamic_t& args) {
     return cfg_t(endpoints, cfg.at("recv_timeout_ms", 1000u).as_uint(), cfg.at("prefix", "").as_string());
 }
 
+auto make_connection(const dynamic_t& args, const zookeeper::session_t& session)
+    -> std::unique_ptr<zookeeper::connection_t>
+{
+    auto memory = args.as_object().find("memory");
+    if(memory != args.as_object().end()) {
+        auto latency = std::chrono::microseconds(memory->second.as_object().at("latency_us", 0u).as_uint());
+        return std::unique_ptr<zookeeper::connection_t>(new zookeeper::memory_connection_t(latency));
+    }
+    return std::unique_ptr<zookeeper::connection_t>(new zookeeper::zoo_connection_t(make_zk_config(args), session));
+}
+
 auto throw_watch_event(const watch_reply_t& reply) -> void {
     throw error_t(error::connection_loss, "watch occured with \"{}\" type, \"{}\" state event on \"{}\" path",
                   event_to_string(reply.type), state_to_string(reply.state), reply.path);
@@ -233,6 +254,37 @@ private:
     }
 };
 
+/// Same as get_t, but the stored bytes are only validated and relayed as is.
+class zookeeper_t::get_raw_t: public safe<versioned_raw_value_t, get_reply_t> {
+    zookeeper_t& parent;
+    path_t path;
+public:
+    get_raw_t(get_raw_callback wrapped, zookeeper_t& parent, path_t path):
+        safe(std::move(wrapped)),
+        parent(parent),
+        path(std::move(path))
+    {}
+
+    auto run() -> void {
+        parent.zk.get(path, shared_from_this());
+    }
+
+private:
+    auto on_reply(get_reply_t reply) -> void override {
+        if (reply.rc != 0) {
+            if(reply.rc == ZNONODE) {
+                satisfy(versioned_raw_value_t({}, not_existing_version));
+            } else {
+                throw error_t(map_zoo_error(reply.rc), "failure during getting node value - {}", zerror(reply.rc));
+            }
+        } else if (reply.stat.numChildren != 0) {
+            throw error_t(cocaine::error::child_not_allowed, "trying to read value of the node with childs");
+        } else {
+            satisfy(versioned_raw_value_t(unserialize_raw(std::move(reply.data)), reply.stat.version));
+        }
+    }
+};
+
 class zookeeper_t::create_t: public safe<bool, create_reply_t> {
     zookeeper_t& parent;
     path_t path;
@@ -457,6 +509,437 @@ private:
     }
 };
 
+namespace {
+
+auto is_numeric(const value_t& value) -> bool {
+    return value.is_double() || value.is_int() || value.is_uint();
+}
+
+auto add_numeric(const value_t& lhs, const value_t& rhs) -> value_t {
+    if(lhs.is_double() || rhs.is_double()) {
+        return lhs.to<double>() + rhs.to<double>();
+    }
+    return lhs.to<int64_t>() + rhs.to<int64_t>();
+}
+
+auto subtract_numeric(const value_t& lhs, const value_t& rhs) -> value_t {
+    if(lhs.is_double() || rhs.is_double()) {
+        return lhs.to<double>() - rhs.to<double>();
+    }
+    return lhs.to<int64_t>() - rhs.to<int64_t>();
+}
+
+const std::string shard_prefix = "shard-";
+
+}
+
+/// Reads value of a sharded counter as a sum of its shards.
+/// Version is the sum of shard versions, it grows with every increment, but it is not a version of any node, so
+/// it can not be used for put or del.
+class zookeeper_t::shard_sum_t: public safe<versioned_value_t, children_reply_t, get_reply_t> {
+    zookeeper_t& parent;
+    path_t path;
+    value_t sum;
+    version_t version;
+    size_t pending;
+
+public:
+    shard_sum_t(callback::get wrapped, zookeeper_t& parent, path_t path) :
+        safe(std::move(wrapped)),
+        parent(parent),
+        path(std::move(path)),
+        sum(0),
+        version(0),
+        pending(0)
+    {}
+
+    auto run() -> void {
+        parent.zk.childs(path, shared_from_this());
+    }
+
+private:
+    auto on_reply(children_reply_t reply) -> void override {
+        if(reply.rc == ZNONODE) {
+            return satisfy(versioned_value_t({}, not_existing_version));
+        } else if(reply.rc) {
+            throw error_t(map_zoo_error(reply.rc), "failed to list counter shards - {}", zerror(reply.rc));
+        }
+        std::vector<path_t> shards;
+        for(const auto& child: reply.children) {
+            if(child.compare(0, shard_prefix.size(), shard_prefix) == 0) {
+                shards.push_back(path + "/" + child);
+            }
+        }
+        if(shards.empty()) {
+            return satisfy(versioned_value_t(sum, version));
+        }
+        // All completions are delivered from the single ZooKeeper thread, so pending needs no locking.
+        pending = shards.size();
+        for(const auto& shard: shards) {
+            parent.zk.get(shard, shared_from_this());
+        }
+    }
+
+    auto on_reply(get_reply_t reply) -> void override {
+        if(reply.rc && reply.rc != ZNONODE) {
+            throw error_t(map_zoo_error(reply.rc), "failed to read counter shard - {}", zerror(reply.rc));
+        }
+        if(!reply.rc) {
+            auto value = unserialize(reply.data);
+            if(!is_numeric(value)) {
+                throw error_t(error::invalid_type, "counter shard holds non-numeric value");
+            }
+            sum = add_numeric(sum, value);
+            version += reply.stat.version;
+        }
+        if(--pending == 0) {
+            satisfy(versioned_value_t(sum, version));
+        }
+    }
+};
+
+/// Increments one shard of a sharded counter, which makes concurrent writers rarely collide on the same node.
+/// Replies with the value and version of the written shard after the increment. Values are produced by the
+/// increment itself, but they are unique within a shard only, so sharded counters can not be used to generate
+/// unique ids. The total is read with get.
+class zookeeper_t::sharded_increment_t: public safe<versioned_value_t, get_reply_t, create_reply_t, put_reply_t> {
+    zookeeper_t& parent;
+    path_t path;
+    path_t shard;
+    value_t value;
+    value_t result;
+    bool creating_parent;
+    size_t attempts;
+
+public:
+    sharded_increment_t(callback::increment wrapped, zookeeper_t& parent, path_t path, size_t index, value_t value) :
+        safe(std::move(wrapped)),
+        parent(parent),
+        path(std::move(path)),
+        shard(format("{}/{}{}", this->path, shard_prefix, index)),
+        value(std::move(value)),
+        creating_parent(false),
+        attempts(0)
+    {}
+
+    auto run() -> void {
+        if(!is_numeric(value)) {
+            throw error_t(error::unicorn_errors::invalid_type, "invalid value type for increment");
+        }
+        retry();
+    }
+
+private:
+    static constexpr size_t max_attempts = 16;
+
+    auto retry() -> void {
+        if(++attempts > max_attempts) {
+            throw error_t(map_zoo_error(ZBADVERSION), "too many conflicts while incrementing counter shard");
+        }
+        parent.zk.get(shard, shared_from_this());
+    }
+
+    auto on_reply(get_reply_t reply) -> void override {
+        if(reply.rc == ZNONODE) {
+            result = value;
+            return parent.zk.create(shard, serialize(result), false, false, shared_from_this());
+        } else if(reply.rc) {
+            throw error_t(map_zoo_error(reply.rc), "failed to get counter shard value - {}", zerror(reply.rc));
+        }
+        auto parsed = unserialize(reply.data);
+        if(!is_numeric(parsed)) {
+            throw error_t(error::invalid_type, "can not increment non-numeric value");
+        }
+        result = add_numeric(parsed, value);
+        parent.zk.put(shard, serialize(result), reply.stat.version, shared_from_this());
+    }
+
+    auto on_reply(put_reply_t reply) -> void override {
+        if(reply.rc == ZBADVERSION) {
+            return retry();
+        } else if(reply.rc) {
+            throw error_t(map_zoo_error(reply.rc), "failed to put counter shard value - {}", zerror(reply.rc));
+        }
+        satisfy(versioned_value_t(result, reply.stat.version));
+    }
+
+    auto on_reply(create_reply_t reply) -> void override {
+        if(creating_parent) {
+            creating_parent = false;
+            if(reply.rc && reply.rc != ZNODEEXISTS) {
+                throw error_t(map_zoo_error(reply.rc), "could not create counter node - {}", zerror(reply.rc));
+            }
+            return retry();
+        }
+        if(reply.rc == ZNONODE) {
+            creating_parent = true;
+            return parent.zk.create(path, "", false, false, shared_from_this());
+        } else if(reply.rc == ZNODEEXISTS) {
+            return retry();
+        } else if(reply.rc) {
+            throw error_t(map_zoo_error(reply.rc), "could not create counter shard - {}", zerror(reply.rc));
+        }
+        satisfy(versioned_value_t(result, version_t(0)));
+    }
+};
+
+/// Fails operations which would target the parent node of a sharded counter, while its value is kept in shards.
+template<class T>
+class zookeeper_t::sharded_rejection_t: public safe<T> {
+    path_t path;
+
+public:
+    sharded_rejection_t(future_callback<T> wrapped, zookeeper_t& /*parent*/, path_t path) :
+        safe<T>(std::move(wrapped)),
+        path(std::move(path))
+    {}
+
+    auto run() -> void {
+        throw error_t(error::invalid_path, "only get and increment are supported for sharded counter {}", path);
+    }
+};
+
+constexpr size_t zookeeper_t::sharded_increment_t::max_attempts;
+
+/// Routes increments to sharded counters and coalesces increments of the same path issued within a short window
+/// into a single ZooKeeper write. Configured via "counters" section of args:
+///     "counters": {
+///         "sharded": ["/counters"],  # counters beneath these paths are spread over shards, summed on read;
+///                                    # increments return shard values, not unique across shards
+///         "shards": 8,               # number of shards per sharded counter
+///         "batch_window_ms": 5       # coalescing window, 0 disables write combining
+///     }
+class zookeeper_t::counters_t: public std::enable_shared_from_this<counters_t> {
+public:
+    counters_t(zookeeper_t& parent, const dynamic_t& args) :
+        parent(parent),
+        shards(std::max<std::uint64_t>(args.as_object().at("shards", 8u).as_uint(), 1)),
+        window(args.as_object().at("batch_window_ms", 0u).as_uint()),
+        next_shard(static_cast<size_t>(std::rand())),
+        commits(parent.context.metrics_hub().counter<std::uint64_t>(format("unicorn.{}.counters.commits", parent.name))),
+        combined(parent.context.metrics_hub().counter<std::uint64_t>(format("unicorn.{}.counters.combined", parent.name)))
+    {
+        for(const auto& prefix: args.as_object().at("sharded", dynamic_t::empty_array).as_array()) {
+            sharded_prefixes.push_back(prefix.as_string());
+        }
+    }
+
+    auto sharded(const path_t& path) const -> bool {
+        // Shards themselves are plain nodes.
+        auto pos = path.find_last_of('/');
+        if(pos != std::string::npos && path.compare(pos + 1, shard_prefix.size(), shard_prefix) == 0) {
+            return false;
+        }
+        for(const auto& prefix: sharded_prefixes) {
+            if(path.size() > prefix.size() && path.compare(0, prefix.size(), prefix) == 0 &&
+                    (prefix.back() == '/' || path[prefix.size()] == '/'))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    auto increment(callback::increment callback, const path_t& path, const value_t& value) -> scope_ptr {
+        if(window.count() == 0 || !is_numeric(value)) {
+            return commit(std::move(callback), path, value);
+        }
+        auto scope = std::make_shared<scope_t>();
+        batches.apply([&](batches_t& batches) {
+            auto it = batches.find(path);
+            if(it == batches.end()) {
+                it = batches.insert(std::make_pair(path, batch_t{value_t(0), {}})).first;
+                schedule(path);
+            } else {
+                combined->operator++();
+            }
+            it->second.total = add_numeric(it->second.total, value);
+            it->second.waiters.push_back(waiter_t{scope, value, std::move(callback)});
+        });
+        return scope;
+    }
+
+private:
+    struct waiter_t {
+        std::shared_ptr<scope_t> scope;
+        value_t delta;
+        callback::increment callback;
+    };
+
+    struct batch_t {
+        value_t total;
+        std::vector<waiter_t> waiters;
+    };
+
+    using batches_t = std::map<path_t, batch_t>;
+
+    auto commit(callback::increment callback, const path_t& path, const value_t& value) -> scope_ptr {
+        commits->operator++();
+        if(sharded(path)) {
+            return parent.run_command<sharded_increment_t>(std::move(callback), path, next_shard++ % shards, value);
+        }
+        return parent.run_command<increment_t>(std::move(callback), path, value);
+    }
+
+    auto schedule(const path_t& path) -> void {
+        std::weak_ptr<counters_t> weak_self(shared_from_this());
+        auto timer = std::make_shared<asio::deadline_timer>(executor.asio());
+        timer->expires_from_now(boost::posix_time::milliseconds(window.count()));
+        timer->async_wait([=](std::error_code) {
+            if(auto self = weak_self.lock()) {
+                self->flush(path);
+            }
+            timer.get();
+        });
+    }
+
+    auto flush(const path_t& path) -> void {
+        auto batch = batches.apply([&](batches_t& batches) {
+            batch_t batch{value_t(0), {}};
+            auto it = batches.find(path);
+            if(it != batches.end()) {
+                batch = std::move(it->second);
+                batches.erase(it);
+            }
+            return batch;
+        });
+        if(batch.waiters.empty()) {
+            return;
+        }
+        auto waiters = std::make_shared<std::vector<waiter_t>>(std::move(batch.waiters));
+        commit([=](std::future<versioned_value_t> future) {
+            try {
+                // Every waiter observes the counter as if its own increment was the last applied one before
+                // the increments queued after it.
+                auto result = future.get();
+                auto value = result.value();
+                for(auto it = waiters->rbegin(); it != waiters->rend(); ++it) {
+                    deliver(*it, make_ready_future<versioned_value_t>(versioned_value_t(value, result.version())));
+                    value = subtract_numeric(value, it->delta);
+                }
+            } catch(...) {
+                for(const auto& waiter: *waiters) {
+                    deliver(waiter, make_exceptional_future<versioned_value_t>());
+                }
+            }
+        }, path, batch.total);
+    }
+
+    static
+    auto deliver(const waiter_t& waiter, std::future<versioned_value_t> future) -> void {
+        waiter.scope->closed.apply([&](bool& closed) {
+            if(!closed) {
+                waiter.callback(std::move(future));
+            }
+        });
+    }
+
+    zookeeper_t& parent;
+    std::vector<path_t> sharded_prefixes;
+    const size_t shards;
+    const std::chrono::milliseconds window;
+    std::atomic<size_t> next_shard;
+
+    metrics::shared_metric<std::atomic<std::uint64_t>> commits;
+    metrics::shared_metric<std::atomic<std::uint64_t>> combined;
+
+    // Declared before pending batches, so timers are gone before the loop they are bound to.
+    executor::owning_asio_t executor;
+    synchronized<batches_t> batches;
+};
+
+class zookeeper_t::multi_t: public safe<multi_result_t, multi_reply_t> {
+    zookeeper_t& parent;
+    path_t path;
+    std::vector<operation_t> operations;
+
+public:
+    multi_t(api::v15::unicorn_t::multi_callback wrapped, zookeeper_t& parent, path_t path,
+            std::vector<operation_t> operations) :
+        safe(std::move(wrapped)),
+        parent(parent),
+        path(std::move(path)),
+        operations(std::move(operations))
+    {}
+
+    auto run() -> void {
+        if(path.empty() || path[0] != '/') {
+            throw error_t(error::invalid_path, "invalid transaction path {}", path);
+        }
+        if(operations.empty()) {
+            return satisfy(multi_result_t());
+        }
+        std::vector<multi_op_t> ops;
+        ops.reserve(operations.size());
+        for(const auto& operation: operations) {
+            const auto& target = operation.path;
+            if(target != path && (target.size() <= path.size() || target.compare(0, path.size(), path) != 0 ||
+                    (path.back() != '/' && target[path.size()] != '/')))
+            {
+                throw error_t(error::invalid_path, "operation path {} is not located under {}", target, path);
+            }
+            if(operation.version < 0 && (operation.type == operation_t::check || operation.type == operation_t::put)) {
+                throw error_t(error::version_not_allowed, "negative version is not allowed for check and put");
+            }
+            if(operation.type != operation_t::check) {
+                parent.invalidate(target);
+            }
+            std::string value;
+            if(operation.type == operation_t::create || operation.type == operation_t::put) {
+                value = serialize(operation.value);
+            }
+            ops.push_back(multi_op_t{
+                static_cast<multi_op_t::type_t>(operation.type),
+                target,
+                std::move(value),
+                operation.version,
+                operation.ephemeral,
+                operation.sequence
+            });
+        }
+        parent.zk.multi(std::move(ops), shared_from_this());
+    }
+
+private:
+    auto on_reply(multi_reply_t reply) -> void override {
+        if(reply.rc) {
+            for(size_t i = 0; i < reply.results.size(); i++) {
+                const auto rc = reply.results[i].rc;
+                if(rc != ZOK && rc != ZRUNTIMEINCONSISTENCY) {
+                    throw error_t(map_zoo_error(rc), "operation {} on {} failed, transaction is rolled back - {}",
+                                  i, operations[i].path, zerror(rc));
+                }
+            }
+            throw error_t(map_zoo_error(reply.rc), "failure during transaction commit - {}", zerror(reply.rc));
+        }
+        std::vector<path_t> paths;
+        std::vector<version_t> versions;
+        for(size_t i = 0; i < operations.size(); i++) {
+            const auto& operation = operations[i];
+            const auto& result = reply.results[i];
+            switch(operation.type) {
+            case operation_t::check:
+                paths.push_back(operation.path);
+                versions.push_back(operation.version);
+                break;
+            case operation_t::create:
+                paths.push_back(result.created_path);
+                versions.push_back(0);
+                break;
+            case operation_t::put:
+                paths.push_back(operation.path);
+                versions.push_back(result.stat.version);
+                break;
+            case operation_t::del:
+                paths.push_back(operation.path);
+                versions.push_back(not_existing_version);
+                break;
+            }
+        }
+        satisfy(std::make_tuple(std::move(paths), std::move(versions)));
+    }
+};
+
 class zookeeper_t::lock_t : public safe<bool, create_reply_t, children_reply_t, get_reply_t, exists_reply_t, del_reply_t, watch_reply_t> {
 public:
     struct lock_scope_t: public scope_t {
@@ -597,6 +1080,562 @@ private:
 };
 
 
+class zookeeper_t::cache_t: public std::enable_shared_from_this<cache_t> {
+public:
+    using clock_t = std::chrono::steady_clock;
+
+    struct waiter_t {
+        std::shared_ptr<scope_t> scope;
+        callback::get callback;
+    };
+
+    struct entry_t {
+        // Identifies the fetch which produced the entry, so stale watches do not drop newer entries.
+        size_t id;
+        // Empty while the fetch is in progress.
+        boost::optional<versioned_value_t> value;
+        clock_t::time_point fetched;
+        // Set when the watch fires before the fetch completes, the fetched value is then delivered but not cached.
+        bool invalidated;
+        std::vector<waiter_t> waiters;
+    };
+
+    using entries_t = std::unordered_map<path_t, entry_t>;
+
+    cache_t(zookeeper_t& parent, const dynamic_t& args) :
+        parent(parent),
+        max_entries(args.as_object().at("max_entries", 10000u).as_uint()),
+        id_counter(0),
+        hits(parent.context.metrics_hub().counter<std::uint64_t>(format("unicorn.{}.cache.hits", parent.name))),
+        misses(parent.context.metrics_hub().counter<std::uint64_t>(format("unicorn.{}.cache.misses", parent.name))),
+        invalidations(parent.context.metrics_hub().counter<std::uint64_t>(format("unicorn.{}.cache.invalidations", parent.name)))
+    {}
+
+    auto register_gauges() -> void {
+        std::weak_ptr<cache_t> weak_self(shared_from_this());
+        auto& hub = parent.context.metrics_hub();
+        hub.register_gauge<double>(format("unicorn.{}.cache.hit_ratio", parent.name), {}, [=]() -> double {
+            auto self = weak_self.lock();
+            if(!self) {
+                return 0.0;
+            }
+            auto hit = self->hits->load();
+            auto total = hit + self->misses->load();
+            return total ? static_cast<double>(hit) / total : 0.0;
+        });
+        hub.register_gauge<std::uint64_t>(format("unicorn.{}.cache.entries", parent.name), {}, [=]() -> std::uint64_t {
+            auto self = weak_self.lock();
+            return self ? self->entries->size() : 0;
+        });
+        // Staleness upper bound - how long the oldest entry has been served relying only on its watch.
+        hub.register_gauge<std::uint64_t>(format("unicorn.{}.cache.max_age_ms", parent.name), {}, [=]() -> std::uint64_t {
+            auto self = weak_self.lock();
+            if(!self) {
+                return 0;
+            }
+            auto now = clock_t::now();
+            clock_t::duration max_age(0);
+            self->entries.apply([&](const entries_t& entries) {
+                for(const auto& pair: entries) {
+                    if(pair.second.value) {
+                        max_age = std::max(max_age, now - pair.second.fetched);
+                    }
+                }
+            });
+            return std::chrono::duration_cast<std::chrono::milliseconds>(max_age).count();
+        });
+    }
+
+    auto get(callback::get callback, const path_t& path) -> scope_ptr;
+
+    auto fill(const path_t& path, size_t id, get_reply_t reply) -> void;
+
+    auto fail(const path_t& path, size_t id, std::exception_ptr eptr) -> void;
+
+    auto invalidate(const path_t& path) -> void;
+
+    auto invalidate(const path_t& path, size_t id) -> void;
+
+private:
+    static
+    auto deliver(const waiter_t& waiter, std::future<versioned_value_t> future) -> void {
+        waiter.scope->closed.apply([&](bool& closed){
+            if(!closed) {
+                waiter.callback(std::move(future));
+            }
+        });
+    }
+
+    auto take_waiters(const path_t& path, size_t id, bool keep) -> std::vector<waiter_t>;
+
+    zookeeper_t& parent;
+    size_t max_entries;
+    size_t id_counter;
+    synchronized<entries_t> entries;
+
+    metrics::shared_metric<std::atomic<std::uint64_t>> hits;
+    metrics::shared_metric<std::atomic<std::uint64_t>> misses;
+    metrics::shared_metric<std::atomic<std::uint64_t>> invalidations;
+};
+
+// Watched read which fills the cache entry and drops it on any watch event, including session loss.
+class zookeeper_t::cache_fetch_t:
+    public replier<get_reply_t>,
+    public replier<watch_reply_t>,
+    public std::enable_shared_from_this<cache_fetch_t>
+{
+    std::weak_ptr<cache_t> cache;
+    path_t path;
+    size_t id;
+
+public:
+    cache_fetch_t(std::weak_ptr<cache_t> cache, path_t path, size_t id) :
+        cache(std::move(cache)),
+        path(std::move(path)),
+        id(id)
+    {}
+
+    auto operator()(get_reply_t reply) -> void override {
+        if(auto self = cache.lock()) {
+            self->fill(path, id, std::move(reply));
+        }
+    }
+
+    auto operator()(watch_reply_t) -> void override {
+        if(auto self = cache.lock()) {
+            self->invalidate(path, id);
+        }
+    }
+};
+
+auto zookeeper_t::cache_t::get(callback::get callback, const path_t& path) -> scope_ptr {
+    auto scope = std::make_shared<scope_t>();
+    waiter_t waiter{scope, std::move(callback)};
+    boost::optional<versioned_value_t> cached;
+    size_t fetch_id = 0;
+    bool queued = false;
+    entries.apply([&](entries_t& entries) {
+        auto it = entries.find(path);
+        if(it != entries.end() && it->second.value) {
+            cached = it->second.value;
+        } else if(it != entries.end()) {
+            it->second.waiters.push_back(waiter);
+            queued = true;
+        } else if(entries.size() < max_entries) {
+            fetch_id = ++id_counter;
+            auto& entry = entries[path];
+            entry.id = fetch_id;
+            entry.invalidated = false;
+            entry.waiters.push_back(waiter);
+            queued = true;
+        }
+    });
+
+    if(cached) {
+        hits->operator++();
+        parent.executor->spawn([=]() {
+            deliver(waiter, make_ready_future<versioned_value_t>(*cached));
+        });
+        return scope;
+    }
+    misses->operator++();
+    if(!queued) {
+        // Cache is full - read directly, bypassing it.
+        return parent.run_command<get_t>(std::move(waiter.callback), path);
+    }
+    if(fetch_id) {
+        auto fetch = std::make_shared<cache_fetch_t>(shared_from_this(), path, fetch_id);
+        try {
+            parent.zk.get(path, fetch, fetch);
+        } catch(...) {
+            fail(path, fetch_id, std::current_exception());
+        }
+    }
+    return scope;
+}
+
+auto zookeeper_t::cache_t::take_waiters(const path_t& path, size_t id, bool keep) -> std::vector<waiter_t> {
+    std::vector<waiter_t> waiters;
+    entries.apply([&](entries_t& entries) {
+        auto it = entries.find(path);
+        if(it == entries.end() || it->second.id != id) {
+            return;
+        }
+        waiters.swap(it->second.waiters);
+        if(!keep) {
+            entries.erase(it);
+        }
+    });
+    return waiters;
+}
+
+auto zookeeper_t::cache_t::fill(const path_t& path, size_t id, get_reply_t reply) -> void {
+    if(reply.rc == ZOK && reply.stat.numChildren == 0) {
+        boost::optional<versioned_value_t> parsed;
+        try {
+            parsed = versioned_value_t(unserialize(reply.data), reply.stat.version);
+        } catch(...) {
+            return fail(path, id, std::current_exception());
+        }
+        const auto& value = *parsed;
+        std::vector<waiter_t> waiters;
+        entries.apply([&](entries_t& entries) {
+            auto it = entries.find(path);
+            if(it == entries.end() || it->second.id != id) {
+                return;
+            }
+            waiters.swap(it->second.waiters);
+            if(it->second.invalidated) {
+                entries.erase(it);
+            } else {
+                it->second.value = value;
+                it->second.fetched = clock_t::now();
+            }
+        });
+        for(const auto& waiter: waiters) {
+            deliver(waiter, make_ready_future<versioned_value_t>(value));
+        }
+        return;
+    }
+
+    // Results which are not cached, as no data watch is left on a missing node.
+    auto waiters = take_waiters(path, id, false);
+    for(const auto& waiter: waiters) {
+        try {
+            if(reply.rc == ZNONODE) {
+                deliver(waiter, make_ready_future<versioned_value_t>(versioned_value_t({}, not_existing_version)));
+            } else if(reply.rc != 0) {
+                throw error_t(map_zoo_error(reply.rc), "failure during getting node value - {}", zerror(reply.rc));
+            } else {
+                throw error_t(cocaine::error::child_not_allowed, "trying to read value of the node with childs");
+            }
+        } catch(...) {
+            deliver(waiter, make_exceptional_future<versioned_value_t>());
+        }
+    }
+}
+
+auto zookeeper_t::cache_t::fail(const path_t& path, size_t id, std::exception_ptr eptr) -> void {
+    auto waiters = take_waiters(path, id, false);
+    for(const auto& waiter: waiters) {
+        try {
+            std::rethrow_exception(eptr);
+        } catch(...) {
+            deliver(waiter, make_exceptional_future<versioned_value_t>());
+        }
+    }
+}
+
+auto zookeeper_t::cache_t::invalidate(const path_t& path) -> void {
+    entries.apply([&](entries_t& entries) {
+        auto it = entries.find(path);
+        // Pending entries are left to their fetch, it will still deliver a value to waiters.
+        if(it != entries.end() && it->second.value) {
+            entries.erase(it);
+            invalidations->operator++();
+        }
+    });
+}
+
+auto zookeeper_t::cache_t::invalidate(const path_t& path, size_t id) -> void {
+    entries.apply([&](entries_t& entries) {
+        auto it = entries.find(path);
+        if(it == entries.end() || it->second.id != id) {
+            return;
+        }
+        invalidations->operator++();
+        if(it->second.value) {
+            entries.erase(it);
+        } else {
+            it->second.invalidated = true;
+        }
+    });
+}
+
+/// Shared ZooKeeper watch on a single path, fanning its updates out to all local subscribers.
+/// Registered in the subscription registry while alive, the first subscriber starts it and
+/// it stops re-arming watches once all subscribers are gone.
+template<class T>
+class feed_t {
+public:
+    using feed_type = feed_t;
+    using registry_t = synchronized<std::map<path_t, std::weak_ptr<feed_t>>>;
+
+    struct subscriber_t {
+        std::shared_ptr<scope_t> scope;
+        future_callback<T> callback;
+    };
+
+    feed_t(std::shared_ptr<registry_t> registry, path_t path) :
+        registry(std::move(registry)),
+        path(std::move(path))
+    {}
+
+    virtual
+    ~feed_t() {}
+
+    virtual
+    auto run() -> void = 0;
+
+    /// Returns false if the feed has already been closed and can not accept subscribers.
+    auto add(subscriber_t subscriber) -> bool {
+        return state.apply([&](state_t& state) {
+            if(state.closed) {
+                return false;
+            }
+            if(state.last) {
+                deliver(subscriber, make_ready_future<T>(*state.last));
+            }
+            state.subscribers.push_back(std::move(subscriber));
+            return true;
+        });
+    }
+
+    /// Returns false if there are no subscribers left, in which case the feed is closed.
+    auto publish(T value) -> bool {
+        return state.apply([&](state_t& state) {
+            state.last = value;
+            prune(state);
+            for(const auto& subscriber: state.subscribers) {
+                deliver(subscriber, make_ready_future<T>(value));
+            }
+            if(state.subscribers.empty()) {
+                close(state);
+                return false;
+            }
+            return true;
+        });
+    }
+
+    auto active() -> bool {
+        return state.apply([&](state_t& state) {
+            prune(state);
+            if(state.subscribers.empty()) {
+                close(state);
+            }
+            return !state.closed;
+        });
+    }
+
+    auto abort(std::exception_ptr eptr) -> void {
+        state.apply([&](state_t& state) {
+            close(state);
+            for(const auto& subscriber: state.subscribers) {
+                try {
+                    std::rethrow_exception(eptr);
+                } catch(...) {
+                    deliver(subscriber, make_exceptional_future<T>());
+                }
+                subscriber.scope->close();
+            }
+            state.subscribers.clear();
+        });
+    }
+
+protected:
+    std::shared_ptr<registry_t> registry;
+    path_t path;
+
+    /// Aborts the feed with the exception thrown from the handler.
+    template<class F>
+    auto guarded(F f) -> void {
+        try {
+            f();
+        } catch(...) {
+            abort(std::current_exception());
+        }
+    }
+
+private:
+    struct state_t {
+        state_t() : closed(false) {}
+
+        std::vector<subscriber_t> subscribers;
+        boost::optional<T> last;
+        bool closed;
+    };
+
+    static
+    auto deliver(const subscriber_t& subscriber, std::future<T> future) -> void {
+        subscriber.scope->closed.apply([&](bool& closed){
+            if(!closed) {
+                subscriber.callback(std::move(future));
+            }
+        });
+    }
+
+    static
+    auto prune(state_t& state) -> void {
+        auto it = std::remove_if(state.subscribers.begin(), state.subscribers.end(), [](const subscriber_t& subscriber) {
+            return subscriber.scope->closed.apply([](bool& closed) { return closed; });
+        });
+        state.subscribers.erase(it, state.subscribers.end());
+    }
+
+    auto close(state_t& state) -> void {
+        if(state.closed) {
+            return;
+        }
+        state.closed = true;
+        registry->apply([&](std::map<path_t, std::weak_ptr<feed_t>>& entries) {
+            auto it = entries.find(path);
+            if(it != entries.end() && it->second.lock().get() == this) {
+                entries.erase(it);
+            }
+        });
+    }
+
+    // Recursive as subscribers may resubscribe on the same path from their callbacks.
+    synchronized<state_t, std::recursive_mutex> state;
+};
+
+class zookeeper_t::value_feed_t:
+    public feed_t<versioned_value_t>,
+    public replier<exists_reply_t>,
+    public replier<get_reply_t>,
+    public replier<watch_reply_t>,
+    public std::enable_shared_from_this<value_feed_t>
+{
+    zookeeper_t& parent;
+
+public:
+    value_feed_t(std::shared_ptr<registry_t> registry, zookeeper_t& parent, path_t path) :
+        feed_t(std::move(registry), std::move(path)),
+        parent(parent)
+    {}
+
+    auto run() -> void override {
+        COCAINE_LOG_DEBUG(parent.log, "unicorn subscription feed started on {}", path);
+        parent.zk.exists(path, shared_from_this(), shared_from_this());
+    }
+
+    auto operator()(exists_reply_t reply) -> void override {
+        guarded([&] {
+            if(reply.rc == ZOK) {
+                parent.zk.get(path, shared_from_this());
+            } else {
+                publish(versioned_value_t(value_t(), unicorn::not_existing_version));
+            }
+        });
+    }
+
+    auto operator()(get_reply_t reply) -> void override {
+        guarded([&] {
+            if(reply.rc) {
+                throw error_t(map_zoo_error(reply.rc), "node was removed - {}", zerror(reply.rc));
+            } else if (reply.stat.numChildren != 0) {
+                throw error_t(error::child_not_allowed, "trying to subscribe on node with childs");
+            }
+            publish(versioned_value_t(unserialize(reply.data), reply.stat.version));
+        });
+    }
+
+    auto operator()(watch_reply_t reply) -> void override {
+        guarded([&] {
+            if(!active()) {
+                COCAINE_LOG_DEBUG(parent.log, "unicorn subscription feed on {} has no subscribers left", path);
+                return;
+            }
+            auto type = reply.type;
+            auto state = reply.state;
+            if(type == ZOO_CREATED_EVENT || type == ZOO_CHANGED_EVENT ||
+                    (type == ZOO_SESSION_EVENT && state == ZOO_CONNECTED_STATE)
+            ) {
+                return parent.zk.get(path, shared_from_this(), shared_from_this());
+            } else if(type == ZOO_DELETED_EVENT) {
+                throw error_t(map_zoo_error(ZNONODE), "node was removed");
+            } else if(type == ZOO_CHILD_EVENT) {
+                throw error_t(error::child_not_allowed, "child created on watched node");
+            }
+            throw_watch_event(reply);
+        });
+    }
+};
+
+class zookeeper_t::children_feed_t:
+    public feed_t<response::children_subscribe>,
+    public replier<children_reply_t>,
+    public replier<watch_reply_t>,
+    public std::enable_shared_from_this<children_feed_t>
+{
+    zookeeper_t& parent;
+
+public:
+    children_feed_t(std::shared_ptr<registry_t> registry, zookeeper_t& parent, path_t path) :
+        feed_t(std::move(registry), std::move(path)),
+        parent(parent)
+    {}
+
+    auto run() -> void override {
+        parent.zk.childs(path, shared_from_this(), shared_from_this());
+    }
+
+    auto operator()(children_reply_t reply) -> void override {
+        guarded([&] {
+            if(reply.rc) {
+                throw error_t(map_zoo_error(reply.rc), "can not fetch children - {}", zerror(reply.rc));
+            }
+            publish(response::children_subscribe(reply.stat.cversion, std::move(reply.children)));
+        });
+    }
+
+    auto operator()(watch_reply_t reply) -> void override {
+        guarded([&] {
+            if(!active()) {
+                return;
+            }
+            if(reply.type == ZOO_DELETED_EVENT) {
+                throw error_t(error::no_node, "watched node was deleted");
+            } else if(reply.type == ZOO_CHILD_EVENT || (reply.type == ZOO_SESSION_EVENT && reply.state == ZOO_CONNECTED_STATE)) {
+                return parent.zk.childs(path, shared_from_this(), shared_from_this());
+            } else if(reply.type == ZOO_SESSION_EVENT) {
+                throw error_t(error::connection_loss, "session event {} {}, possible disconnection", reply.type, reply.state);
+            }
+            throw_watch_event(reply);
+        });
+    }
+};
+
+class zookeeper_t::feeds_t {
+public:
+    std::shared_ptr<value_feed_t::registry_t> values = std::make_shared<value_feed_t::registry_t>();
+    std::shared_ptr<children_feed_t::registry_t> children = std::make_shared<children_feed_t::registry_t>();
+};
+
+template<class Feed, class Callback>
+auto zookeeper_t::run_feed(std::shared_ptr<typename Feed::registry_t> registry, Callback callback, const path_t& path)
+    -> scope_ptr
+{
+    auto scope = std::make_shared<scope_t>();
+    typename Feed::subscriber_t subscriber{scope, std::move(callback)};
+    while(true) {
+        std::shared_ptr<Feed> created;
+        auto feed = registry->apply([&](std::map<path_t, std::weak_ptr<typename Feed::feed_type>>& entries) {
+            auto existing = entries[path].lock();
+            if(!existing) {
+                created = std::make_shared<Feed>(registry, *this, path);
+                existing = created;
+                entries[path] = existing;
+            }
+            return existing;
+        });
+        if(!feed->add(subscriber)) {
+            continue;
+        }
+        if(created) {
+            try {
+                created->run();
+            } catch(...) {
+                auto eptr = std::current_exception();
+                executor->spawn([=](){
+                    created->abort(eptr);
+                });
+            }
+        }
+        return scope;
+    }
+}
+
 template<class Action, class Callback, class... Args>
 auto zookeeper_t::run_command(Callback callback, Args&& ...args) -> scope_ptr {
     auto action = std::make_shared<Action>(std::move(callback), *this, std::forward<Args>(args)...);
@@ -618,37 +1657,91 @@ zookeeper_t::zookeeper_t(cocaine::context_t& _context, const std::string& _name,
     name(_name),
     log(context.log(cocaine::format("unicorn/{}", name))),
     zk_session(),
-    zk(make_zk_config(args), zk_session)
+    connection(make_connection(args, zk_session)),
+    zk(*connection)
 {
+    if(args.as_object().at("subscription_fan_in", true).as_bool()) {
+        feeds = std::make_shared<feeds_t>();
+    }
+
+    auto counters_args = args.as_object().find("counters");
+    if(counters_args != args.as_object().end()) {
+        counters = std::make_shared<counters_t>(*this, counters_args->second);
+    }
+
+    auto cache_args = args.as_object().find("cache");
+    if(cache_args != args.as_object().end()) {
+        cache = std::make_shared<cache_t>(*this, cache_args->second);
+        cache->register_gauges();
+    }
 }
 
 zookeeper_t::~zookeeper_t() = default;
 
 auto zookeeper_t::put(callback::put callback, const path_t& path, const value_t& value, version_t version) -> scope_ptr {
+    if(counters && counters->sharded(path)) {
+        return run_command<sharded_rejection_t<response::put>>(std::move(callback), path);
+    }
+    invalidate(path);
     return run_command<put_t>(std::move(callback), path, value, version);
 }
 
 auto zookeeper_t::get(callback::get callback, const path_t& path) -> scope_ptr {
+    if(counters && counters->sharded(path)) {
+        return run_command<shard_sum_t>(std::move(callback), path);
+    }
+    if(cache) {
+        return cache->get(std::move(callback), path);
+    }
     return run_command<get_t>(std::move(callback), path);
 }
 
+auto zookeeper_t::get_raw(get_raw_callback callback, const path_t& path) -> scope_ptr {
+    // Sharded counters and cached values exist only in decoded form, there is nothing to relay as is.
+    if(counters && counters->sharded(path)) {
+        return run_command<sharded_rejection_t<versioned_raw_value_t>>(std::move(callback), path);
+    }
+    return run_command<get_raw_t>(std::move(callback), path);
+}
+
 auto zookeeper_t::create(callback::create callback, const path_t& path, const value_t& value, bool ephemeral, bool sequence) -> scope_ptr {
+    if(counters && counters->sharded(path)) {
+        return run_command<sharded_rejection_t<bool>>(std::move(callback), path);
+    }
+    invalidate(path);
     return run_command<create_t>(std::move(callback), path, value, ephemeral, sequence);
 }
 
 auto zookeeper_t::del(callback::del callback, const path_t& path, version_t version) -> scope_ptr {
+    if(counters && counters->sharded(path)) {
+        return run_command<sharded_rejection_t<bool>>(std::move(callback), path);
+    }
+    invalidate(path);
     return run_command<del_t>(std::move(callback), path, version);
 }
 
 auto zookeeper_t::subscribe(callback::subscribe callback, const path_t& path) -> scope_ptr {
+    if(counters && counters->sharded(path)) {
+        return run_command<sharded_rejection_t<versioned_value_t>>(std::move(callback), path);
+    }
+    if(feeds) {
+        return run_feed<value_feed_t>(feeds->values, std::move(callback), path);
+    }
     return run_command<subscribe_t>(std::move(callback), path);
 }
 
 auto zookeeper_t::children_subscribe(callback::children_subscribe callback, const path_t& path) -> scope_ptr {
+    if(feeds) {
+        return run_feed<children_feed_t>(feeds->children, std::move(callback), path);
+    }
     return run_command<children_subscribe_t>(std::move(callback), path);
 }
 
 auto zookeeper_t::increment(callback::increment callback, const path_t& path, const value_t& value) -> scope_ptr {
+    invalidate(path);
+    if(counters) {
+        return counters->increment(std::move(callback), path, value);
+    }
     return run_command<increment_t>(std::move(callback), path, value);
 }
 
@@ -660,4 +1753,16 @@ auto zookeeper_t::named_lock(callback::lock callback, const path_t& path, const
     return run_command<lock_t>(std::move(callback), path, value);
 }
 
+auto zookeeper_t::multi(api::v15::unicorn_t::multi_callback callback, const path_t& path,
+                        const std::vector<operation_t>& operations) -> scope_ptr
+{
+    return run_command<multi_t>(std::move(callback), path, operations);
+}
+
+auto zookeeper_t::invalidate(const path_t& path) -> void {
+    if(cache) {
+        cache->invalidate(path);
+    }
+}
+
 }}
@@ -22,6 +22,7 @@
 #include <cocaine/errors.hpp>
 
 #include <iostream>
+#include <memory>
 
 namespace cocaine {
 namespace zookeeper {
@@ -53,19 +54,69 @@ auto get_node_name(const path_t& path) -> std::string {
     return path.substr(pos+1);
 }
 
-auto serialize(const unicorn::value_t& val) -> std::string {
-    msgpack::sbuffer buffer;
-    msgpack::packer<msgpack::sbuffer> packer(buffer);
-    cocaine::io::type_traits<cocaine::dynamic_t>::pack(packer, val);
-    return std::string(buffer.data(), buffer.size());
-}
+namespace {
 
-auto unserialize(const std::string& val) -> unicorn::value_t {
+/// Packer stream appending directly to a string.
+struct string_stream_t {
+    std::string& target;
+
+    auto write(const char* data, size_t size) -> void {
+        target.append(data, size);
+    }
+};
+
+/// Per thread decoding zone. It is cleared after every use, which releases all chunks but the first one,
+/// so decoding of typical small values does not hit the allocator for the zone at all.
+class local_zone_t {
+public:
+    local_zone_t() :
+        zone(nullptr)
+    {
+        if(!busy()) {
+            busy() = true;
+            zone = &pooled();
+        } else {
+            // Nested decode on the same thread, e.g. from a visitor - fall back to a private zone.
+            owned.reset(new msgpack::zone());
+            zone = owned.get();
+        }
+    }
+
+    ~local_zone_t() {
+        if(!owned) {
+            zone->clear();
+            busy() = false;
+        }
+    }
+
+    auto get() -> msgpack::zone* {
+        return zone;
+    }
+
+private:
+    static
+    auto pooled() -> msgpack::zone& {
+        thread_local msgpack::zone zone;
+        return zone;
+    }
+
+    static
+    auto busy() -> bool& {
+        thread_local bool flag = false;
+        return flag;
+    }
+
+    msgpack::zone* zone;
+    std::unique_ptr<msgpack::zone> owned;
+};
+
+template<class Visitor>
+auto decode(const std::string& val, Visitor visitor) -> void {
+    local_zone_t zone;
     msgpack::object obj;
-    std::unique_ptr<msgpack::zone> z(new msgpack::zone());
 
     msgpack_unpack_return ret = msgpack_unpack(
-            val.c_str(), val.size(), nullptr, z.get(),
+            val.data(), val.size(), nullptr, zone.get(),
             reinterpret_cast<msgpack_object*>(&obj)
     );
 
@@ -73,11 +124,39 @@ auto unserialize(const std::string& val) -> unicorn::value_t {
     if(static_cast<msgpack::unpack_return>(ret) != msgpack::UNPACK_SUCCESS) {
         throw std::system_error(cocaine::error::unicorn_errors::invalid_value);
     }
+    visitor(obj);
+}
+
+} // namespace
+
+auto serialize(const unicorn::value_t& val) -> std::string {
+    // Scratch buffer keeps its capacity between calls, so the result is allocated once with the exact size.
+    thread_local std::string scratch;
+    serialize(val, scratch);
+    return scratch;
+}
+
+auto serialize(const unicorn::value_t& val, std::string& target) -> void {
+    target.clear();
+    string_stream_t stream{target};
+    msgpack::packer<string_stream_t> packer(stream);
+    cocaine::io::type_traits<cocaine::dynamic_t>::pack(packer, val);
+}
+
+auto unserialize(const std::string& val) -> unicorn::value_t {
     unicorn::value_t target;
-    cocaine::io::type_traits<cocaine::dynamic_t>::unpack(obj, target);
+    decode(val, [&](const msgpack::object& obj) {
+        cocaine::io::type_traits<cocaine::dynamic_t>::unpack(obj, target);
+    });
     return target;
 }
 
+auto unserialize_raw(std::string val) -> unicorn::raw_value_t {
+    // Validate only, nothing is converted.
+    decode(val, [](const msgpack::object&) {});
+    return unicorn::raw_value_t(std::move(val));
+}
+
 auto map_zoo_error(int rc) -> std::error_code {
     if(rc == ZCONNECTIONLOSS || rc == ZSESSIONEXPIRED || rc == ZCLOSING) {
         return make_error_code(error::unicorn_errors::connection_loss);
@@ -127,4 +206,33 @@ auto state_to_string(int state) -> std::string {
 }
 
 } // namespace zookeeper
+
+namespace unicorn {
+
+raw_value_t::raw_value_t(std::string data) :
+    bytes(std::move(data))
+{}
+
+auto raw_value_t::data() const -> const std::string& {
+    return bytes;
+}
+
+auto raw_value_t::decode() const -> value_t {
+    if(bytes.empty()) {
+        return value_t();
+    }
+    return zookeeper::unserialize(bytes);
+}
+
+auto raw_value_t::visit(const std::function<void(const msgpack::object&)>& visitor) const -> void {
+    if(bytes.empty()) {
+        msgpack::object nil;
+        nil.type = msgpack::type::NIL;
+        visitor(nil);
+        return;
+    }
+    zookeeper::decode(bytes, visitor);
+}
+
+} // namespace unicorn
 } // namespace cocaine
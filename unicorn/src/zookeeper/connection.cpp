@@ -24,6 +24,7 @@
 #include <zookeeper/zookeeper.h>
 
 #include <algorithm>
+#include <memory>
 #include <string>
 
 namespace cocaine {
@@ -76,7 +77,7 @@ cfg_t::connection_string() const {
     return result;
 }
 
-zookeeper::connection_t::connection_t(const cfg_t& _cfg, const session_t& _session) :
+zookeeper::zoo_connection_t::zoo_connection_t(const cfg_t& _cfg, const session_t& _session) :
     cfg(_cfg),
     session(_session),
     executor(new cocaine::executor::owning_asio_t()),
@@ -92,7 +93,7 @@ zookeeper::connection_t::connection_t(const cfg_t& _cfg, const session_t& _sessi
     create_prefix();
 }
 
-path_t zookeeper::connection_t::format_path(const path_t& path) {
+path_t zookeeper::zoo_connection_t::format_path(const path_t& path) {
     if(path.empty() || path[0] != '/') {
         throw error_t(error::unicorn_errors::invalid_path, "invalid path provided");
     }
@@ -144,9 +145,46 @@ auto children_cb(int rc, const struct String_vector* strings, const stat_t* stat
     replier->operator()({rc, std::move(children), rc ? empty_stat : *stat});
 }
 
+namespace {
+
+// Everything zoo_amulti refers to by pointer, kept alive until the completion fires.
+struct multi_context_t {
+    replier_ptr<multi_reply_t> replier;
+    std::size_t prefix_size;
+    std::vector<multi_op_t> ops;
+    std::vector<path_t> paths;
+    std::vector<std::vector<char>> created_paths;
+    std::vector<stat_t> stats;
+    std::vector<zoo_op_t> zoo_ops;
+    std::vector<zoo_op_result_t> zoo_results;
+    ACL_vector acl;
+};
+
+}
+
+auto multi_cb(int rc, const void* data) -> void {
+    std::unique_ptr<multi_context_t> context(reinterpret_cast<multi_context_t*>(const_cast<void*>(data)));
+    multi_reply_t reply{rc, {}};
+    reply.results.reserve(context->ops.size());
+    for(size_t i = 0; i < context->ops.size(); i++) {
+        const auto& result = context->zoo_results[i];
+        multi_result_t item{result.err, path_t(), stat_t()};
+        if(result.err == ZOK) {
+            if(context->ops[i].type == multi_op_t::create && result.value) {
+                item.created_path = result.value + context->prefix_size;
+            }
+            if(context->ops[i].type == multi_op_t::put) {
+                item.stat = context->stats[i];
+            }
+        }
+        reply.results.push_back(std::move(item));
+    }
+    context->replier->operator()(std::move(reply));
+}
+
 auto watch_cb(zhandle_t* zh, int type, int state, const char* path, void* watch_data) -> void {
-    connection_t* c = const_cast<connection_t*>(reinterpret_cast<const connection_t*>(zoo_get_context(zh)));
-    auto watcher = c->watchers.apply([&](connection_t::watchers_t& watchers) -> replier_ptr<watch_reply_t> {
+    zoo_connection_t* c = const_cast<zoo_connection_t*>(reinterpret_cast<const zoo_connection_t*>(zoo_get_context(zh)));
+    auto watcher = c->watchers.apply([&](zoo_connection_t::watchers_t& watchers) -> replier_ptr<watch_reply_t> {
         auto it = watchers.find(reinterpret_cast<size_t>(watch_data));
         if(it != watchers.end()) {
             auto watcher = std::move(it->second);
@@ -166,7 +204,7 @@ auto watch_cb(zhandle_t* zh, int type, int state, const char* path, void* watch_
 }
 
 template<class ZooFunction, class Replier, class CCallback, class... Args>
-auto connection_t::zoo_command(ZooFunction f, const path_t& path, Replier&& replier, CCallback cb, Args&&... args) -> void {
+auto zoo_connection_t::zoo_command(ZooFunction f, const path_t& path, Replier&& replier, CCallback cb, Args&&... args) -> void {
     check_connectivity();
     auto prefixed_path = format_path(path);
     auto ctx = pack_ptr(std::forward<Replier>(replier));
@@ -178,7 +216,7 @@ auto connection_t::zoo_command(ZooFunction f, const path_t& path, Replier&& repl
 }
 
 template<class ZooFunction, class Replier, class CCallback, class... Args>
-auto connection_t::zoo_watched_command(ZooFunction f, const path_t& path, Replier&& replier, CCallback cb,
+auto zoo_connection_t::zoo_watched_command(ZooFunction f, const path_t& path, Replier&& replier, CCallback cb,
                                        replier_ptr<watch_reply_t> watcher, Args&&... args) -> void
 {
     if(watcher) {
@@ -194,7 +232,7 @@ auto connection_t::zoo_watched_command(ZooFunction f, const path_t& path, Replie
 }
 
 
-auto connection_t::put(const path_t& path, const std::string& value, version_t version, replier_ptr<put_reply_t> handler) -> void {
+auto zoo_connection_t::put(const path_t& path, const std::string& value, version_t version, replier_ptr<put_reply_t> handler) -> void {
     zoo_command(zoo_aset, path, std::move(handler), put_cb, value.c_str(), value.size(), version);
 }
 
@@ -202,12 +240,12 @@ auto connection_t::get(const path_t& path, replier_ptr<get_reply_t> handler) ->
     get(path, std::move(handler), nullptr);
 }
 
-auto connection_t::get(const path_t& path, replier_ptr<get_reply_t> handler, replier_ptr<watch_reply_t> watcher) -> void {
+auto zoo_connection_t::get(const path_t& path, replier_ptr<get_reply_t> handler, replier_ptr<watch_reply_t> watcher) -> void {
     zoo_watched_command(zoo_awget, path, std::move(handler), get_cb, std::move(watcher));
 }
 
-auto connection_t::create(const path_t& path, const std::string& value, bool ephemeral, bool sequence,
-                          replier_ptr<create_reply_t> handler) -> void
+auto zoo_connection_t::create(const path_t& path, const std::string& value, bool ephemeral, bool sequence,
+                              replier_ptr<create_reply_t> handler) -> void
 {
     auto acl = ZOO_OPEN_ACL_UNSAFE;
     int flag = ephemeral ? ZOO_EPHEMERAL : 0;
@@ -220,7 +258,7 @@ auto connection_t::del(const path_t& path, replier_ptr<del_reply_t> handler) ->
     del(path, -1, std::move(handler));
 }
 
-auto connection_t::del(const path_t& path, version_t version, replier_ptr<del_reply_t> handler) -> void {
+auto zoo_connection_t::del(const path_t& path, version_t version, replier_ptr<del_reply_t> handler) -> void {
     zoo_command(zoo_adelete, path, std::move(handler), delete_cb, version);
 }
 
@@ -228,7 +266,7 @@ auto connection_t::exists(const path_t& path, replier_ptr<exists_reply_t> handle
     exists(path, std::move(handler), nullptr);
 }
 
-auto connection_t::exists(const path_t& path, replier_ptr<exists_reply_t> handler, replier_ptr<watch_reply_t> watcher) -> void {
+auto zoo_connection_t::exists(const path_t& path, replier_ptr<exists_reply_t> handler, replier_ptr<watch_reply_t> watcher) -> void {
     zoo_watched_command(zoo_awexists, path, std::move(handler), exists_cb, std::move(watcher));
 }
 
@@ -236,11 +274,63 @@ auto connection_t::childs(const path_t& path, replier_ptr<children_reply_t> hand
     childs(path, std::move(handler), nullptr);
 }
 
-auto connection_t::childs(const path_t& path, replier_ptr<children_reply_t> handler, replier_ptr<watch_reply_t> watcher) -> void {
+auto zoo_connection_t::childs(const path_t& path, replier_ptr<children_reply_t> handler, replier_ptr<watch_reply_t> watcher) -> void {
     zoo_watched_command(zoo_awget_children2, path, std::move(handler), children_cb, std::move(watcher));
 }
 
-auto connection_t::check_connectivity() -> void {
+auto zoo_connection_t::multi(std::vector<multi_op_t> ops, replier_ptr<multi_reply_t> handler) -> void {
+    check_connectivity();
+    const auto count = ops.size();
+
+    std::unique_ptr<multi_context_t> context(new multi_context_t());
+    context->replier = std::move(handler);
+    context->prefix_size = cfg.prefix.size();
+    context->ops = std::move(ops);
+    context->acl = ZOO_OPEN_ACL_UNSAFE;
+    context->paths.reserve(count);
+    context->created_paths.resize(count);
+    context->stats.resize(count);
+    context->zoo_ops.resize(count);
+    context->zoo_results.resize(count);
+
+    for(const auto& op: context->ops) {
+        context->paths.push_back(format_path(op.path));
+    }
+
+    for(size_t i = 0; i < count; i++) {
+        const auto& op = context->ops[i];
+        const auto path = context->paths[i].c_str();
+        auto zoo_op = &context->zoo_ops[i];
+        switch(op.type) {
+        case multi_op_t::check:
+            zoo_check_op_init(zoo_op, path, op.version);
+            break;
+        case multi_op_t::create: {
+            int flag = op.ephemeral ? ZOO_EPHEMERAL : 0;
+            flag = flag | (op.sequence ? ZOO_SEQUENCE : 0);
+            // Sequence nodes get a 10 digit suffix appended to the name.
+            auto& buffer = context->created_paths[i];
+            buffer.resize(context->paths[i].size() + 16);
+            zoo_create_op_init(zoo_op, path, op.value.c_str(), op.value.size(), &context->acl, flag,
+                               buffer.data(), buffer.size());
+            break;
+        }
+        case multi_op_t::put:
+            zoo_set_op_init(zoo_op, path, op.value.c_str(), op.value.size(), op.version, &context->stats[i]);
+            break;
+        case multi_op_t::del:
+            zoo_delete_op_init(zoo_op, path, op.version);
+            break;
+        }
+    }
+
+    auto zh_lock = zhandle.synchronize();
+    check_rc(zoo_amulti(zh_lock->get(), static_cast<int>(count), context->zoo_ops.data(), context->zoo_results.data(),
+                        multi_cb, context.get()));
+    context.release();
+}
+
+auto zoo_connection_t::check_connectivity() -> void {
     zhandle.apply([&](zhandle_ptr& handle) {
         if(!handle.get() || is_unrecoverable(handle.get())) {
             reconnect(handle);
@@ -248,7 +338,7 @@ auto connection_t::check_connectivity() -> void {
     });
 }
 
-auto connection_t::cancel_watches() -> void {
+auto zoo_connection_t::cancel_watches() -> void {
     watchers_t watchers_for_cancellation;
     watchers.apply([&](watchers_t& watchers) mutable {
         watchers_for_cancellation.swap(watchers);
@@ -261,19 +351,19 @@ auto connection_t::cancel_watches() -> void {
     });
 }
 
-auto connection_t::check_rc(int rc) -> void {
+auto zoo_connection_t::check_rc(int rc) -> void {
     if(rc != ZOK) {
         throw error_t(map_zoo_error(rc), "can not perform operation - {}", zerror(rc));
     }
 }
 
-auto connection_t::reconnect() -> void {
+auto zoo_connection_t::reconnect() -> void {
     zhandle.apply([&](zhandle_ptr& h) {
         reconnect(h);
     });
 }
 
-auto connection_t::reconnect(zhandle_ptr& old_zhandle) -> void {
+auto zoo_connection_t::reconnect(zhandle_ptr& old_zhandle) -> void {
     zhandle_ptr new_zhandle = init();
     if(!new_zhandle.get() || is_unrecoverable(new_zhandle.get())) {
         if(session.valid()) {
@@ -296,7 +386,7 @@ auto connection_t::reconnect(zhandle_ptr& old_zhandle) -> void {
     cancel_watches();
 }
 
-auto connection_t::init() -> connection_t::zhandle_ptr {
+auto zoo_connection_t::init() -> zoo_connection_t::zhandle_ptr {
     zhandle_t* new_zhandle = zookeeper_init(cfg.connection_string().c_str(),
                                             watch_cb,
                                             cfg.recv_timeout_ms,
@@ -304,16 +394,16 @@ auto connection_t::init() -> connection_t::zhandle_ptr {
                                             nullptr,
                                             0);
     zoo_set_context(new_zhandle, reinterpret_cast<void*>(this));
-    return zhandle_ptr(new_zhandle, std::bind(&connection_t::close, this, std::placeholders::_1));
+    return zhandle_ptr(new_zhandle, std::bind(&zoo_connection_t::close, this, std::placeholders::_1));
 }
 
-auto connection_t::close(zhandle_t* handle) -> void{
+auto zoo_connection_t::close(zhandle_t* handle) -> void{
     executor->spawn([=]{
         zookeeper_close(handle);
     });
 }
 
-auto connection_t::create_prefix() -> void {
+auto zoo_connection_t::create_prefix() -> void {
     if (!cfg.prefix.empty()) {
         auto count = std::count(cfg.prefix.begin(), cfg.prefix.end(), '/');
         auto acl = ZOO_OPEN_ACL_UNSAFE;
@@ -0,0 +1,452 @@
+/*
+* 2015+ Copyright (c) Anton Matveenko <antmat@yandex-team.ru>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*/
+
+#include "cocaine/zookeeper/memory.hpp"
+
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+#include <zookeeper/zookeeper.h>
+
+#include <cstdio>
+#include <future>
+
+namespace cocaine {
+namespace zookeeper {
+
+namespace {
+
+// Session id stored as ephemeral owner of nodes created by the in-memory connection.
+const int64_t session_id = 1;
+
+auto now_ms() -> int64_t {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()
+    ).count();
+}
+
+} // namespace
+
+memory_connection_t::memory_connection_t(std::chrono::microseconds _latency) :
+    latency(_latency),
+    stopping(false),
+    timer(executor.asio())
+{
+    tree.apply([&](tree_t& tree) {
+        tree.zxid = 0;
+        tree.nodes["/"] = node_t();
+    });
+}
+
+memory_connection_t::~memory_connection_t() {
+    // Everything posted before this point is processed first, so it is safe to drop pending deliveries here. Anything
+    // posted later is dropped by the flag, the timer is destroyed before the executor thread is joined.
+    std::promise<void> done;
+    executor.asio().post([&] {
+        stopping = true;
+        timer.cancel();
+        queue.clear();
+        done.set_value();
+    });
+    done.get_future().wait();
+}
+
+auto memory_connection_t::parent_of(const path_t& path) -> path_t {
+    auto pos = path.find_last_of('/');
+    if(pos == 0) {
+        return "/";
+    }
+    return path.substr(0, pos);
+}
+
+auto memory_connection_t::validate(const path_t& path) -> bool {
+    if(path.empty() || path[0] != '/') {
+        return false;
+    }
+    if(path.size() > 1 && path.back() == '/') {
+        return false;
+    }
+    return path.find("//") == std::string::npos;
+}
+
+auto memory_connection_t::put(const path_t& path, const std::string& value, version_t version,
+                              replier_ptr<put_reply_t> handler) -> void
+{
+    tree.apply([&](tree_t& tree) {
+        std::vector<event_t> events;
+        stat_t stat = stat_t();
+        auto rc = validate(path) ? apply_put(tree, path, value, version, stat, events) : ZBADARGUMENTS;
+        trigger(tree, events);
+        deliver([=] {
+            (*handler)({rc, stat});
+        });
+    });
+}
+
+auto memory_connection_t::get(const path_t& path, replier_ptr<get_reply_t> handler,
+                              replier_ptr<watch_reply_t> watcher) -> void
+{
+    tree.apply([&](tree_t& tree) {
+        auto it = validate(path) ? tree.nodes.find(path) : tree.nodes.end();
+        if(it == tree.nodes.end()) {
+            auto rc = validate(path) ? ZNONODE : ZBADARGUMENTS;
+            deliver([=] {
+                stat_t stat = stat_t();
+                (*handler)({rc, std::string(), stat});
+            });
+            return;
+        }
+        if(watcher) {
+            tree.data_watchers[path].push_back(watcher);
+        }
+        auto data = it->second.data;
+        auto stat = it->second.stat;
+        deliver([=] {
+            (*handler)({ZOK, data, stat});
+        });
+    });
+}
+
+auto memory_connection_t::create(const path_t& path, const std::string& value, bool ephemeral, bool sequence,
+                                 replier_ptr<create_reply_t> handler) -> void
+{
+    tree.apply([&](tree_t& tree) {
+        std::vector<event_t> events;
+        path_t created;
+        auto rc = validate(path) ? apply_create(tree, path, value, ephemeral, sequence, created, events)
+                                 : ZBADARGUMENTS;
+        trigger(tree, events);
+        deliver([=] {
+            (*handler)({rc, created});
+        });
+    });
+}
+
+auto memory_connection_t::del(const path_t& path, version_t version, replier_ptr<del_reply_t> handler) -> void {
+    tree.apply([&](tree_t& tree) {
+        std::vector<event_t> events;
+        auto rc = validate(path) ? apply_del(tree, path, version, events) : ZBADARGUMENTS;
+        trigger(tree, events);
+        deliver([=] {
+            (*handler)({rc});
+        });
+    });
+}
+
+auto memory_connection_t::exists(const path_t& path, replier_ptr<exists_reply_t> handler,
+                                 replier_ptr<watch_reply_t> watcher) -> void
+{
+    tree.apply([&](tree_t& tree) {
+        if(!validate(path)) {
+            deliver([=] {
+                stat_t stat = stat_t();
+                (*handler)({ZBADARGUMENTS, stat});
+            });
+            return;
+        }
+        // Unlike get, exists leaves the watch even for a missing node to be notified on its creation.
+        if(watcher) {
+            tree.data_watchers[path].push_back(watcher);
+        }
+        auto it = tree.nodes.find(path);
+        auto rc = it == tree.nodes.end() ? ZNONODE : ZOK;
+        auto stat = it == tree.nodes.end() ? stat_t() : it->second.stat;
+        deliver([=] {
+            (*handler)({rc, stat});
+        });
+    });
+}
+
+auto memory_connection_t::childs(const path_t& path, replier_ptr<children_reply_t> handler,
+                                 replier_ptr<watch_reply_t> watcher) -> void
+{
+    tree.apply([&](tree_t& tree) {
+        auto it = validate(path) ? tree.nodes.find(path) : tree.nodes.end();
+        if(it == tree.nodes.end()) {
+            auto rc = validate(path) ? ZNONODE : ZBADARGUMENTS;
+            deliver([=] {
+                stat_t stat = stat_t();
+                (*handler)({rc, std::vector<std::string>(), stat});
+            });
+            return;
+        }
+        if(watcher) {
+            tree.child_watchers[path].push_back(watcher);
+        }
+        std::vector<std::string> children(it->second.children.begin(), it->second.children.end());
+        auto stat = it->second.stat;
+        deliver([=] {
+            (*handler)({ZOK, children, stat});
+        });
+    });
+}
+
+auto memory_connection_t::multi(std::vector<multi_op_t> ops, replier_ptr<multi_reply_t> handler) -> void {
+    tree.apply([&](tree_t& tree) {
+        // Operations are applied to a copy which replaces the tree only if all of them succeed.
+        auto copy = tree;
+        std::vector<event_t> events;
+        multi_reply_t reply{ZOK, std::vector<multi_result_t>(ops.size(), multi_result_t{ZOK, path_t(), stat_t()})};
+
+        for(size_t i = 0; i < ops.size(); ++i) {
+            const auto& op = ops[i];
+            auto& result = reply.results[i];
+            if(!validate(op.path)) {
+                result.rc = ZBADARGUMENTS;
+            } else {
+                switch(op.type) {
+                case multi_op_t::check:
+                    result.rc = apply_check(copy, op.path, op.version);
+                    break;
+                case multi_op_t::create:
+                    result.rc = apply_create(copy, op.path, op.value, op.ephemeral, op.sequence,
+                                             result.created_path, events);
+                    break;
+                case multi_op_t::put:
+                    result.rc = apply_put(copy, op.path, op.value, op.version, result.stat, events);
+                    break;
+                case multi_op_t::del:
+                    result.rc = apply_del(copy, op.path, op.version, events);
+                    break;
+                }
+            }
+            if(result.rc != ZOK) {
+                reply.rc = result.rc;
+                // Zookeeper reports operations following the failed one as rolled back.
+                for(size_t j = i + 1; j < ops.size(); ++j) {
+                    reply.results[j].rc = ZRUNTIMEINCONSISTENCY;
+                }
+                // Effects of the preceding ones are discarded along with the copy.
+                for(size_t j = 0; j < i; ++j) {
+                    reply.results[j] = multi_result_t{ZOK, path_t(), stat_t()};
+                }
+                break;
+            }
+        }
+
+        if(reply.rc == ZOK) {
+            tree.nodes.swap(copy.nodes);
+            tree.zxid = copy.zxid;
+            trigger(tree, events);
+        }
+        deliver([=] {
+            (*handler)(reply);
+        });
+    });
+}
+
+auto memory_connection_t::reconnect() -> void {
+    tree.apply([&](tree_t& tree) {
+        // New session drops ephemeral nodes of the previous one. Their watchers are fired with the session event
+        // below anyway, so no node events are generated.
+        std::vector<path_t> ephemerals;
+        for(const auto& node: tree.nodes) {
+            if(node.second.stat.ephemeralOwner == session_id) {
+                ephemerals.push_back(node.first);
+            }
+        }
+        for(const auto& path: ephemerals) {
+            std::vector<event_t> unused;
+            apply_del(tree, path, -1, unused);
+        }
+
+        std::vector<replier_ptr<watch_reply_t>> watchers;
+        for(auto& entry: tree.data_watchers) {
+            watchers.insert(watchers.end(), entry.second.begin(), entry.second.end());
+        }
+        for(auto& entry: tree.child_watchers) {
+            watchers.insert(watchers.end(), entry.second.begin(), entry.second.end());
+        }
+        tree.data_watchers.clear();
+        tree.child_watchers.clear();
+
+        deliver([=] {
+            watch_reply_t reply {ZOO_SESSION_EVENT, ZOO_EXPIRED_SESSION_STATE, ""};
+            for(auto& w: watchers) {
+                w->operator()(reply);
+            }
+        });
+    });
+}
+
+auto memory_connection_t::apply_create(tree_t& tree, const path_t& path, const std::string& value, bool ephemeral,
+                                       bool sequence, path_t& created, std::vector<event_t>& events) -> int
+{
+    if(path == "/") {
+        return ZNODEEXISTS;
+    }
+    auto parent_path = parent_of(path);
+    auto parent = tree.nodes.find(parent_path);
+    if(parent == tree.nodes.end()) {
+        return ZNONODE;
+    }
+    if(parent->second.stat.ephemeralOwner != 0) {
+        return ZNOCHILDRENFOREPHEMERALS;
+    }
+
+    created = path;
+    if(sequence) {
+        char suffix[16];
+        std::snprintf(suffix, sizeof(suffix), "%010d", parent->second.stat.cversion);
+        created += suffix;
+    }
+    if(tree.nodes.count(created)) {
+        return ZNODEEXISTS;
+    }
+
+    auto zxid = ++tree.zxid;
+    auto now = now_ms();
+
+    node_t node;
+    node.data = value;
+    node.stat.czxid = zxid;
+    node.stat.mzxid = zxid;
+    node.stat.pzxid = zxid;
+    node.stat.ctime = now;
+    node.stat.mtime = now;
+    node.stat.ephemeralOwner = ephemeral ? session_id : 0;
+    node.stat.dataLength = static_cast<int32_t>(value.size());
+    tree.nodes[created] = std::move(node);
+
+    auto& parent_node = tree.nodes[parent_path];
+    parent_node.children.insert(created.substr(parent_path == "/" ? 1 : parent_path.size() + 1));
+    parent_node.stat.cversion++;
+    parent_node.stat.pzxid = zxid;
+    parent_node.stat.numChildren = static_cast<int32_t>(parent_node.children.size());
+
+    events.push_back({created, ZOO_CREATED_EVENT, false});
+    events.push_back({parent_path, ZOO_CHILD_EVENT, true});
+    return ZOK;
+}
+
+auto memory_connection_t::apply_put(tree_t& tree, const path_t& path, const std::string& value, version_t version,
+                                    stat_t& stat, std::vector<event_t>& events) -> int
+{
+    auto it = tree.nodes.find(path);
+    if(it == tree.nodes.end()) {
+        return ZNONODE;
+    }
+    auto& node = it->second;
+    if(version != -1 && version != node.stat.version) {
+        return ZBADVERSION;
+    }
+    node.data = value;
+    node.stat.version++;
+    node.stat.mzxid = ++tree.zxid;
+    node.stat.mtime = now_ms();
+    node.stat.dataLength = static_cast<int32_t>(value.size());
+    stat = node.stat;
+
+    events.push_back({path, ZOO_CHANGED_EVENT, false});
+    return ZOK;
+}
+
+auto memory_connection_t::apply_del(tree_t& tree, const path_t& path, version_t version,
+                                    std::vector<event_t>& events) -> int
+{
+    if(path == "/") {
+        return ZBADARGUMENTS;
+    }
+    auto it = tree.nodes.find(path);
+    if(it == tree.nodes.end()) {
+        return ZNONODE;
+    }
+    if(version != -1 && version != it->second.stat.version) {
+        return ZBADVERSION;
+    }
+    if(!it->second.children.empty()) {
+        return ZNOTEMPTY;
+    }
+    tree.nodes.erase(it);
+
+    auto parent_path = parent_of(path);
+    auto& parent = tree.nodes[parent_path];
+    parent.children.erase(path.substr(parent_path == "/" ? 1 : parent_path.size() + 1));
+    parent.stat.cversion++;
+    parent.stat.pzxid = ++tree.zxid;
+    parent.stat.numChildren = static_cast<int32_t>(parent.children.size());
+
+    events.push_back({path, ZOO_DELETED_EVENT, false});
+    events.push_back({path, ZOO_DELETED_EVENT, true});
+    events.push_back({parent_path, ZOO_CHILD_EVENT, true});
+    return ZOK;
+}
+
+auto memory_connection_t::apply_check(const tree_t& tree, const path_t& path, version_t version) -> int {
+    auto it = tree.nodes.find(path);
+    if(it == tree.nodes.end()) {
+        return ZNONODE;
+    }
+    if(version != -1 && version != it->second.stat.version) {
+        return ZBADVERSION;
+    }
+    return ZOK;
+}
+
+auto memory_connection_t::trigger(tree_t& tree, const std::vector<event_t>& events) -> void {
+    for(const auto& event: events) {
+        auto& registry = event.child ? tree.child_watchers : tree.data_watchers;
+        auto it = registry.find(event.path);
+        if(it == registry.end()) {
+            continue;
+        }
+        watchers_t watchers;
+        watchers.swap(it->second);
+        registry.erase(it);
+
+        deliver([=] {
+            watch_reply_t reply {event.type, ZOO_CONNECTED_STATE, event.path};
+            for(auto& w: watchers) {
+                w->operator()(reply);
+            }
+        });
+    }
+}
+
+auto memory_connection_t::deliver(std::function<void()> work) -> void {
+    auto deadline = clock_t::now() + latency;
+    // Latency is the same for all requests, so the queue stays ordered by deadline.
+    executor.asio().post([=] {
+        if(stopping) {
+            return;
+        }
+        queue.push_back({deadline, work});
+        if(queue.size() == 1) {
+            drain();
+        }
+    });
+}
+
+auto memory_connection_t::drain() -> void {
+    auto now = clock_t::now();
+    while(!queue.empty() && queue.front().deadline <= now) {
+        auto task = std::move(queue.front());
+        queue.pop_front();
+        task.work();
+    }
+    if(queue.empty()) {
+        return;
+    }
+
+    auto remaining = std::chrono::duration_cast<std::chrono::microseconds>(queue.front().deadline - now);
+    timer.expires_from_now(boost::posix_time::microseconds(remaining.count()));
+    timer.async_wait([=](const std::error_code& ec) {
+        if(!ec && !stopping) {
+            drain();
+        }
+    });
+}
+
+} // namespace zookeeper
+} // namespace cocaine
@@ -33,6 +33,7 @@ class request_context_t;
 namespace cocaine {
 namespace vicodyn {
 
+class hedging_t;
 class invocation_t;
 class proxy_t;
 class peer_t;
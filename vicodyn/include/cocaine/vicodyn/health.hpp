@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <system_error>
+
+namespace cocaine {
+namespace vicodyn {
+
+// Per peer request outcome tracker, used by outlier detection in peers_t to temporarily eject misbehaving peers.
+// Ejected peer receives no traffic until ejection expires, after that its share of traffic is ramped back linearly.
+class health_t {
+public:
+    using clock_t = std::chrono::steady_clock;
+
+    // Outcomes collected since the previous call to collect.
+    struct window_t {
+        std::uint64_t requests;
+        std::uint64_t errors;
+        std::uint64_t latency_us;
+
+        auto error_rate() const -> double;
+
+        auto average_latency_us() const -> double;
+    };
+
+    health_t();
+
+    // Errors caused by infrastructure (node, overseer, transport) rather than by application logic.
+    static
+    auto is_peer_error(std::error_code ec) -> bool;
+
+    auto on_reply(clock_t::duration latency) -> void;
+
+    // Infrastructure error, disconnection or a request abandoned without reply.
+    auto on_error() -> void;
+
+    auto collect() -> window_t;
+
+    auto eject(clock_t::duration base, clock_t::duration max, clock_t::duration ramp) -> void;
+
+    // Resets ejection backoff after the peer has been healthy during the whole window.
+    auto restore() -> void;
+
+    auto ejected() const -> bool;
+
+    // Share of traffic the peer should receive - 0 when ejected, growing to 1 while ramping back.
+    auto weight() const -> double;
+
+    // Randomly decides whether the peer can be chosen according to its weight.
+    auto available() const -> bool;
+
+private:
+    static
+    auto now() -> std::int64_t;
+
+    std::atomic<std::uint64_t> requests;
+    std::atomic<std::uint64_t> errors;
+    std::atomic<std::uint64_t> latency_us;
+
+    // Steady clock ticks.
+    std::atomic<std::int64_t> ejected_until;
+    std::atomic<std::int64_t> ramped_until;
+    std::atomic<std::uint64_t> ejections;
+};
+
+} // namespace vicodyn
+} // namespace cocaine
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cocaine/dynamic.hpp>
+#include <cocaine/forwards.hpp>
+#include <cocaine/hpack/header.hpp>
+
+#include <asio/deadline_timer.hpp>
+#include <asio/io_service.hpp>
+
+#include <metrics/accumulator/decaying/exponentially.hpp>
+#include <metrics/metric.hpp>
+#include <metrics/timer.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <set>
+
+namespace cocaine {
+namespace vicodyn {
+
+// Opt-in policy for sending a duplicate enqueue to a second peer when the first one is slow to respond.
+// Configured per proxy via "hedging" section of vicodyn args:
+//     "hedging": {
+//         "events": ["get"],              # hedge requests with these event names
+//         "headers": ["x-cocaine-hedge"], # hedge requests carrying any of these headers
+//         "percentile": 0.95,             # first chunk latency percentile used as a hedge delay
+//         "min_delay_ms": 5,              # lower bound of the hedge delay
+//         "default_delay_ms": 100,        # delay used until first chunk latencies are collected
+//         "refresh_ms": 1000              # how often the hedge delay is recalculated
+//     }
+// First chunk latency is measured for every request of the proxy, hedged or not, so that the delay is not derived
+// from its own outcome only. The percentile is taken from a timer snapshot periodically, not per request.
+class hedging_t {
+public:
+    using first_chunk_timer_t = metrics::timer<metrics::accumulator::decaying::exponentially_t>;
+
+    hedging_t(context_t& context, asio::io_service& loop, const std::string& app_name, const dynamic_t& args);
+
+    ~hedging_t();
+
+    auto enabled(const hpack::headers_t& headers, const std::string& event) const -> bool;
+
+    // Last calculated hedge delay.
+    auto delay() const -> std::chrono::milliseconds;
+
+    // Starts measuring time until the first response chunk, called for every request of the proxy.
+    auto measure() -> std::unique_ptr<first_chunk_timer_t::context_t>;
+
+    auto on_sent() -> void;
+
+    auto on_settled(bool hedge_won) -> void;
+
+private:
+    // Owned via shared_ptr, so that a refresh already queued on the loop can outlive the policy.
+    struct cache_t {
+        explicit
+        cache_t(asio::io_service& loop);
+
+        asio::deadline_timer timer;
+        std::atomic<std::int64_t> delay_ms;
+    };
+
+    static
+    auto schedule(std::weak_ptr<cache_t> cache, metrics::shared_metric<first_chunk_timer_t> first_chunk,
+                  double percentile, std::chrono::milliseconds min_delay, std::chrono::milliseconds default_delay,
+                  std::chrono::milliseconds refresh_period) -> void;
+
+    std::set<std::string> events;
+    std::vector<std::string> headers;
+    double percentile;
+    std::chrono::milliseconds min_delay;
+    std::chrono::milliseconds default_delay;
+    std::chrono::milliseconds refresh_period;
+
+    struct {
+        /// Number of requests, proxied via hedging enabled proxy.
+        metrics::shared_metric<std::atomic<std::uint64_t>> requests;
+
+        /// Number of duplicate enqueues sent to a second peer.
+        metrics::shared_metric<std::atomic<std::uint64_t>> sent;
+
+        /// Number of hedged requests where the duplicate answered first.
+        metrics::shared_metric<std::atomic<std::uint64_t>> won;
+
+        /// Number of hedged requests where the original peer answered first.
+        metrics::shared_metric<std::atomic<std::uint64_t>> lost;
+    } stats;
+
+    metrics::shared_metric<first_chunk_timer_t> first_chunk;
+    std::shared_ptr<cache_t> cache;
+};
+
+} // namespace vicodyn
+} // namespace cocaine
@@ -3,6 +3,7 @@
 #include "cocaine/idl/node.hpp"
 
 #include "cocaine/format/endpoint.hpp"
+#include "cocaine/vicodyn/health.hpp"
 
 #include <cocaine/executor/asio.hpp>
 #include <cocaine/forwards.hpp>
@@ -11,8 +12,12 @@
 #include <cocaine/rpc/session.hpp>
 #include <cocaine/rpc/upstream.hpp>
 
+#include <asio/deadline_timer.hpp>
 #include <asio/ip/tcp.hpp>
 
+#include <metrics/metric.hpp>
+
+#include <atomic>
 #include <future>
 
 namespace cocaine {
@@ -26,25 +31,23 @@ public:
 
     ~peer_t();
 
-    peer_t(context_t& context, asio::io_service& loop, endpoints_t endpoints, std::string uuid, dynamic_t::object_t extra);
+    peer_t(context_t& context, asio::io_service& loop, endpoints_t endpoints, std::string uuid, dynamic_t::object_t extra,
+           size_t sessions_count = 1);
 
+    // Session the stream was forked on is stored in `session` even if sending the event fails.
     template<class Event, class ...Args>
-    auto open_stream(std::shared_ptr<io::basic_dispatch_t> dispatch, Args&& ...args) -> io::upstream_ptr_t {
-        auto locked = session.synchronize();
-        auto session = *locked;
-        if(!session) {
-            schedule_reconnect(session);
-            throw error_t(error::not_connected, "session is not connected");
-        }
-        d.last_active = std::chrono::system_clock::now();
-        auto stream = session->fork(std::move(dispatch));
+    auto open_stream(std::shared_ptr<io::basic_dispatch_t> dispatch, std::weak_ptr<cocaine::session_t>& session,
+                     Args&& ...args) -> io::upstream_ptr_t
+    {
+        auto stream = fork(std::move(dispatch), session);
         stream->send<Event>(std::forward<Args>(args)...);
         return stream;
     }
 
     auto connect() -> void;
 
-    auto schedule_reconnect() -> void;
+    // Reconnects the session a failed stream was forked on, other sessions of the peer are kept.
+    auto schedule_reconnect(const std::weak_ptr<cocaine::session_t>& session) -> void;
 
     auto uuid() const -> const std::string&;
 
@@ -52,22 +55,47 @@ public:
 
     auto connected() const -> bool;
 
+    auto connected_sessions() const -> size_t;
+
     auto last_active() const -> std::chrono::system_clock::time_point;
 
     auto extra() const -> const dynamic_t::object_t&;
 
     auto x_cocaine_cluster() const -> const std::string&;
 
+    auto health() -> health_t&;
+
+    auto health() const -> const health_t&;
+
 private:
-    auto schedule_reconnect(std::shared_ptr<cocaine::session_t>& session) -> void;
+    // One of several TCP connections to the peer, reconnected independently of the others.
+    struct connection_t {
+        explicit
+        connection_t(asio::io_service& loop);
+
+        synchronized<std::shared_ptr<cocaine::session_t>> session;
+        asio::deadline_timer timer;
+        bool connecting;
+        // Number of streams currently forked on the session, shared with the dispatches tracking them.
+        std::shared_ptr<std::atomic<size_t>> streams;
+    };
+
+    // Forks a stream on the least loaded connected session.
+    auto fork(std::shared_ptr<io::basic_dispatch_t> dispatch, std::weak_ptr<cocaine::session_t>& forked_on)
+        -> io::upstream_ptr_t;
+
+    auto connect(connection_t& connection) -> void;
+
+    auto schedule_reconnect(connection_t& connection) -> void;
+
+    auto schedule_reconnect(connection_t& connection, std::shared_ptr<cocaine::session_t>& session) -> void;
 
     context_t& context;
     std::string service_name;
     asio::io_service& loop;
-    asio::deadline_timer timer;
     std::unique_ptr<logging::logger_t> logger;
-    synchronized<std::shared_ptr<cocaine::session_t>> session;
-    bool connecting;
+    std::vector<std::unique_ptr<connection_t>> connections;
+    health_t health_state;
 
     struct {
         std::string uuid;
@@ -95,12 +123,41 @@ public:
 private:
     context_t& context;
     std::unique_ptr<logging::logger_t> logger;
+    size_t sessions_per_peer;
+
+    // Outlier detection settings, configured via "outlier_detection" section of vicodyn args.
+    struct {
+        bool enabled;
+        std::chrono::milliseconds interval;
+        // Minimum number of requests in the interval for the peer to be considered.
+        std::uint64_t min_requests;
+        // Peer is ejected if its error rate exceeds this value.
+        double error_rate;
+        // Peer is ejected if its average reply latency exceeds the median across peers by this factor.
+        double latency_factor;
+        // Upper limit of the share of peers that can be ejected at the same time.
+        double max_ejected_share;
+        std::chrono::milliseconds base_ejection;
+        std::chrono::milliseconds max_ejection;
+        std::chrono::milliseconds ramp_up;
+    } detection;
+
+    metrics::shared_metric<std::atomic<std::uint64_t>> ejections;
     executor::owning_asio_t executor;
     data_t data;
     mutable boost::shared_mutex mutex;
+    // Accessed in the executor thread only, destroyed before the executor.
+    std::unique_ptr<asio::deadline_timer> detection_timer;
+    bool stopping;
+
+    auto schedule_detection() -> void;
+
+    auto detect_outliers() -> void;
 
 
 public:
+    ~peers_t();
+
     template<class F>
     auto apply_shared(F&& f) const -> decltype(f(std::declval<const data_t&>())) {
         boost::shared_lock<boost::shared_mutex> lock(mutex);
@@ -114,7 +171,7 @@ public:
     }
 
 
-    peers_t(context_t& context);
+    peers_t(context_t& context, const dynamic_t& args);
 
     auto register_peer(const std::string& uuid, const endpoints_t& endpoints, dynamic_t::object_t extra) -> std::shared_ptr<peer_t>;
 
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "cocaine/vicodyn/forwards.hpp"
+#include "cocaine/vicodyn/hedging.hpp"
 #include "cocaine/vicodyn/peer.hpp"
 
 #include <cocaine/api/service.hpp>
@@ -11,6 +12,10 @@
 
 #include <asio/ip/tcp.hpp>
 
+#include <metrics/metric.hpp>
+
+#include <atomic>
+
 namespace cocaine {
 namespace vicodyn {
 
@@ -34,11 +39,33 @@ public:
 private:
     auto make_balancer(const dynamic_t& args, const dynamic_t::object_t& extra) -> api::vicodyn::balancer_ptr;
 
+    auto make_hedging(const dynamic_t& args) -> std::unique_ptr<hedging_t>;
+
     context_t& context;
     asio::io_service& loop;
     peers_t& peers;
     std::string app_name;
     api::vicodyn::balancer_ptr balancer;
+    std::unique_ptr<hedging_t> hedging;
+    // Maximum number of bytes buffered per stream for retries, 0 means unlimited.
+    size_t buffer_window;
+    // Maximum size of a single reply in bytes, 0 means unlimited. Streams with larger replies are cancelled.
+    // This is a size limit, not flow control: sessions do not report when the client has drained a chunk.
+    size_t max_reply_bytes;
+
+    struct {
+        /// Bytes of request chunks currently buffered for retries across all streams.
+        metrics::shared_metric<std::atomic<std::int64_t>> buffered_bytes;
+
+        /// Number of streams which exceeded the buffering window and lost the ability to be retried.
+        metrics::shared_metric<std::atomic<std::uint64_t>> buffer_overflows;
+
+        /// Reply bytes relayed to clients.
+        metrics::shared_metric<std::atomic<std::uint64_t>> reply_bytes;
+
+        /// Number of streams cancelled because their replies exceeded the reply size limit.
+        metrics::shared_metric<std::atomic<std::uint64_t>> reply_limit_exceeded;
+    } stats;
 
     const std::unique_ptr<logging::logger_t> logger;
 };
@@ -4,24 +4,79 @@
 
 #include <blackhole/logger.hpp>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+
 namespace cocaine {
 namespace vicodyn {
 
+// Fixed capacity array allowing concurrent lock-free appends. Items beyond capacity are counted and dropped.
+template<class T, size_t Capacity>
+class append_only_array_t {
+    struct slot_t {
+        T value;
+        std::atomic<bool> published;
+    };
+
+    std::array<slot_t, Capacity> slots;
+    std::atomic<size_t> reserved;
+
+public:
+    append_only_array_t() :
+        reserved(0)
+    {
+        for(auto& slot: slots) {
+            slot.published.store(false, std::memory_order_relaxed);
+        }
+    }
+
+    auto push_back(T value) -> bool {
+        auto idx = reserved.fetch_add(1, std::memory_order_relaxed);
+        if(idx >= Capacity) {
+            return false;
+        }
+        slots[idx].value = std::move(value);
+        slots[idx].published.store(true, std::memory_order_release);
+        return true;
+    }
+
+    // Visits all items published so far.
+    template<class F>
+    auto each(F&& f) const -> void {
+        auto size = std::min(reserved.load(std::memory_order_acquire), Capacity);
+        for(size_t i = 0; i < size; i++) {
+            if(slots[i].published.load(std::memory_order_acquire)) {
+                f(slots[i].value);
+            }
+        }
+    }
+
+    auto dropped() const -> size_t {
+        auto size = reserved.load(std::memory_order_relaxed);
+        return size > Capacity ? size - Capacity : 0;
+    }
+};
+
 class request_context_t: public std::enable_shared_from_this<request_context_t> {
-    using clock_t = std::chrono::system_clock;
+    using clock_t = std::chrono::steady_clock;
     struct checkpoint_t {
         const char* message;
         size_t msg_len;
         clock_t::time_point when;
     };
 
+    static constexpr size_t max_checkpoints = 32;
+    static constexpr size_t max_used_peers = 16;
+
     blackhole::logger_t& logger;
     clock_t::time_point start_time;
     std::atomic_flag closed;
 
-    synchronized<std::vector<std::shared_ptr<peer_t>>> used_peers;
-    synchronized<std::vector<checkpoint_t>> checkpoints;
-    size_t retry_counter;
+    append_only_array_t<std::shared_ptr<peer_t>, max_used_peers> used_peers;
+    append_only_array_t<checkpoint_t, max_checkpoints> checkpoints;
+    std::atomic<size_t> retry_counter;
+    std::atomic<size_t> reply_bytes;
 
 public:
     request_context_t(blackhole::logger_t& logger);
@@ -38,9 +93,12 @@ public:
 
     auto retry_count() -> size_t;
 
+    // Reply bytes relayed to the client so far, reported with the request.
+    auto set_reply_bytes(size_t bytes) -> void;
+
     template <size_t N>
     auto add_checkpoint(const char(&name)[N]) -> void {
-        checkpoints->emplace_back(checkpoint_t{name, N - 1, std::chrono::system_clock::now()});
+        checkpoints.push_back(checkpoint_t{name, N - 1, clock_t::now()});
     }
 
     auto finish() -> void;
@@ -38,6 +38,9 @@ struct dynamic_constructor<vicodyn::peer_t> {
         dynamic_t::object_t data;
         data["extra"] = from.extra();
         data["connected"] = from.connected();
+        data["connected_sessions"] = from.connected_sessions();
+        data["ejected"] = from.health().ejected();
+        data["weight"] = from.health().weight();
         data["endpoints"] = from.endpoints();
         data["last_active"] = std::chrono::system_clock::to_time_t(from.last_active());
         data["uuid"] = from.uuid();
@@ -85,7 +88,7 @@ vicodyn_t::vicodyn_t(context_t& _context, const std::string& _local_uuid, const
     context(_context),
     locator_extra(locator_extra),
     wrapped_gateway(),
-    peers(context),
+    peers(context, args),
     args(args),
     local_uuid(_local_uuid),
     logger(context.log(format("gateway/{}", name)))
@@ -45,17 +45,24 @@ auto simple_t::choose_peer(const std::shared_ptr<request_context_t>& /*request_c
             throw error_t("no peers found");
         }
         auto& apps = apps_it->second;
+        auto suitable = [&](const peers_t::peers_data_t::value_type& pair) -> bool {
+            if(!pair.second->connected()) {
+                return false;
+            }
+            if(x_cocaine_cluster != pair.second->x_cocaine_cluster()) {
+                return false;
+            }
+            return apps.count(pair.second->uuid()) > 0;
+        };
         auto it = choose_random_if(mapping.peers.begin(), mapping.peers.end(), mapping.peers.size(),
             [&](const peers_t::peers_data_t::value_type& pair) -> bool {
-                if(!pair.second->connected()) {
-                    return false;
-                }
-                if(x_cocaine_cluster != pair.second->x_cocaine_cluster()) {
-                    return false;
-                }
-                return apps.count(pair.second->uuid()) > 0;
+                return pair.second->health().available() && suitable(pair);
             }
         );
+        if(it == mapping.peers.end()) {
+            // Fall back to ejected peers rather than failing the request.
+            it = choose_random_if(mapping.peers.begin(), mapping.peers.end(), mapping.peers.size(), suitable);
+        }
         if(it != mapping.peers.end()) {
             return it->second;
         }
@@ -0,0 +1,101 @@
+#include "cocaine/vicodyn/health.hpp"
+
+#include "cocaine/service/node/slave/error.hpp"
+
+#include <cocaine/errors.hpp>
+
+#include <algorithm>
+#include <random>
+
+namespace cocaine {
+namespace vicodyn {
+
+auto health_t::window_t::error_rate() const -> double {
+    return requests ? static_cast<double>(errors) / requests : 0.0;
+}
+
+auto health_t::window_t::average_latency_us() const -> double {
+    auto replies = requests - errors;
+    return replies ? static_cast<double>(latency_us) / replies : 0.0;
+}
+
+health_t::health_t() :
+    requests(0),
+    errors(0),
+    latency_us(0),
+    ejected_until(0),
+    ramped_until(0),
+    ejections(0)
+{}
+
+auto health_t::is_peer_error(std::error_code ec) -> bool {
+    return ec.category() == error::node_category() ||
+           ec.category() == error::overseer_category() ||
+           ec.category() == error::dispatch_category();
+}
+
+auto health_t::on_reply(clock_t::duration latency) -> void {
+    requests.fetch_add(1, std::memory_order_relaxed);
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(latency).count();
+    latency_us.fetch_add(static_cast<std::uint64_t>(std::max<decltype(us)>(us, 0)), std::memory_order_relaxed);
+}
+
+auto health_t::on_error() -> void {
+    requests.fetch_add(1, std::memory_order_relaxed);
+    errors.fetch_add(1, std::memory_order_relaxed);
+}
+
+auto health_t::collect() -> window_t {
+    window_t window;
+    window.requests = requests.exchange(0);
+    window.errors = errors.exchange(0);
+    window.latency_us = latency_us.exchange(0);
+    return window;
+}
+
+auto health_t::eject(clock_t::duration base, clock_t::duration max, clock_t::duration ramp) -> void {
+    auto count = ++ejections;
+    auto duration = std::min<clock_t::duration>(base * static_cast<clock_t::rep>(count), max);
+    auto until = now() + duration.count();
+    ejected_until.store(until);
+    ramped_until.store(until + ramp.count());
+}
+
+auto health_t::restore() -> void {
+    if(!ejected()) {
+        ejections.store(0);
+    }
+}
+
+auto health_t::ejected() const -> bool {
+    return now() < ejected_until.load(std::memory_order_relaxed);
+}
+
+auto health_t::weight() const -> double {
+    auto current = now();
+    auto ejected_till = ejected_until.load(std::memory_order_relaxed);
+    auto ramped_till = ramped_until.load(std::memory_order_relaxed);
+    if(current < ejected_till) {
+        return 0.0;
+    }
+    if(current >= ramped_till) {
+        return 1.0;
+    }
+    return static_cast<double>(current - ejected_till) / (ramped_till - ejected_till);
+}
+
+auto health_t::available() const -> bool {
+    auto w = weight();
+    if(w >= 1.0) {
+        return true;
+    }
+    static thread_local std::minstd_rand generator(std::random_device{}());
+    return std::uniform_real_distribution<double>(0, 1)(generator) < w;
+}
+
+auto health_t::now() -> std::int64_t {
+    return clock_t::now().time_since_epoch().count();
+}
+
+} // namespace vicodyn
+} // namespace cocaine
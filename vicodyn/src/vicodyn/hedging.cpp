@@ -0,0 +1,120 @@
+#include "cocaine/vicodyn/hedging.hpp"
+
+#include <cocaine/context.hpp>
+#include <cocaine/errors.hpp>
+#include <cocaine/format.hpp>
+
+#include <metrics/registry.hpp>
+
+namespace cocaine {
+namespace vicodyn {
+
+namespace {
+
+auto strings(const dynamic_t& value) -> std::vector<std::string> {
+    std::vector<std::string> result;
+    for(const auto& item: value.as_array()) {
+        result.push_back(item.as_string());
+    }
+    return result;
+}
+
+} // namespace
+
+hedging_t::cache_t::cache_t(asio::io_service& loop) :
+    timer(loop),
+    delay_ms(0)
+{}
+
+hedging_t::hedging_t(context_t& context, asio::io_service& loop, const std::string& app_name,
+                     const dynamic_t& args) :
+    percentile(args.as_object().at("percentile", 0.95).to<double>()),
+    min_delay(args.as_object().at("min_delay_ms", 5u).as_uint()),
+    default_delay(args.as_object().at("default_delay_ms", 100u).as_uint()),
+    refresh_period(args.as_object().at("refresh_ms", 1000u).as_uint()),
+    stats{
+        context.metrics_hub().counter<std::uint64_t>(format("vicodyn.{}.hedge.requests", app_name)),
+        context.metrics_hub().counter<std::uint64_t>(format("vicodyn.{}.hedge.sent", app_name)),
+        context.metrics_hub().counter<std::uint64_t>(format("vicodyn.{}.hedge.won", app_name)),
+        context.metrics_hub().counter<std::uint64_t>(format("vicodyn.{}.hedge.lost", app_name))
+    },
+    first_chunk(context.metrics_hub().timer<metrics::accumulator::decaying::exponentially_t>(
+        format("vicodyn.{}.hedge.first_chunk", app_name))),
+    cache(std::make_shared<cache_t>(loop))
+{
+    auto event_list = strings(args.as_object().at("events", dynamic_t::empty_array));
+    events.insert(event_list.begin(), event_list.end());
+    headers = strings(args.as_object().at("headers", dynamic_t::empty_array));
+    if(refresh_period.count() == 0) {
+        throw error_t("hedging refresh_ms can not be zero");
+    }
+    cache->delay_ms.store(default_delay.count());
+    schedule(cache, first_chunk, percentile, min_delay, default_delay, refresh_period);
+}
+
+hedging_t::~hedging_t() {
+    std::error_code ec;
+    cache->timer.cancel(ec);
+}
+
+auto hedging_t::enabled(const hpack::headers_t& request_headers, const std::string& event) const -> bool {
+    if(events.count(event) > 0) {
+        return true;
+    }
+    for(const auto& name: headers) {
+        if(hpack::header::find_first(request_headers, name)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+auto hedging_t::delay() const -> std::chrono::milliseconds {
+    return std::chrono::milliseconds(cache->delay_ms.load(std::memory_order_relaxed));
+}
+
+auto hedging_t::schedule(std::weak_ptr<cache_t> weak_cache, metrics::shared_metric<first_chunk_timer_t> first_chunk,
+                         double percentile, std::chrono::milliseconds min_delay,
+                         std::chrono::milliseconds default_delay, std::chrono::milliseconds refresh_period) -> void
+{
+    auto cache = weak_cache.lock();
+    if(!cache) {
+        return;
+    }
+    cache->timer.expires_from_now(boost::posix_time::milliseconds(refresh_period.count()));
+    cache->timer.async_wait([=](const std::error_code& ec) {
+        auto current = weak_cache.lock();
+        if(ec || !current) {
+            return;
+        }
+        // Taking a snapshot of the decaying reservoir is expensive, so it is done here rather than per request.
+        const auto ns = first_chunk->snapshot().value(percentile);
+        auto delay = default_delay;
+        if(ns > 0) {
+            delay = std::max(min_delay, std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::nanoseconds(static_cast<std::int64_t>(ns))));
+        }
+        current->delay_ms.store(delay.count(), std::memory_order_relaxed);
+        schedule(weak_cache, first_chunk, percentile, min_delay, default_delay, refresh_period);
+    });
+}
+
+auto hedging_t::measure() -> std::unique_ptr<first_chunk_timer_t::context_t> {
+    stats.requests->operator++();
+    return std::unique_ptr<first_chunk_timer_t::context_t>(new first_chunk_timer_t::context_t(first_chunk->context()));
+}
+
+auto hedging_t::on_sent() -> void {
+    stats.sent->operator++();
+}
+
+auto hedging_t::on_settled(bool hedge_won) -> void {
+    if(hedge_won) {
+        stats.won->operator++();
+    } else {
+        stats.lost->operator++();
+    }
+}
+
+} // namespace vicodyn
+} // namespace cocaine
@@ -17,6 +17,8 @@
 
 #include <blackhole/logger.hpp>
 
+#include <algorithm>
+
 #include <metrics/registry.hpp>
 #include <cocaine/vicodyn/peer.hpp>
 #include <cocaine/rpc/upstream.hpp>
@@ -24,33 +26,111 @@
 namespace cocaine {
 namespace vicodyn {
 
+namespace {
+
+// Keeps the forked dispatch alive while the session holds it, counting the stream as active until then.
+struct tracked_dispatch_t {
+    std::shared_ptr<io::basic_dispatch_t> dispatch;
+    std::shared_ptr<std::atomic<size_t>> streams;
+
+    tracked_dispatch_t(std::shared_ptr<io::basic_dispatch_t> _dispatch, std::shared_ptr<std::atomic<size_t>> _streams) :
+        dispatch(std::move(_dispatch)),
+        streams(std::move(_streams))
+    {
+        ++(*streams);
+    }
+
+    ~tracked_dispatch_t() {
+        --(*streams);
+    }
+};
+
+} // namespace
+
+peer_t::connection_t::connection_t(asio::io_service& loop) :
+    timer(loop),
+    connecting(),
+    streams(std::make_shared<std::atomic<size_t>>(0))
+{}
+
 peer_t::~peer_t(){
-    session.apply([&](std::shared_ptr<session_t>& session) {
-        if(session) {
-            session->detach(std::error_code());
-        }
-    });
+    for(auto& connection: connections) {
+        connection->session.apply([&](std::shared_ptr<session_t>& session) {
+            if(session) {
+                session->detach(std::error_code());
+            }
+        });
+    }
 }
 
-peer_t::peer_t(context_t& context, asio::io_service& loop, endpoints_t endpoints, std::string uuid, dynamic_t::object_t extra) :
+peer_t::peer_t(context_t& context, asio::io_service& loop, endpoints_t endpoints, std::string uuid, dynamic_t::object_t extra,
+               size_t sessions_count) :
     context(context),
     loop(loop),
-    timer(loop),
     logger(context.log(format("vicodyn_peer/{}", uuid))),
-    connecting(),
     d({std::move(uuid), std::move(endpoints), std::chrono::system_clock::now(), std::move(extra), {}})
 {
     d.x_cocaine_cluster = d.extra.at("x-cocaine-cluster", "").as_string();
+    for(size_t i = 0; i < std::max<size_t>(sessions_count, 1); i++) {
+        connections.emplace_back(new connection_t(loop));
+    }
 }
 
-auto peer_t::schedule_reconnect() -> void {
-    COCAINE_LOG_INFO(logger, "scheduling reconnection of peer {} to {}", uuid(), endpoints());
-    session.apply([&](std::shared_ptr<session_t>& session) {
-        schedule_reconnect(session);
+auto peer_t::fork(std::shared_ptr<io::basic_dispatch_t> dispatch, std::weak_ptr<session_t>& forked_on)
+    -> io::upstream_ptr_t
+{
+    connection_t* chosen = nullptr;
+    std::shared_ptr<session_t> session;
+    for(auto& connection: connections) {
+        auto candidate = *connection->session.synchronize();
+        if(!candidate) {
+            schedule_reconnect(*connection);
+            continue;
+        }
+        if(!chosen || connection->streams->load() < chosen->streams->load()) {
+            chosen = connection.get();
+            session = std::move(candidate);
+        }
+    }
+    if(!session) {
+        throw error_t(error::not_connected, "session is not connected");
+    }
+    d.last_active = std::chrono::system_clock::now();
+    forked_on = session;
+    auto tracked = std::make_shared<tracked_dispatch_t>(std::move(dispatch), chosen->streams);
+    return session->fork(std::shared_ptr<io::basic_dispatch_t>(tracked, tracked->dispatch.get()));
+}
+
+auto peer_t::connect() -> void {
+    for(auto& connection: connections) {
+        connect(*connection);
+    }
+}
+
+auto peer_t::schedule_reconnect(const std::weak_ptr<session_t>& failed) -> void {
+    // Expired session has already been replaced, its connection is being reconnected.
+    auto target = failed.lock();
+    if(!target) {
+        return;
+    }
+    for(auto& connection: connections) {
+        connection->session.apply([&](std::shared_ptr<session_t>& session) {
+            if(session == target) {
+                COCAINE_LOG_INFO(logger, "scheduling reconnection of peer {} session to {}", uuid(), endpoints());
+                schedule_reconnect(*connection, session);
+            }
+        });
+    }
+}
+
+auto peer_t::schedule_reconnect(connection_t& connection) -> void {
+    connection.session.apply([&](std::shared_ptr<session_t>& session) {
+        schedule_reconnect(connection, session);
     });
 }
-auto peer_t::schedule_reconnect(std::shared_ptr<cocaine::session_t>& session) -> void {
-    if(connecting) {
+
+auto peer_t::schedule_reconnect(connection_t& connection, std::shared_ptr<cocaine::session_t>& session) -> void {
+    if(connection.connecting) {
         COCAINE_LOG_INFO(logger, "reconnection is alredy in progress for {}", uuid());
         return;
     }
@@ -59,18 +139,18 @@ auto peer_t::schedule_reconnect(std::shared_ptr<cocaine::session_t>& session) ->
         session->detach(std::error_code());
         session = nullptr;
     }
-    timer.expires_from_now(boost::posix_time::seconds(1));
-    timer.async_wait([&](std::error_code ec) {
+    connection.timer.expires_from_now(boost::posix_time::seconds(1));
+    connection.timer.async_wait([&](std::error_code ec) {
         if(!ec) {
-            connect();
+            connect(connection);
         }
     });
-    connecting = true;
+    connection.connecting = true;
     COCAINE_LOG_INFO(logger, "scheduled reconnection of peer {} to {}", uuid(), endpoints());
 }
 
-auto peer_t::connect() -> void {
-    connecting = true;
+auto peer_t::connect(connection_t& connection) -> void {
+    connection.connecting = true;
     COCAINE_LOG_INFO(logger, "connecting peer {} to {}", uuid(), endpoints());
 
     auto socket = std::make_shared<asio::ip::tcp::socket>(loop);
@@ -80,6 +160,7 @@ auto peer_t::connect() -> void {
 
     auto begin = d.endpoints.begin();
     auto end = d.endpoints.end();
+    auto connection_ptr = &connection;
 
     connect_timer->expires_from_now(boost::posix_time::seconds(60));
     connect_timer->async_wait([=](std::error_code ec) {
@@ -90,8 +171,8 @@ auto peer_t::connect() -> void {
         if(!ec) {
             COCAINE_LOG_INFO(logger, "connection timer expired, canceling socket, going to schedule reconnect");
             socket->cancel();
-            self->connecting = false;
-            self->schedule_reconnect();
+            connection_ptr->connecting = false;
+            self->schedule_reconnect(*connection_ptr);
         } else {
             COCAINE_LOG_DEBUG(logger, "connection timer was cancelled");
         }
@@ -110,8 +191,8 @@ auto peer_t::connect() -> void {
         if(ec) {
             COCAINE_LOG_ERROR(logger, "could not connect to {} - {}({})", *endpoint_it, ec.message(), ec.value());
             if(endpoint_it == end) {
-                connecting = false;
-                schedule_reconnect();
+                connection_ptr->connecting = false;
+                schedule_reconnect(*connection_ptr);
             }
             return;
         }
@@ -119,14 +200,14 @@ auto peer_t::connect() -> void {
             COCAINE_LOG_INFO(logger, "suceesfully connected peer {} to {}", uuid(), endpoints());
             auto ptr = std::make_unique<asio::ip::tcp::socket>(std::move(*socket));
             auto new_session = context.engine().attach(std::move(ptr), nullptr);
-            session.apply([&](std::shared_ptr<session_t>& session) {
-                connecting = false;
+            connection_ptr->session.apply([&](std::shared_ptr<session_t>& session) {
+                connection_ptr->connecting = false;
                 session = std::move(new_session);
                 d.last_active = std::chrono::system_clock::now();
             });
         } catch(const std::exception& e) {
             COCAINE_LOG_WARNING(logger, "failed to attach session to queue: {}", e.what());
-            schedule_reconnect();
+            schedule_reconnect(*connection_ptr);
         }
     });
 }
@@ -140,9 +221,17 @@ auto peer_t::endpoints() const -> const std::vector<asio::ip::tcp::endpoint>& {
 }
 
 auto peer_t::connected() const -> bool {
-    return session.apply([&](const std::shared_ptr<session_t>& session){
-        return static_cast<bool>(session);
-    });
+    return connected_sessions() > 0;
+}
+
+auto peer_t::connected_sessions() const -> size_t {
+    size_t count = 0;
+    for(const auto& connection: connections) {
+        connection->session.apply([&](const std::shared_ptr<session_t>& session){
+            count += session ? 1 : 0;
+        });
+    }
+    return count;
 }
 
 auto peer_t::last_active() const -> std::chrono::system_clock::time_point {
@@ -157,10 +246,124 @@ auto peer_t::x_cocaine_cluster() const -> const std::string& {
     return d.x_cocaine_cluster;
 }
 
-peers_t::peers_t(context_t& context):
+auto peer_t::health() -> health_t& {
+    return health_state;
+}
+
+auto peer_t::health() const -> const health_t& {
+    return health_state;
+}
+
+peers_t::peers_t(context_t& context, const dynamic_t& args):
     context(context),
-    logger(context.log("vicodyn/peers_t"))
-{}
+    logger(context.log("vicodyn/peers_t")),
+    sessions_per_peer(args.as_object().at("sessions_per_peer", 1u).as_uint()),
+    ejections(context.metrics_hub().counter<std::uint64_t>("vicodyn.peers.ejections")),
+    stopping(false)
+{
+    auto conf = args.as_object().find("outlier_detection");
+    detection.enabled = (conf != args.as_object().end());
+    const auto& detection_args = detection.enabled ? conf->second.as_object() : dynamic_t::empty_object.as_object();
+    detection.interval = std::chrono::milliseconds(detection_args.at("interval_ms", 10000u).as_uint());
+    detection.min_requests = detection_args.at("min_requests", 20u).as_uint();
+    detection.error_rate = detection_args.at("error_rate", 0.5).to<double>();
+    detection.latency_factor = detection_args.at("latency_factor", 3.0).to<double>();
+    detection.max_ejected_share = detection_args.at("max_ejected_share", 0.5).to<double>();
+    detection.base_ejection = std::chrono::milliseconds(detection_args.at("base_ejection_ms", 30000u).as_uint());
+    detection.max_ejection = std::chrono::milliseconds(detection_args.at("max_ejection_ms", 300000u).as_uint());
+    detection.ramp_up = std::chrono::milliseconds(detection_args.at("ramp_up_ms", 30000u).as_uint());
+
+    if(detection.enabled) {
+        detection_timer.reset(new asio::deadline_timer(executor.asio()));
+        schedule_detection();
+    }
+}
+
+peers_t::~peers_t() {
+    if(!detection_timer) {
+        return;
+    }
+    // The detection handler runs in the executor thread, so it can neither be running nor re-arm the timer
+    // once this is processed.
+    std::promise<void> done;
+    executor.asio().post([&] {
+        stopping = true;
+        detection_timer->cancel();
+        done.set_value();
+    });
+    done.get_future().wait();
+}
+
+auto peers_t::schedule_detection() -> void {
+    if(stopping) {
+        return;
+    }
+    detection_timer->expires_from_now(boost::posix_time::milliseconds(detection.interval.count()));
+    detection_timer->async_wait([&](std::error_code ec) {
+        if(ec) {
+            return;
+        }
+        try {
+            detect_outliers();
+        } catch(const std::exception& e) {
+            COCAINE_LOG_ERROR(logger, "outlier detection failed - {}", e.what());
+        }
+        schedule_detection();
+    });
+}
+
+auto peers_t::detect_outliers() -> void {
+    auto peers = apply_shared([&](const data_t& data) {
+        return data.peers;
+    });
+
+    std::vector<std::pair<std::shared_ptr<peer_t>, health_t::window_t>> windows;
+    std::vector<double> latencies;
+    size_t ejected = 0;
+    for(const auto& pair: peers) {
+        auto& health = pair.second->health();
+        auto window = health.collect();
+        if(health.ejected()) {
+            ejected++;
+            continue;
+        }
+        if(window.requests < detection.min_requests) {
+            continue;
+        }
+        if(window.requests > window.errors) {
+            latencies.push_back(window.average_latency_us());
+        }
+        windows.emplace_back(pair.second, window);
+    }
+
+    double median = 0.0;
+    if(!latencies.empty()) {
+        auto middle = latencies.begin() + latencies.size() / 2;
+        std::nth_element(latencies.begin(), middle, latencies.end());
+        median = *middle;
+    }
+
+    auto max_ejected = static_cast<size_t>(peers.size() * detection.max_ejected_share);
+    for(const auto& item: windows) {
+        const auto& peer = item.first;
+        const auto& window = item.second;
+        bool erroneous = window.error_rate() > detection.error_rate;
+        bool slow = median > 0.0 && window.average_latency_us() > median * detection.latency_factor;
+        if(!erroneous && !slow) {
+            peer->health().restore();
+            continue;
+        }
+        if(ejected >= max_ejected) {
+            COCAINE_LOG_WARNING(logger, "not ejecting outlier peer {} - too many peers are already ejected", peer->uuid());
+            continue;
+        }
+        peer->health().eject(detection.base_ejection, detection.max_ejection, detection.ramp_up);
+        ejected++;
+        ejections->operator++();
+        COCAINE_LOG_WARNING(logger, "ejected outlier peer {} - error rate {}, average latency {} us, median latency {} us",
+                            peer->uuid(), window.error_rate(), window.average_latency_us(), median);
+    }
+}
 
 auto peers_t::register_peer(const std::string& uuid, const endpoints_t& endpoints, dynamic_t::object_t extra)
     -> std::shared_ptr<peer_t>
@@ -168,12 +371,12 @@ auto peers_t::register_peer(const std::string& uuid, const endpoints_t& endpoint
     return apply([&](data_t& data){
         auto& peer = data.peers[uuid];
         if(!peer) {
-            peer = std::make_shared<peer_t>(context, executor.asio(), endpoints, uuid, std::move(extra));
+            peer = std::make_shared<peer_t>(context, executor.asio(), endpoints, uuid, std::move(extra), sessions_per_peer);
             peer->connect();
         } else if (endpoints != peer->endpoints()) {
             COCAINE_LOG_ERROR(logger, "changed endpoints detected for uuid {}, previous {}, new {}", uuid,
                               peer->endpoints(), endpoints);
-            peer = std::make_shared<peer_t>(context, executor.asio(), endpoints, uuid, extra);
+            peer = std::make_shared<peer_t>(context, executor.asio(), endpoints, uuid, extra, sessions_per_peer);
             peer->connect();
         }
         return peer;
@@ -5,6 +5,8 @@
 #include "cocaine/format/peer.hpp"
 #include "cocaine/repository/vicodyn/balancer.hpp"
 
+#include "cocaine/vicodyn/health.hpp"
+#include "cocaine/vicodyn/hedging.hpp"
 #include "cocaine/vicodyn/peer.hpp"
 #include "cocaine/vicodyn/request_context.hpp"
 #include "cocaine/service/node/slave/error.hpp"
@@ -22,6 +24,10 @@
 
 #include <cocaine/traits/map.hpp>
 
+#include <asio/deadline_timer.hpp>
+
+#include <metrics/registry.hpp>
+
 namespace cocaine {
 namespace vicodyn {
 
@@ -53,13 +59,16 @@ private:
 class safe_stream_t {
     bool closed;
     boost::optional<upstream<app_tag>> stream;
+    // Peer session the stream was forked on, reconnected alone when sending to the stream fails.
+    std::weak_ptr<session_t> forked_on;
 
 public:
     using protocol = io::protocol<app_tag>::scope;
 
-    safe_stream_t(upstream<app_tag> stream) :
+    safe_stream_t(upstream<app_tag> stream, std::weak_ptr<session_t> forked_on) :
         closed(false),
-        stream(std::move(stream))
+        stream(std::move(stream)),
+        forked_on(std::move(forked_on))
     {}
 
     safe_stream_t() :
@@ -71,6 +80,10 @@ public:
         return stream.is_initialized();
     }
 
+    auto session() const -> const std::weak_ptr<session_t>& {
+        return forked_on;
+    }
+
     auto chunk(const hpack::headers_t& headers, std::string data) -> bool {
         if(!closed && stream) {
             stream = stream->send<protocol::chunk>(headers, std::move(data));
@@ -107,10 +120,25 @@ class vicodyn_dispatch_t : public std::enable_shared_from_this<vicodyn_dispatch_
     std::shared_ptr<peer_t> peer;
     discardable<app_tag> forward_dispatch;
     discardable<app_tag> backward_dispatch;
+    discardable<app_tag> hedge_dispatch;
 
     safe_stream_t backward_stream;
     safe_stream_t forward_stream;
 
+    // Duplicate of the forward stream sent to another peer while the request is being hedged.
+    std::shared_ptr<peer_t> hedge_peer;
+    safe_stream_t hedge_stream;
+    // Set when the stream held in forward_stream replies via hedge_dispatch, i.e. hedged request has won.
+    bool primary_is_hedge;
+    asio::deadline_timer hedge_timer;
+    std::unique_ptr<hedging_t::first_chunk_timer_t::context_t> first_chunk_timer;
+
+    // Time the streams were opened, used to report reply latency to peer health.
+    health_t::clock_t::time_point primary_started;
+    health_t::clock_t::time_point hedge_started;
+    // Set once the outcome of the primary stream is reported to peer health, reset on retry.
+    bool reported;
+
     std::string enqueue_frame;
     hpack::headers_t enqueue_headers;
     std::vector<std::string> chunks;
@@ -119,6 +147,11 @@ class vicodyn_dispatch_t : public std::enable_shared_from_this<vicodyn_dispatch_
     hpack::headers_t choke_headers;
 
     bool buffering_enabled;
+    size_t buffered_bytes;
+
+    // Reply bytes relayed to the client by this stream.
+    size_t reply_bytes;
+    bool reply_limit_exceeded;
 
     synchronized<void> mutex;
 
@@ -176,7 +209,7 @@ public:
             catch(const std::system_error& e) {
                 COCAINE_LOG_WARNING(parent->logger, "failed to send error to forward dispatch - {}", error::to_string(e));
                 parent->backward_stream.error({}, e.code(), "failed to send error to forward dispatch");
-                parent->peer->schedule_reconnect();
+                parent->peer->schedule_reconnect(parent->forward_stream.session());
             }
         }
     };
@@ -189,9 +222,17 @@ public:
         peer(std::move(_peer)),
         forward_dispatch(name + "/forward"),
         backward_dispatch(name + "/backward"),
+        hedge_dispatch(name + "/hedge"),
         backward_stream(std::move(b_stream)),
         forward_stream(),
-        buffering_enabled(true)
+        primary_is_hedge(false),
+        hedge_timer(proxy.loop),
+        reported(false),
+        choke_sent(false),
+        buffering_enabled(true),
+        buffered_bytes(0),
+        reply_bytes(0),
+        reply_limit_exceeded(false)
     {
         namespace ph = std::placeholders;
 
@@ -221,32 +262,37 @@ public:
         });
 
 
-        backward_dispatch.on<protocol::chunk>()
-            .execute(std::bind(&vicodyn_dispatch_t::on_backward_chunk, this, ph::_1, ph::_2));
+        for(auto from_hedge: {false, true}) {
+            auto& d = from_hedge ? hedge_dispatch : backward_dispatch;
 
-        backward_dispatch.on<protocol::choke>()
-            .execute(std::bind(&vicodyn_dispatch_t::on_backward_choke, this, ph::_1));
+            d.on<protocol::chunk>()
+                .execute(std::bind(&vicodyn_dispatch_t::on_backward_chunk, this, from_hedge, ph::_1, ph::_2));
 
-        backward_dispatch.on<protocol::error>()
-            .execute(std::bind(&vicodyn_dispatch_t::on_backward_error, this, ph::_1, ph::_2, ph::_3));
+            d.on<protocol::choke>()
+                .execute(std::bind(&vicodyn_dispatch_t::on_backward_choke, this, from_hedge, ph::_1));
 
-        backward_dispatch.on_discard([&](const std::error_code& ec) {
-            try {
-                backward_stream.error({}, ec, "vicodyn upstream has been disconnected");
-            } catch (const std::exception& e) {
-                COCAINE_LOG_WARNING(logger, "could not send error {} to upstream - {}", ec, e);
-            }
-        });
+            d.on<protocol::error>()
+                .execute(std::bind(&vicodyn_dispatch_t::on_backward_error, this, from_hedge, ph::_1, ph::_2, ph::_3));
+
+            d.on_discard(std::bind(&vicodyn_dispatch_t::on_backward_discard, this, from_hedge, ph::_1));
+        }
     }
 
     ~vicodyn_dispatch_t() {
+        proxy.stats.buffered_bytes->fetch_sub(static_cast<std::int64_t>(buffered_bytes));
+        // Request abandoned without any reply, f.e. timed out by the client, counts against the peer.
+        if(forward_stream && !reported) {
+            peer->health().on_error();
+        }
     }
 
     auto on_forward_chunk(const hpack::headers_t& headers, std::string chunk) -> void {
         COCAINE_LOG_DEBUG(logger, "processing chunk");
-        chunks.push_back(std::move(chunk));
-        chunk_headers.push_back(headers);
-        forward_stream.chunk(headers, chunks.back());
+        forward_stream.chunk(headers, chunk);
+        hedge_stream.chunk(headers, chunk);
+        if(buffering_enabled) {
+            buffer_chunk_unsafe(headers, std::move(chunk));
+        }
         request_context->add_checkpoint("after_fchunk");
     }
 
@@ -255,17 +301,25 @@ public:
         choke_sent = true;
         choke_headers = headers;
         forward_stream.close(headers);
+        hedge_stream.close(headers);
         request_context->add_checkpoint("after_fchoke");
     }
 
     auto on_forward_error(const hpack::headers_t& headers, const std::error_code& ec, const std::string& msg) -> void {
         COCAINE_LOG_INFO(logger, "processing error");
         forward_stream.error(headers, ec, msg);
+        hedge_stream.error(headers, ec, msg);
         request_context->add_checkpoint("after_ferror");
     }
 
-    auto on_backward_chunk(const hpack::headers_t& headers, std::string chunk) -> void {
+    auto on_backward_chunk(bool from_hedge, const hpack::headers_t& headers, std::string chunk) -> void {
+        if(!settle(from_hedge)) {
+            return;
+        }
         disable_buffering();
+        if(!account_reply(chunk.size())) {
+            return;
+        }
         try {
             backward_stream.chunk(headers, std::move(chunk));
             request_context->add_checkpoint("after_bchunk");
@@ -274,8 +328,25 @@ public:
         }
     }
 
-    auto on_backward_error(const hpack::headers_t& headers, const std::error_code& ec, const std::string& msg) -> void {
+    auto on_backward_error(bool from_hedge, const hpack::headers_t& headers, const std::error_code& ec,
+                           const std::string& msg) -> void
+    {
+        if(auto failed = drop_racing(from_hedge)) {
+            COCAINE_LOG_WARNING(logger, "received error from racing peer {} - {}({}) - {}", failed->uuid(),
+                                ec.message(), ec.value(), msg);
+            report_error(failed, ec);
+            proxy.balancer->on_error(failed, ec, msg);
+            request_context->add_checkpoint("after_hedge_error");
+            return;
+        }
+        if(from_hedge != primary_is_hedge) {
+            return;
+        }
         COCAINE_LOG_WARNING(logger, "received error from peer {}({}) - {}", ec.message(), ec.value(), msg);
+        report_error(peer, ec);
+        mutex.apply([&](){
+            reported = true;
+        });
         proxy.balancer->on_error(peer, ec, msg);
         if(proxy.balancer->is_recoverable(peer, ec)) {
             try {
@@ -298,7 +369,12 @@ public:
     };
 
 
-    auto on_backward_choke(const hpack::headers_t& headers) -> void {
+    auto on_backward_choke(bool from_hedge, const hpack::headers_t& headers) -> void {
+        if(!settle(from_hedge)) {
+            return;
+        }
+        // Reply may consist of a choke only, the request can not be retried or hedged after it.
+        disable_buffering();
         try {
             if(backward_stream.close(headers)) {
                 request_context->add_checkpoint("after_bchoke");
@@ -309,6 +385,41 @@ public:
         request_context->finish();
     }
 
+    // Accounts the reply chunk relayed to the client. Once the reply exceeds the size limit, the stream is
+    // cancelled on both sides. Sessions give no write completion, so bytes can not be credited back as the client
+    // drains them and this bounds the total reply size only, not the amount queued at a given moment.
+    auto account_reply(size_t size) -> bool {
+        bool exceeded = false;
+        bool accepted = mutex.apply([&](){
+            if(reply_limit_exceeded) {
+                return false;
+            }
+            if(proxy.max_reply_bytes && reply_bytes + size > proxy.max_reply_bytes) {
+                reply_limit_exceeded = exceeded = true;
+                return false;
+            }
+            reply_bytes += size;
+            proxy.stats.reply_bytes->fetch_add(size);
+            request_context->set_reply_bytes(reply_bytes);
+            return true;
+        });
+        if(exceeded) {
+            COCAINE_LOG_WARNING(logger, "reply exceeded size limit of {} bytes, cancelling the stream",
+                                proxy.max_reply_bytes);
+            proxy.stats.reply_limit_exceeded->operator++();
+            request_context->add_checkpoint("reply_limit_exceeded");
+            auto ec = std::make_error_code(std::errc::message_size);
+            try {
+                backward_stream.error({}, ec, "reply exceeded vicodyn reply size limit");
+            } catch(const std::system_error& e) {
+                COCAINE_LOG_DEBUG(logger, "failed to send error to client - {}", error::to_string(e));
+            }
+            on_client_disconnection();
+            request_context->fail(ec, "reply exceeded vicodyn reply size limit");
+        }
+        return accepted;
+    }
+
     auto retry() -> void {
         mutex.apply([&](){
             retry_unsafe();
@@ -321,11 +432,34 @@ public:
         });
     }
 
+    auto on_backward_discard(bool from_hedge, const std::error_code& ec) -> void {
+        if(auto failed = drop_racing(from_hedge)) {
+            COCAINE_LOG_WARNING(logger, "racing upstream has been disconnected - {}", ec);
+            failed->health().on_error();
+            return;
+        }
+        if(from_hedge != primary_is_hedge) {
+            return;
+        }
+        mutex.apply([&](){
+            if(!reported) {
+                reported = true;
+                peer->health().on_error();
+            }
+        });
+        try {
+            backward_stream.error({}, ec, "vicodyn upstream has been disconnected");
+        } catch (const std::exception& e) {
+            COCAINE_LOG_WARNING(logger, "could not send error {} to upstream - {}", ec, e);
+        }
+    }
+
     auto on_client_disconnection() -> void {
         // TODO: Do we need lock here?
         COCAINE_LOG_DEBUG(logger, "sending discard frame");
         auto ec = make_error_code(error::dispatch_errors::not_connected);
         forward_stream.error({}, ec, "vicodyn client was disconnected");
+        hedge_stream.error({}, ec, "vicodyn client was disconnected");
     }
 
     auto enqueue(const hpack::headers_t& headers, std::string event) -> void {
@@ -350,27 +484,200 @@ public:
         return std::shared_ptr<dispatch<app_tag>>(shared_from_this(), &forward_dispatch);
     }
 
+    auto shared_hedge_dispatch() -> std::shared_ptr<dispatch<app_tag>> {
+        return std::shared_ptr<dispatch<app_tag>>(shared_from_this(), &hedge_dispatch);
+    }
+
+    // Dispatch receiving replies for the stream held in forward_stream.
+    auto shared_primary_dispatch() -> std::shared_ptr<dispatch<app_tag>> {
+        return primary_is_hedge ? shared_hedge_dispatch() : shared_backward_dispatch();
+    }
+
+    // Dispatch receiving replies for the stream held in hedge_stream.
+    auto shared_secondary_dispatch() -> std::shared_ptr<dispatch<app_tag>> {
+        return primary_is_hedge ? shared_backward_dispatch() : shared_hedge_dispatch();
+    }
+
+    auto hedge() -> void {
+        mutex.apply([&](){
+            hedge_unsafe();
+        });
+    }
+
 private:
+    // Decides whether a reply from the given dispatch should be passed to the client.
+    // The first peer to reply while the request is hedged wins, the stream of the other one is cancelled.
+    auto settle(bool from_hedge) -> bool {
+        return mutex.apply([&](){
+            first_chunk_timer.reset();
+            cancel_hedge_timer_unsafe();
+            if(!hedge_stream) {
+                bool accepted = (from_hedge == primary_is_hedge);
+                if(accepted) {
+                    report_reply_unsafe();
+                }
+                return accepted;
+            }
+            bool hedge_won = (from_hedge != primary_is_hedge);
+            if(hedge_won) {
+                swap_hedge_unsafe();
+            }
+            cancel_hedge_unsafe("request was answered by another peer");
+            report_reply_unsafe();
+            proxy.hedging->on_settled(hedge_won);
+            request_context->add_checkpoint("after_hedge_settle");
+            return true;
+        });
+    }
+
+    // Removes the failed stream from the race, leaving the other one as primary.
+    // Returns the peer of the failed stream or nullptr if there was no race.
+    auto drop_racing(bool from_hedge) -> std::shared_ptr<peer_t> {
+        return mutex.apply([&]() -> std::shared_ptr<peer_t> {
+            if(!hedge_stream) {
+                return nullptr;
+            }
+            if(from_hedge == primary_is_hedge) {
+                swap_hedge_unsafe();
+            }
+            auto failed = std::move(hedge_peer);
+            hedge_peer = nullptr;
+            hedge_stream = safe_stream_t();
+            return failed;
+        });
+    }
+
+    auto report_reply_unsafe() -> void {
+        if(!reported) {
+            reported = true;
+            peer->health().on_reply(health_t::clock_t::now() - primary_started);
+        }
+    }
+
+    auto report_error(const std::shared_ptr<peer_t>& failed, const std::error_code& ec) -> void {
+        if(health_t::is_peer_error(ec)) {
+            failed->health().on_error();
+        }
+    }
+
+    auto swap_hedge_unsafe() -> void {
+        std::swap(primary_started, hedge_started);
+        std::swap(peer, hedge_peer);
+        std::swap(forward_stream, hedge_stream);
+        primary_is_hedge = !primary_is_hedge;
+        logger.reset(new blackhole::wrapper_t(*proxy.logger, {{"peer", peer->uuid()}}));
+    }
+
+    auto cancel_hedge_unsafe(const std::string& reason) -> void {
+        try {
+            hedge_stream.error({}, make_error_code(error::dispatch_errors::not_connected), reason);
+        } catch(const std::system_error& e) {
+            COCAINE_LOG_DEBUG(logger, "failed to cancel hedged stream - {}", error::to_string(e));
+        }
+        hedge_stream = safe_stream_t();
+        hedge_peer = nullptr;
+    }
+
+    auto cancel_hedge_timer_unsafe() -> void {
+        std::error_code ec;
+        hedge_timer.cancel(ec);
+    }
+
+    auto schedule_hedge_unsafe() -> void {
+        if(!proxy.hedging || !proxy.hedging->enabled(enqueue_headers, enqueue_frame)) {
+            return;
+        }
+        auto delay = proxy.hedging->delay();
+        std::weak_ptr<vicodyn_dispatch_t> weak_self(shared_from_this());
+        hedge_timer.expires_from_now(boost::posix_time::milliseconds(delay.count()));
+        hedge_timer.async_wait([=](std::error_code ec) {
+            auto self = weak_self.lock();
+            if(!ec && self) {
+                self->hedge();
+            }
+        });
+    }
+
+    auto hedge_unsafe() -> void {
+        if(!buffering_enabled || !forward_stream || hedge_stream) {
+            return;
+        }
+        try {
+            auto candidate = proxy.balancer->choose_peer(request_context, enqueue_headers, enqueue_frame);
+            if(candidate == peer) {
+                COCAINE_LOG_DEBUG(logger, "skipping hedged request - no other peer was chosen");
+                return;
+            }
+            std::weak_ptr<session_t> session;
+            auto u = candidate->open_stream<io::node::enqueue>(shared_secondary_dispatch(), session, enqueue_headers,
+                                                                proxy.app_name, enqueue_frame);
+            hedge_stream = safe_stream_t(std::move(u), std::move(session));
+            hedge_peer = std::move(candidate);
+            hedge_started = health_t::clock_t::now();
+            for(size_t i = 0; i < chunks.size(); i++) {
+                hedge_stream.chunk(chunk_headers[i], chunks[i]);
+            }
+            if(choke_sent) {
+                hedge_stream.close(choke_headers);
+            }
+            request_context->mark_used_peer(hedge_peer);
+            request_context->add_checkpoint("after_hedge");
+            proxy.hedging->on_sent();
+            COCAINE_LOG_INFO(logger, "sent hedged request to peer {}", hedge_peer->uuid());
+        } catch(const std::system_error& e) {
+            COCAINE_LOG_WARNING(logger, "failed to send hedged request - {}", error::to_string(e));
+            hedge_stream = safe_stream_t();
+            hedge_peer = nullptr;
+        }
+    }
+
     auto disable_buffering_unsafe() -> void {
         buffering_enabled = false;
+        cancel_hedge_timer_unsafe();
         enqueue_frame.clear();
         enqueue_headers.clear();
         chunk_headers.clear();
         chunks.clear();
+        proxy.stats.buffered_bytes->fetch_sub(static_cast<std::int64_t>(buffered_bytes));
+        buffered_bytes = 0;
         COCAINE_LOG_DEBUG(logger, "disabled buffernig");
     }
 
+    // Keeps the chunk for retries unless the stream exceeds its buffering window.
+    auto buffer_chunk_unsafe(const hpack::headers_t& headers, std::string chunk) -> void {
+        if(proxy.buffer_window && buffered_bytes + chunk.size() > proxy.buffer_window) {
+            COCAINE_LOG_INFO(logger, "stream exceeded buffering window of {} bytes, it can not be retried anymore",
+                             proxy.buffer_window);
+            proxy.stats.buffer_overflows->operator++();
+            request_context->add_checkpoint("buffer_overflow");
+            disable_buffering_unsafe();
+            return;
+        }
+        buffered_bytes += chunk.size();
+        proxy.stats.buffered_bytes->fetch_add(static_cast<std::int64_t>(chunk.size()));
+        chunks.push_back(std::move(chunk));
+        chunk_headers.push_back(headers);
+    }
+
     auto enqueue_unsafe(const hpack::headers_t& headers, std::string event) -> void {
         COCAINE_LOG_DEBUG(logger, "processing enqueue");
         enqueue_frame = std::move(event);
         enqueue_headers = std::move(headers);
+        std::weak_ptr<session_t> session;
         try {
-            auto u = peer->open_stream<io::node::enqueue>(shared_backward_dispatch(), enqueue_headers, proxy.app_name, enqueue_frame);
-            forward_stream = safe_stream_t(std::move(u));
+            primary_started = health_t::clock_t::now();
+            auto u = peer->open_stream<io::node::enqueue>(shared_backward_dispatch(), session, enqueue_headers,
+                                                          proxy.app_name, enqueue_frame);
+            forward_stream = safe_stream_t(std::move(u), session);
             request_context->add_checkpoint("after_enqueue");
+            if(proxy.hedging) {
+                // Every request feeds the hedge delay, not only hedged ones, which would skew it toward itself.
+                first_chunk_timer = proxy.hedging->measure();
+            }
+            schedule_hedge_unsafe();
         } catch (const std::system_error& e) {
             COCAINE_LOG_WARNING(logger, "failed to send enqueue to forward stream - {}", error::to_string(e));
-            peer->schedule_reconnect();
+            peer->schedule_reconnect(session);
             //TODO: maybe cycle here?
             try {
                 retry_unsafe();
@@ -395,8 +702,12 @@ private:
         request_context->add_checkpoint("retry");
         request_context->mark_used_peer(peer);
         logger.reset(new blackhole::wrapper_t(*proxy.logger, {{"peer", peer->uuid()}}));
-        auto u = peer->open_stream<io::node::enqueue>(shared_backward_dispatch(), enqueue_headers, proxy.app_name, enqueue_frame);
-        forward_stream = safe_stream_t(std::move(u));
+        primary_started = health_t::clock_t::now();
+        reported = false;
+        std::weak_ptr<session_t> session;
+        auto u = peer->open_stream<io::node::enqueue>(shared_primary_dispatch(), session, enqueue_headers,
+                                                      proxy.app_name, enqueue_frame);
+        forward_stream = safe_stream_t(std::move(u), std::move(session));
         for(size_t i = 0; i < chunks.size(); i++) {
             forward_stream.chunk(chunk_headers[i], chunks[i]);
         }
@@ -415,6 +726,14 @@ auto proxy_t::make_balancer(const dynamic_t& args, const dynamic_t::object_t& ex
                                                               balancer_args, extra);
 }
 
+auto proxy_t::make_hedging(const dynamic_t& args) -> std::unique_ptr<hedging_t> {
+    auto hedging_conf = args.as_object().find("hedging");
+    if(hedging_conf == args.as_object().end()) {
+        return nullptr;
+    }
+    return std::unique_ptr<hedging_t>(new hedging_t(context, loop, app_name, hedging_conf->second));
+}
+
 proxy_t::proxy_t(context_t& context, asio::io_service& loop, peers_t& peers, const std::string& name, const dynamic_t& args,
                  const dynamic_t::object_t& extra) :
     dispatch(name),
@@ -423,6 +742,15 @@ proxy_t::proxy_t(context_t& context, asio::io_service& loop, peers_t& peers, con
     peers(peers),
     app_name(name.substr(sizeof("virtual::") - 1)),
     balancer(make_balancer(args, extra)),
+    hedging(make_hedging(args)),
+    buffer_window(args.as_object().at("buffer_window", 0u).as_uint()),
+    max_reply_bytes(args.as_object().at("max_reply_bytes", 0u).as_uint()),
+    stats{
+        context.metrics_hub().counter<std::int64_t>(format("vicodyn.{}.buffered_bytes", app_name)),
+        context.metrics_hub().counter<std::uint64_t>(format("vicodyn.{}.buffer_overflows", app_name)),
+        context.metrics_hub().counter<std::uint64_t>(format("vicodyn.{}.reply_bytes", app_name)),
+        context.metrics_hub().counter<std::uint64_t>(format("vicodyn.{}.reply_limit_exceeded", app_name))
+    },
     logger(context.log(name))
 {
     COCAINE_LOG_DEBUG(logger, "created proxy for app {}", app_name);
@@ -9,29 +9,35 @@ request_context_t::request_context_t(blackhole::logger_t& logger) :
     logger(logger),
     start_time(clock_t::now()),
     closed(ATOMIC_FLAG_INIT),
-    retry_counter(0)
+    retry_counter(0),
+    reply_bytes(0)
 {}
 
 request_context_t::~request_context_t() {
     fail({}, "dtor called");
 }
 
+constexpr size_t request_context_t::max_checkpoints;
+constexpr size_t request_context_t::max_used_peers;
+
 auto request_context_t::mark_used_peer(std::shared_ptr<peer_t> peer) -> void {
-    used_peers->emplace_back(std::move(peer));
+    used_peers.push_back(std::move(peer));
 }
 
 auto request_context_t::peer_use_count(const std::shared_ptr<peer_t>& peer) -> size_t {
-    return used_peers.apply([&](const std::vector<std::shared_ptr<peer_t>>& used_peers){
-        return std::count(used_peers.begin(), used_peers.end(), peer);
+    size_t count = 0;
+    used_peers.each([&](const std::shared_ptr<peer_t>& used_peer){
+        count += (used_peer == peer) ? 1 : 0;
     });
+    return count;
 }
 
 auto request_context_t::peer_use_count(const std::string& peer_uuid) -> size_t {
-    return used_peers.apply([&](const std::vector<std::shared_ptr<peer_t>>& used_peers){
-        return std::count_if(used_peers.begin(), used_peers.end(), [&](const std::shared_ptr<peer_t>& peer){
-            return peer->uuid() == peer_uuid;
-        });
+    size_t count = 0;
+    used_peers.each([&](const std::shared_ptr<peer_t>& used_peer){
+        count += (used_peer->uuid() == peer_uuid) ? 1 : 0;
     });
+    return count;
 }
 
 auto request_context_t::register_retry() -> void {
@@ -42,6 +48,10 @@ auto request_context_t::retry_count() -> size_t {
     return retry_counter;
 }
 
+auto request_context_t::set_reply_bytes(size_t bytes) -> void {
+    reply_bytes.store(bytes, std::memory_order_relaxed);
+}
+
 auto request_context_t::finish() -> void {
     static std::string msg("finished request");
     write(logging::info, "finished request");
@@ -60,19 +70,24 @@ auto request_context_t::write(int level, const std::string& msg) -> void {
     if(closed.test_and_set()) {
         return;
     }
-    add_checkpoint("total_duration_ms");
+    // Total duration is kept out of the capped checkpoints, long streams may overflow them.
+    const auto total = clock_t::now();
 
     blackhole::view_of<blackhole::attributes_t>::type view;
-    auto sync_peers = used_peers.synchronize();
-    auto sync_checkpoints = checkpoints.synchronize();
-    for (const auto& peer: *sync_peers) {
+    used_peers.each([&](const std::shared_ptr<peer_t>& peer) {
         view.emplace_back("peer", peer->uuid());
-    }
-    view.emplace_back("retry_cnt", retry_counter);
-    for (const auto& checkpoint: *sync_checkpoints) {
+    });
+    view.emplace_back("retry_cnt", retry_counter.load());
+    view.emplace_back("reply_bytes", reply_bytes.load(std::memory_order_relaxed));
+    checkpoints.each([&](const checkpoint_t& checkpoint) {
         auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(checkpoint.when - start_time);
         view.emplace_back(blackhole::string_view(checkpoint.message, checkpoint.msg_len), ms.count());
+    });
+    if(auto dropped = checkpoints.dropped()) {
+        view.emplace_back("dropped_checkpoints", dropped);
     }
+    view.emplace_back("total_duration_ms",
+                      std::chrono::duration_cast<std::chrono::milliseconds>(total - start_time).count());
 
     COCAINE_LOG(logger, logging::priorities(level), msg, view);
 }